@@ -0,0 +1,69 @@
+#include "ns3/command-line.h" // class CommandLine
+
+#include "ns3/quantum-basis.h"
+#include "ns3/quantum-phy-entity.h" // class QuantumPhyEntity
+#include "ns3/quantum-operation.h" // class QuantumOperation
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("EntSwapMpsExample");
+
+int
+main (int argc, char *argv[])
+{
+  unsigned num_nodes = 1000;
+  unsigned max_bond = 16;
+  double fidel = 0.99;
+  CommandLine cmd;
+  cmd.AddValue ("nodes", "Number of nodes in the repeater chain", num_nodes);
+  cmd.AddValue ("maxBond", "Maximum bond dimension of the matrix product state", max_bond);
+  cmd.AddValue ("fidel", "Fidelity of each elementary EPR pair", fidel);
+  cmd.Parse (argc, argv);
+
+  //
+  // Simulate on a matrix product state, since the chain is 1-D.
+  //
+  Config::SetDefault ("ns3::QuantumMPS::MaxBond", UintegerValue (max_bond));
+  std::vector<std::string> owners = {"God"};
+  Ptr<QuantumPhyEntity> qphyent = CreateObject<QuantumPhyEntity> (owners);
+  qphyent->SetAttribute ("Backend", StringValue ("mps"));
+
+  //
+  // Share a noisy EPR pair (A_i, B_{i+1}) over each link.
+  //
+  QuantumOperation depolar = {
+      {"I", "PX", "PY", "PZ"},
+      {pauli_I, pauli_X, pauli_Y, pauli_Z},
+      {fidel, (1 - fidel) / 3., (1 - fidel) / 3., (1 - fidel) / 3.}};
+  for (unsigned i = 0; i + 1 < num_nodes; ++i)
+    {
+      std::string a = "A" + std::to_string (i), b = "B" + std::to_string (i + 1);
+      qphyent->GenerateQubitsPure ("God", q_bell, {a, b});
+      qphyent->ApplyOperation (depolar, {b});
+    }
+
+  //
+  // Swap along the chain in the control-flow adapted form, so that A_0 ends up with B_{n-1}.
+  //
+  for (unsigned i = 1; i + 1 < num_nodes; ++i)
+    {
+      std::string a = "A" + std::to_string (i), b = "B" + std::to_string (i);
+      std::string next = "B" + std::to_string (i + 1);
+      qphyent->ApplyGate ("God", QNS_GATE_PREFIX + "CNOT", {}, {a, b});
+      qphyent->ApplyGate ("God", QNS_GATE_PREFIX + "H", {}, {b});
+      qphyent->MeasureToRegister ("God", {a, b}, {"x" + a, "z" + b});
+      qphyent->ApplyClassicallyControlledGate ("God", QNS_GATE_PREFIX + "PX", pauli_X,
+                                               {"x" + a}, {next});
+      qphyent->ApplyClassicallyControlledGate ("God", QNS_GATE_PREFIX + "PZ", pauli_Z,
+                                               {"z" + b}, {next});
+      qphyent->PartialTrace ({a, b});
+    }
+
+  double fidelity = 0;
+  qphyent->CalculateFidelity ({"A0", "B" + std::to_string (num_nodes - 1)}, fidelity);
+  std::cout << "nodes " << num_nodes << " fidelity " << fidelity << " truncation error "
+            << qphyent->GetTruncationError () << std::endl;
+
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,163 @@
+/*
+  To run this example:
+  NS_LOG="QuantumRouting=info:EntSwapApp=logic" ./ns3 run ent-swap-routing-example
+*/
+
+#include "ns3/csma-module.h" // class CsmaHelper, NetDeviceContainer
+#include "ns3/internet-module.h" // class InternetStackHelper, Ipv6AddressHelper, Ipv6InterfaceContainer
+
+#include "ns3/quantum-basis.h"
+#include "ns3/quantum-network-simulator.h" // class QuantumNetworkSimulator
+#include "ns3/quantum-phy-entity.h" // class QuantumPhyEntity
+#include "ns3/quantum-node.h" // class QuantumNode
+#include "ns3/quantum-net-stack-helper.h" // class QuantumNetStackHelper
+#include "ns3/quantum-routing.h" // class QuantumRouting
+
+#include <iostream>
+
+NS_LOG_COMPONENT_DEFINE ("EntSwapRoutingExample");
+
+using namespace ns3;
+
+/*
+  A W x W grid of owners, each linked to its right and lower neighbors
+  by EPR pairs of slightly different fidelities.
+  A few requests are routed over the paths of maximum fidelity and swapped along them.
+*/
+
+#define W (4)
+
+std::string
+Owner (int row, int col)
+{
+  return "Owner" + std::to_string (row) + "_" + std::to_string (col);
+}
+
+int
+main ()
+{
+  //
+  // Create a quantum physical entity with W x W nodes.
+  //
+  std::vector<std::string> owners = {};
+  for (int row = 0; row < W; ++row)
+    {
+      for (int col = 0; col < W; ++col)
+        {
+          owners.push_back (Owner (row, col));
+        }
+    }
+  Ptr<QuantumPhyEntity> qphyent = CreateObject<QuantumPhyEntity> (owners);
+
+  NodeContainer nodes;
+  for (const std::string &owner : owners)
+    {
+      nodes.Add (qphyent->GetNode (owner));
+    }
+
+  //
+  // Create a classical connection.
+  //
+  CsmaHelper csmaHelper;
+  csmaHelper.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("1000kbps")));
+  csmaHelper.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (CLASSICAL_DELAY)));
+  NetDeviceContainer devices = csmaHelper.Install (nodes);
+
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Ipv6AddressHelper address;
+  address.SetBase ("2001:1::", Ipv6Prefix (64));
+  Ipv6InterfaceContainer interfaces = address.Assign (devices);
+
+  unsigned rank = 0;
+  for (const std::string &owner : owners)
+    {
+      qphyent->SetOwnerAddress (owner, interfaces.GetAddress (rank, 1));
+      qphyent->SetOwnerRank (owner, rank);
+      ++rank;
+    }
+
+  //
+  // Install the quantum network stack.
+  //
+  QuantumNetStackHelper qstack;
+  qstack.Install (nodes);
+
+  //
+  // Build the link graph, which also sets the depolarizing model of every link.
+  //
+  Ptr<QuantumRouting> routing = CreateObject<QuantumRouting> (qphyent);
+  for (int row = 0; row < W; ++row)
+    {
+      for (int col = 0; col < W; ++col)
+        {
+          double fidel = 0.9 + 0.01 * ((row * 7 + col * 3) % 9);
+          if (col + 1 < W)
+            {
+              routing->SetLink (Owner (row, col), Owner (row, col + 1), fidel, 100.);
+            }
+          if (row + 1 < W)
+            {
+              routing->SetLink (Owner (row, col), Owner (row + 1, col), fidel - 0.02, 50.);
+            }
+        }
+    }
+
+  //
+  // Route a few requests, all from the same source sharing one shortest path tree.
+  //
+  std::vector<std::pair<std::string, std::string>> requests = {
+      {Owner (0, 0), Owner (W - 1, W - 1)},
+      {Owner (0, 0), Owner (W - 1, 0)},
+      {Owner (0, 0), Owner (0, W - 1)},
+  };
+
+  std::vector<std::pair<std::string, std::string>> eprs = {};
+  std::vector<double> expected = {};
+  for (unsigned i = 0; i < requests.size (); ++i)
+    {
+      QuantumRoute route = routing->GetRoute (requests[i].first, requests[i].second);
+      std::cout << "Route " << i << ":";
+      for (const std::string &owner : route.owners)
+        {
+          std::cout << " " << owner;
+        }
+      std::cout << " fidelity " << route.fidelity << " rate " << route.rate << std::endl;
+
+      eprs.push_back (routing->InstallEntSwap (route, Seconds (CLASSICAL_DELAY)));
+      expected.push_back (route.fidelity);
+    }
+
+  std::vector<QuantumRoute> routes = routing->GetRoutes (Owner (0, 0), Owner (W - 1, W - 1), 3);
+  for (unsigned k = 0; k < routes.size (); ++k)
+    {
+      std::cout << "Alternative " << k << " of " << routes[k].owners.size () - 1
+                << " hops, fidelity " << routes[k].fidelity << std::endl;
+    }
+
+  //
+  // A worse link only invalidates the trees going through it.
+  //
+  routing->SetLink (Owner (0, 0), Owner (0, 1), 0.6, 100.);
+  QuantumRoute rerouted = routing->GetRoute (Owner (0, 0), Owner (W - 1, W - 1));
+  std::cout << "Rerouted fidelity " << rerouted.fidelity << " after "
+            << routing->GetNumSearches () << " searches" << std::endl;
+  routing->SetLink (Owner (0, 0), Owner (0, 1), 0.9, 100.);
+
+  //
+  // Run the simulation.
+  //
+  Simulator::Stop (Seconds (CLASSICAL_DELAY + 2 * TELEP_DELAY));
+  Simulator::Run ();
+
+  for (unsigned i = 0; i < eprs.size (); ++i)
+    {
+      double fidelity = 0;
+      qphyent->CalculateFidelity (eprs[i], fidelity);
+      std::cout << "Request " << i << " fidelity " << fidelity << " expected " << expected[i]
+                << std::endl;
+    }
+
+  Simulator::Destroy ();
+  return 0;
+}
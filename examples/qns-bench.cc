@@ -0,0 +1,594 @@
+/*
+  Benchmark the shipped protocols over a sweep of sizes, optimizers and backends,
+  and write the results as JSON.
+  Every run is a fresh child process, so that the runs share neither ExaTN nor the peak RSS;
+  its warm-up runs happen in the same child, which then resets its peak RSS to measure the
+  run alone, and its standard output is discarded.
+  To run this example:
+  ./ns3 run "qns-bench --protocols=ent-swap-adapt,distill-nested-adapt --sizes=8,16,32
+                       --optimizers=greed,metis --reps=3 --output=bench.json"
+*/
+#include "ns3/command-line.h" // class CommandLine
+#include "ns3/csma-module.h" // class CsmaHelper, NetDeviceContainer
+#include "ns3/internet-module.h" // class InternetStackHelper, Ipv6AddressHelper, Ipv6InterfaceContainer
+
+#include "ns3/quantum-basis.h"
+#include "ns3/quantum-network-simulator.h" // struct QuantumEvalStats
+#include "ns3/quantum-phy-entity.h" // class QuantumPhyEntity
+#include "ns3/quantum-node.h" // class QuantumNode
+#include "ns3/quantum-memory.h" // class QuantumMemory
+#include "ns3/quantum-channel.h" // class QuantumChannel
+#include "ns3/distribute-epr-protocol.h" // class DistributeEPRSrcProtocol
+#include "ns3/quantum-net-stack-helper.h" // class QuantumNetStackHelper
+#include "ns3/telep-helper.h" // class TelepSrcHelper, TelepDstHelper
+#include "ns3/telep-app.h" // class TelepSrcApp, TelepDstApp
+#include "ns3/ent-swap-helper.h" // class EntSwapSrcHelper, EntSwapDstHelper
+#include "ns3/ent-swap-app.h" // class EntSwapSrcApp, EntSwapDstApp
+#include "ns3/ent-swap-adapt-helper.h" // class EntSwapAdaptHelper
+#include "ns3/ent-swap-adapt-app.h" // class EntSwapAdaptApp
+#include "ns3/ent-swap-adapt-local-helper.h" // class EntSwapAdaptLocalHelper
+#include "ns3/ent-swap-adapt-local-app.h" // class EntSwapAdaptLocalApp
+#include "ns3/distill-nested-helper.h" // class DistillNestedHelper
+#include "ns3/distill-nested-app.h" // class DistillNestedApp
+#include "ns3/distill-nested-adapt-helper.h" // class DistillNestedAdaptHelper
+#include "ns3/distill-nested-adapt-app.h" // class DistillNestedAdaptApp
+
+#include <sys/resource.h> // struct rusage
+#include <sys/wait.h> // wait4
+#include <fcntl.h> // open
+#include <unistd.h> // fork, pipe
+#ifdef __GLIBC__
+#include <malloc.h> // malloc_trim
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+NS_LOG_COMPONENT_DEFINE ("QnsBench");
+
+using namespace ns3;
+
+/** A point of the sweep. */
+struct BenchConfig
+{
+  std::string protocol;
+  unsigned n; /**< Number of owners, or of EPR pairs for the distillations. */
+  std::string optimizer;
+  std::string backend;
+};
+
+/** Measurements of a single run. */
+struct BenchResult
+{
+  bool ok;
+  double wall; /**< Wall time of Simulator::Run, in seconds. */
+  QuantumEvalStats stats;
+  double trunc_err;
+  long peak_rss_kb; /**< Peak RSS of the run, in KiB. */
+};
+
+static std::vector<std::string>
+SplitList (const std::string &list)
+{
+  std::vector<std::string> items = {};
+  std::stringstream ss (list);
+  std::string item;
+  while (std::getline (ss, item, ','))
+    {
+      if (item != "")
+        {
+          items.push_back (item);
+        }
+    }
+  return items;
+}
+
+/**
+ * \brief Create the quantum physical entity of a run, connected by a CSMA network.
+*/
+static Ptr<QuantumPhyEntity>
+CreateEntity (const BenchConfig &config, const std::vector<std::string> &owners,
+              const double &delay_ms)
+{
+  Ptr<QuantumPhyEntity> qphyent = CreateObject<QuantumPhyEntity> (owners);
+  qphyent->SetAttribute ("Optimizer", StringValue (config.optimizer));
+  qphyent->SetAttribute ("Backend", StringValue (config.backend));
+
+  NodeContainer nodes;
+  for (const std::string &owner : owners)
+    {
+      nodes.Add (qphyent->GetNode (owner));
+    }
+
+  CsmaHelper csmaHelper;
+  csmaHelper.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("1000kbps")));
+  csmaHelper.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delay_ms)));
+  NetDeviceContainer devices = csmaHelper.Install (nodes);
+
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Ipv6AddressHelper address;
+  address.SetBase ("2001:1::", Ipv6Prefix (64));
+  Ipv6InterfaceContainer interfaces = address.Assign (devices);
+
+  unsigned rank = 0;
+  for (const std::string &owner : owners)
+    {
+      qphyent->SetOwnerAddress (owner, interfaces.GetAddress (rank, 1));
+      qphyent->SetOwnerRank (owner, rank);
+      ++rank;
+    }
+
+  QuantumNetStackHelper qstack;
+  qstack.Install (nodes);
+  return qphyent;
+}
+
+static std::vector<std::string>
+ChainOwners (const unsigned &n, const bool &god)
+{
+  std::vector<std::string> owners = {};
+  if (god)
+    {
+      owners.push_back ("God");
+    }
+  for (unsigned i = 0; i < n; ++i)
+    {
+      owners.push_back ("Owner" + std::to_string (i));
+    }
+  return owners;
+}
+
+/**
+ * \brief Distribute an EPR pair between every two neighbours of the chain, as in ent-swap-example.
+*/
+static void
+DistributeChain (Ptr<QuantumPhyEntity> qphyent, const unsigned &n, const double &delay)
+{
+  for (unsigned rank = 0; rank + 1 < n; ++rank)
+    {
+      std::string srcOwner = "Owner" + std::to_string (rank);
+      std::string dstOwner = "Owner" + std::to_string (rank + 1);
+      Ptr<QuantumChannel> qconn = CreateObject<QuantumChannel> (srcOwner, dstOwner);
+      Ptr<DistributeEPRSrcProtocol> dist_epr_src_app =
+          qphyent->GetConn2Apps (qconn, APP_DIST_EPR).first->GetObject<DistributeEPRSrcProtocol> ();
+      Simulator::Schedule (Seconds (delay), &DistributeEPRSrcProtocol::GenerateAndDistributeEPR,
+                           dist_epr_src_app,
+                           std::pair<std::string, std::string>{
+                               srcOwner + "_QubitEntToOwner" + std::to_string (rank + 1),
+                               dstOwner + "_QubitEntFromOwner" + std::to_string (rank)});
+    }
+}
+
+/* protocols, each set up as in its example, storing the stop time in seconds */
+
+static Ptr<QuantumPhyEntity>
+SetupTelepLin (const BenchConfig &config, double &stop)
+{
+  const unsigned N = config.n;
+  Ptr<QuantumPhyEntity> qphyent = CreateEntity (config, ChainOwners (N, false), CLASSICAL_DELAY);
+
+  Ptr<Qubit> input = CreateObject<Qubit> (
+      std::vector<std::complex<double>>{{sqrt (5. / 7.), 0.0}, {0.0, sqrt (2. / 7.)}});
+  for (unsigned rank = 0; rank + 1 < N; ++rank)
+    {
+      std::string srcOwner = "Owner" + std::to_string (rank);
+      std::string dstOwner = "Owner" + std::to_string (rank + 1);
+
+      Ptr<QuantumChannel> qconn = CreateObject<QuantumChannel> (srcOwner, dstOwner);
+      qconn->SetDepolarModel (0.93, qphyent);
+
+      TelepSrcHelper srcHelper (qphyent, qconn);
+      srcHelper.SetAttribute ("Qubits", PairValue<StringValue, StringValue> (
+                                            {srcOwner + "_Qubit0", srcOwner + "_Qubit1"}));
+      srcHelper.SetAttribute ("Qubit", StringValue (dstOwner + "_Qubit0"));
+      srcHelper.SetAttribute ("Input", PointerValue (rank == 0 ? input : Ptr<Qubit> (nullptr)));
+      ApplicationContainer srcApps = srcHelper.Install (qphyent->GetNode (srcOwner));
+      srcApps.Start (Seconds (TELEP_DELAY * rank));
+      srcApps.Stop (Seconds (TELEP_DELAY * (rank + 1)));
+
+      TelepDstHelper dstHelper (qphyent, qconn);
+      dstHelper.SetAttribute ("Qubit", StringValue (dstOwner + "_Qubit0"));
+      ApplicationContainer dstApps = dstHelper.Install (qphyent->GetNode (dstOwner));
+      dstApps.Start (Seconds (TELEP_DELAY * rank));
+      dstApps.Stop (Seconds (TELEP_DELAY * (rank + 1)));
+    }
+  stop = TELEP_DELAY * (N - 1);
+  return qphyent;
+}
+
+static Ptr<QuantumPhyEntity>
+SetupEntSwap (const BenchConfig &config, double &stop)
+{
+  const unsigned N = config.n;
+  Ptr<QuantumPhyEntity> qphyent = CreateEntity (config, ChainOwners (N, false), CLASSICAL_DELAY);
+  DistributeChain (qphyent, N, CLASSICAL_DELAY);
+
+  std::string dstOwner = "Owner" + std::to_string (N - 1);
+  for (unsigned rank = 1; rank + 1 < N; ++rank)
+    {
+      std::string srcOwner = "Owner" + std::to_string (rank);
+      Ptr<QuantumChannel> qconn = CreateObject<QuantumChannel> (srcOwner, dstOwner);
+
+      EntSwapSrcHelper srcHelper (qphyent, qconn);
+      srcHelper.SetAttribute ("Qubits", PairValue<StringValue, StringValue> (
+                                            {srcOwner + "_QubitEntFromOwner" + std::to_string (rank - 1),
+                                             srcOwner + "_QubitEntToOwner" + std::to_string (rank + 1)}));
+      ApplicationContainer srcApps = srcHelper.Install (qphyent->GetNode (srcOwner));
+      srcApps.Start (Seconds (TELEP_DELAY * rank));
+      srcApps.Stop (Seconds (TELEP_DELAY * (rank + 1)));
+    }
+
+  EntSwapDstHelper dstHelper (qphyent, qphyent->GetNode (dstOwner));
+  dstHelper.SetAttribute ("Qubit", StringValue (dstOwner + "_QubitEntFromOwner" +
+                                                std::to_string (N - 2)));
+  dstHelper.SetAttribute ("Count", UintegerValue (N - 2));
+  ApplicationContainer dstApps = dstHelper.Install (qphyent->GetNode (dstOwner));
+  dstApps.Start (Seconds (CLASSICAL_DELAY));
+  dstApps.Stop (Seconds (TELEP_DELAY * (N - 1)));
+  stop = TELEP_DELAY * (N - 1);
+  return qphyent;
+}
+
+static Ptr<QuantumPhyEntity>
+SetupEntSwapAdapt (const BenchConfig &config, double &stop)
+{
+  const unsigned N = config.n;
+  Ptr<QuantumPhyEntity> qphyent = CreateEntity (config, ChainOwners (N, true), CLASSICAL_DELAY);
+  DistributeChain (qphyent, N, SETUP_DELAY);
+
+  std::vector<std::string> former_qubits_vec = {""};
+  std::vector<std::string> latter_qubits_vec = {"Owner0_QubitEntToOwner1"};
+  for (unsigned rank = 1; rank + 1 < N; ++rank)
+    {
+      former_qubits_vec.push_back ("Owner" + std::to_string (rank) + "_QubitEntFromOwner" +
+                                   std::to_string (rank - 1));
+      latter_qubits_vec.push_back ("Owner" + std::to_string (rank) + "_QubitEntToOwner" +
+                                   std::to_string (rank + 1));
+    }
+  former_qubits_vec.push_back ("Owner" + std::to_string (N - 1) + "_QubitEntFromOwner" +
+                               std::to_string (N - 2));
+  latter_qubits_vec.push_back ("");
+
+  EntSwapAdaptHelper dstHelper (qphyent);
+  dstHelper.SetAttribute ("QubitsFormer",
+                          PointerValue (CreateObject<QuantumMemory> (former_qubits_vec)));
+  dstHelper.SetAttribute ("QubitsLatter",
+                          PointerValue (CreateObject<QuantumMemory> (latter_qubits_vec)));
+  ApplicationContainer dstApps =
+      dstHelper.Install (qphyent->GetNode ("Owner" + std::to_string (N - 1)));
+  dstApps.Start (Seconds (SETUP_DELAY + N * DIST_EPR_DELAY));
+  dstApps.Stop (Seconds (SETUP_DELAY + (N + 1) * DIST_EPR_DELAY));
+  stop = SETUP_DELAY + (N + 1) * DIST_EPR_DELAY;
+  return qphyent;
+}
+
+static Ptr<QuantumPhyEntity>
+SetupEntSwapAdaptLocal (const BenchConfig &config, double &stop)
+{
+  const unsigned N = config.n;
+  Ptr<QuantumPhyEntity> qphyent = CreateEntity (config, ChainOwners (N, true), CLASSICAL_DELAY);
+
+  Ptr<QuantumNode> last_node = qphyent->GetNode ("Owner" + std::to_string (N - 1));
+  last_node->SetDephaseModel (QNS_GATE_PREFIX + "PX", 1.2);
+  last_node->SetDephaseModel (QNS_GATE_PREFIX + "PZ", 1.2);
+
+  std::vector<std::string> former_qubits_vec = {""};
+  std::vector<std::string> latter_qubits_vec = {"Owner0_Qubit1"};
+  for (unsigned rank = 1; rank + 1 < N; ++rank)
+    {
+      former_qubits_vec.push_back ("Owner" + std::to_string (rank) + "_Qubit0");
+      latter_qubits_vec.push_back ("Owner" + std::to_string (rank) + "_Qubit1");
+    }
+  former_qubits_vec.push_back ("Owner" + std::to_string (N - 1) + "_Qubit0");
+  latter_qubits_vec.push_back ("");
+
+  EntSwapAdaptLocalHelper dstHelper (qphyent);
+  dstHelper.SetAttribute ("QubitsFormer",
+                          PointerValue (CreateObject<QuantumMemory> (former_qubits_vec)));
+  dstHelper.SetAttribute ("QubitsLatter",
+                          PointerValue (CreateObject<QuantumMemory> (latter_qubits_vec)));
+  ApplicationContainer dstApps = dstHelper.Install (last_node);
+  dstApps.Start (Seconds (SETUP_DELAY + N * DIST_EPR_DELAY));
+  dstApps.Stop (Seconds (SETUP_DELAY + (N + 1) * DIST_EPR_DELAY));
+  stop = SETUP_DELAY + (N + 1) * DIST_EPR_DELAY;
+  return qphyent;
+}
+
+static Ptr<QuantumPhyEntity>
+SetupDistillNested (const BenchConfig &config, double &stop)
+{
+  const unsigned N = config.n;
+  Ptr<QuantumPhyEntity> qphyent = CreateEntity (config, {"Alice", "Bob"}, 1e-1);
+  Ptr<QuantumNode> alice = qphyent->GetNode ("Alice");
+  Ptr<QuantumNode> bob = qphyent->GetNode ("Bob");
+  alice->SetTimeModel (0.13);
+  bob->SetDephaseModel (QNS_GATE_PREFIX + "CNOT", 0.23);
+
+  Ptr<QuantumChannel> qconn = CreateObject<QuantumChannel> (alice, bob);
+  qconn->SetDepolarModel (0.93, qphyent);
+
+  std::vector<std::string> qubits_alice = {};
+  std::vector<std::string> qubits_bob = {};
+  for (unsigned i = 0; i < N; ++i)
+    {
+      qubits_alice.push_back ("A" + std::to_string (i));
+      qubits_bob.push_back ("B" + std::to_string (i));
+    }
+  Ptr<QuantumMemory> dst_qubits = CreateObject<QuantumMemory> (qubits_bob);
+
+  DistillNestedHelper srcHelper (qphyent, false, qconn);
+  srcHelper.SetAttribute ("SrcQubits", PointerValue (CreateObject<QuantumMemory> (qubits_alice)));
+  srcHelper.SetAttribute ("DstQubits", PointerValue (dst_qubits));
+  ApplicationContainer srcApps = srcHelper.Install (alice);
+  srcApps.Start (Seconds (0.));
+  srcApps.Stop (Seconds (10.));
+
+  DistillNestedHelper dstHelper (qphyent, true, qconn);
+  dstHelper.SetAttribute ("SrcQubits", PointerValue (nullptr));
+  dstHelper.SetAttribute ("DstQubits", PointerValue (dst_qubits));
+  ApplicationContainer dstApps = dstHelper.Install (bob);
+  dstApps.Start (Seconds (0.));
+  dstApps.Stop (Seconds (10.));
+
+  qphyent->AddConn2Apps (qconn, APP_DISTILL_NESTED,
+                         std::make_pair (srcApps.Get (0)->GetObject<DistillNestedApp> (),
+                                         dstApps.Get (0)->GetObject<DistillNestedApp> ()));
+  stop = 10.;
+  return qphyent;
+}
+
+static Ptr<QuantumPhyEntity>
+SetupDistillNestedAdapt (const BenchConfig &config, double &stop)
+{
+  const unsigned N = config.n;
+  Ptr<QuantumPhyEntity> qphyent = CreateEntity (config, {"Alice", "Bob"}, 1e-1);
+  Ptr<QuantumNode> alice = qphyent->GetNode ("Alice");
+  Ptr<QuantumNode> bob = qphyent->GetNode ("Bob");
+  alice->SetTimeModel (2e1);
+  bob->SetTimeModel (2e1);
+
+  Ptr<QuantumChannel> qconn = CreateObject<QuantumChannel> (alice, bob);
+  qconn->SetDepolarModel (0.95, qphyent);
+
+  std::vector<std::string> qubits_alice = {};
+  std::vector<std::string> qubits_bob = {};
+  for (unsigned i = 0; i < N; ++i)
+    {
+      qubits_alice.push_back ("A" + std::to_string (i));
+      qubits_bob.push_back ("B" + std::to_string (i));
+    }
+
+  DistillNestedAdaptHelper helper (qphyent, false, qconn);
+  helper.SetAttribute ("SrcQubits", PointerValue (CreateObject<QuantumMemory> (qubits_alice)));
+  helper.SetAttribute ("DstQubits", PointerValue (CreateObject<QuantumMemory> (qubits_bob)));
+  helper.SetAttribute ("FlagQubit", StringValue ("Flag"));
+  ApplicationContainer apps = helper.Install (alice);
+  apps.Start (Seconds (0.));
+  apps.Stop (Seconds (ETERNITY));
+  stop = ETERNITY;
+  return qphyent;
+}
+
+static const std::map<std::string, Ptr<QuantumPhyEntity> (*) (const BenchConfig &, double &)>
+    g_protocols = {
+    {"telep-lin", &SetupTelepLin},
+    {"ent-swap", &SetupEntSwap},
+    {"ent-swap-adapt", &SetupEntSwapAdapt},
+    {"ent-swap-adapt-local", &SetupEntSwapAdaptLocal},
+    {"distill-nested", &SetupDistillNested},
+    {"distill-nested-adapt", &SetupDistillNestedAdapt}};
+
+/**
+ * \brief Read the peak RSS of this process since its last reset.
+ * \return VmHWM in KiB, or -1 if unknown.
+*/
+static long
+ReadPeakRss ()
+{
+  std::ifstream status ("/proc/self/status");
+  std::string line;
+  while (std::getline (status, line))
+    {
+      if (line.rfind ("VmHWM:", 0) == 0)
+        {
+          return std::stol (line.substr (6));
+        }
+    }
+  return -1;
+}
+
+/**
+ * \brief Run a configuration in a child process.
+ * \param warmup The number of unmeasured runs the child does first.
+ * \return The measurements, where ok is false if the child failed.
+*/
+static BenchResult
+RunOnce (const BenchConfig &config, const unsigned &warmup)
+{
+  BenchResult result = {false, 0., {0, 0, 0., 0.}, 0., 0};
+  int fds[2];
+  if (pipe (fds) != 0)
+    {
+      return result;
+    }
+  std::cout.flush ();
+  pid_t pid = fork ();
+  if (pid < 0)
+    {
+      close (fds[0]);
+      close (fds[1]);
+      return result;
+    }
+
+  if (pid == 0)
+    {
+      // child: simulate, then report the measurements through the pipe;
+      // anything it prints would interleave with the JSON on the standard output
+      close (fds[0]);
+      int null = open ("/dev/null", O_WRONLY);
+      if (null >= 0)
+        {
+          dup2 (null, STDOUT_FILENO);
+          close (null);
+        }
+      double stop = 0.;
+      for (unsigned w = 0; w < warmup; ++w)
+        {
+          Ptr<QuantumPhyEntity> warm = g_protocols.at (config.protocol) (config, stop);
+          Simulator::Stop (Seconds (stop));
+          Simulator::Run ();
+          Simulator::Destroy ();
+        }
+
+      // the warm-up entities are gone, so reset the peak RSS to what they left behind
+#ifdef __GLIBC__
+      malloc_trim (0);
+#endif
+      bool reset = warmup == 0 ||
+                   static_cast<bool> (std::ofstream ("/proc/self/clear_refs") << "5" << std::flush);
+      Ptr<QuantumPhyEntity> qphyent = g_protocols.at (config.protocol) (config, stop);
+      Simulator::Stop (Seconds (stop));
+      auto start = std::chrono::steady_clock::now ();
+      Simulator::Run ();
+      auto end = std::chrono::steady_clock::now ();
+      result.ok = true;
+      result.wall = std::chrono::duration<double> (end - start).count ();
+      result.stats = qphyent->GetEvalStats ();
+      result.trunc_err = qphyent->GetTruncationError ();
+      result.peak_rss_kb = reset ? ReadPeakRss () : -1;
+      bool written = write (fds[1], &result, sizeof (result)) == (ssize_t) sizeof (result);
+      close (fds[1]);
+      Simulator::Destroy ();
+      _exit (written ? 0 : 1);
+    }
+
+  // parent: collect the measurements, and the peak RSS of the child if it could not reset it
+  close (fds[1]);
+  BenchResult reported = result;
+  bool got = read (fds[0], &reported, sizeof (reported)) == (ssize_t) sizeof (reported);
+  close (fds[0]);
+  int status = 0;
+  struct rusage usage;
+  if (wait4 (pid, &status, 0, &usage) == pid && got && WIFEXITED (status) &&
+      WEXITSTATUS (status) == 0)
+    {
+      result = reported;
+      if (result.peak_rss_kb < 0)
+        {
+          result.peak_rss_kb = usage.ru_maxrss; // in KiB on Linux, the warm-ups included
+        }
+    }
+  return result;
+}
+
+static void
+WriteConfig (std::ostream &out, const BenchConfig &config, const std::vector<BenchResult> &runs,
+             const unsigned &warmup)
+{
+  out << "    {\"protocol\": \"" << config.protocol << "\", \"n\": " << config.n
+      << ", \"optimizer\": \"" << config.optimizer << "\", \"backend\": \"" << config.backend
+      << "\", \"warmup\": " << warmup << ",\n     \"runs\": [";
+
+  double sum = 0., sum_sq = 0., min = INFINITY, max = 0.;
+  unsigned ok = 0;
+  for (unsigned i = 0; i < runs.size (); ++i)
+    {
+      const BenchResult &run = runs[i];
+      out << (i ? ",\n              " : "") << "{\"ok\": " << (run.ok ? "true" : "false")
+          << ", \"wall_s\": " << run.wall << ", \"evaluations\": " << run.stats.evaluations
+          << ", \"max_tensors\": " << run.stats.max_tensors << ", \"flops\": " << run.stats.flops
+          << ", \"eval_s\": " << run.stats.seconds << ", \"trunc_err\": " << run.trunc_err
+          << ", \"peak_rss_kb\": " << run.peak_rss_kb << "}";
+      if (run.ok)
+        {
+          ++ok;
+          sum += run.wall;
+          sum_sq += run.wall * run.wall;
+          min = std::min (min, run.wall);
+          max = std::max (max, run.wall);
+        }
+    }
+  out << "],\n     \"summary\": {\"ok\": " << ok;
+  if (ok)
+    {
+      double mean = sum / ok;
+      double stddev = sqrt (std::max (0., sum_sq / ok - mean * mean));
+      out << ", \"wall_mean_s\": " << mean << ", \"wall_stddev_s\": " << stddev
+          << ", \"wall_min_s\": " << min << ", \"wall_max_s\": " << max;
+    }
+  out << "}}";
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string protocols = "telep-lin,ent-swap,ent-swap-adapt,ent-swap-adapt-local,"
+                          "distill-nested,distill-nested-adapt";
+  std::string sizes = "4,8";
+  std::string optimizers = "greed";
+  std::string backends = "exatn";
+  unsigned warmup = 1;
+  unsigned reps = 3;
+  std::string output = "";
+  CommandLine cmd;
+  cmd.AddValue ("protocols", "Comma-separated protocols to run", protocols);
+  cmd.AddValue ("sizes", "Comma-separated numbers of owners, or of EPR pairs to distill", sizes);
+  cmd.AddValue ("optimizers", "Comma-separated contraction sequence optimizers", optimizers);
+  cmd.AddValue ("backends", "Comma-separated backends, \"exatn\" or \"mps\"", backends);
+  cmd.AddValue ("warmup", "Number of unmeasured runs before each measured one, in its process", warmup);
+  cmd.AddValue ("reps", "Number of measured runs of each configuration", reps);
+  cmd.AddValue ("output", "Path of the JSON output, or empty for the standard output", output);
+  cmd.Parse (argc, argv);
+
+  std::vector<BenchConfig> configs = {};
+  for (const std::string &protocol : SplitList (protocols))
+    {
+      if (g_protocols.find (protocol) == g_protocols.end ())
+        {
+          std::cerr << "Unknown protocol " << protocol << std::endl;
+          return 1;
+        }
+      for (const std::string &size : SplitList (sizes))
+        {
+          for (const std::string &optimizer : SplitList (optimizers))
+            {
+              for (const std::string &backend : SplitList (backends))
+                {
+                  configs.push_back ({protocol, (unsigned) std::stoul (size), optimizer, backend});
+                }
+            }
+        }
+    }
+
+  std::ofstream file;
+  if (output != "")
+    {
+      file.open (output);
+    }
+  std::ostream &out = output != "" ? file : std::cout;
+  out << "{\n  \"warmup\": " << warmup << ",\n  \"reps\": " << reps << ",\n  \"results\": [\n";
+  for (unsigned i = 0; i < configs.size (); ++i)
+    {
+      const BenchConfig &config = configs[i];
+      std::clog << "Benchmarking " << config.protocol << " with n = " << config.n << ", "
+                << config.optimizer << " on " << config.backend << std::endl;
+      std::vector<BenchResult> runs = {};
+      for (unsigned r = 0; r < reps; ++r)
+        {
+          runs.push_back (RunOnce (config, warmup));
+          std::clog << "  run " << r << ": " << (runs.back ().ok ? "" : "failed, ")
+                    << runs.back ().wall << " s, " << runs.back ().peak_rss_kb << " KiB"
+                    << std::endl;
+        }
+      WriteConfig (out, config, runs, warmup);
+      out << (i + 1 < configs.size () ? ",\n" : "\n");
+    }
+  out << "  ]\n}\n";
+  return 0;
+}
@@ -0,0 +1,79 @@
+/*
+  Replay an operation trace recorded through the TraceFile attribute of QuantumPhyEntity,
+  without any networking, and report the time spent in each kind of call.
+  To run this example:
+  ./ns3 run "qns-replay --trace=telep.qnstrace --optimizer=metis --precision=single"
+*/
+#include "ns3/command-line.h" // class CommandLine
+
+#include "ns3/quantum-basis.h"
+#include "ns3/quantum-phy-entity.h" // class QuantumPhyEntity
+#include "ns3/quantum-trace.h" // class QuantumTraceReader
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+NS_LOG_COMPONENT_DEFINE ("QnsReplay");
+
+using namespace ns3;
+
+int
+main (int argc, char *argv[])
+{
+  std::string trace = "";
+  std::string backend = "exatn";
+  std::string optimizer = "";
+  std::string precision = "double";
+  CommandLine cmd;
+  cmd.AddValue ("trace", "Path of the operation trace", trace);
+  cmd.AddValue ("backend", "Backend holding the density matrix, \"exatn\" or \"mps\"", backend);
+  cmd.AddValue ("optimizer", "Contraction sequence optimizer overriding the recorded ones",
+                optimizer);
+  cmd.AddValue ("precision", "Precision of the tensors, \"double\" or \"single\"", precision);
+  cmd.Parse (argc, argv);
+
+  Ptr<QuantumTraceReader> reader = CreateObject<QuantumTraceReader> (trace);
+  if (! reader->IsValid ())
+    {
+      std::cerr << "Cannot replay " << trace << std::endl;
+      return 1;
+    }
+
+  Ptr<QuantumPhyEntity> qphyent = CreateObject<QuantumPhyEntity> (reader->GetOwners ());
+  qphyent->SetAttribute ("Backend", StringValue (backend));
+  qphyent->SetAttribute ("Precision", StringValue (precision));
+  if (optimizer != "")
+    {
+      qphyent->SetAttribute ("Optimizer", StringValue (optimizer));
+    }
+
+  // replay and time each record
+  std::map<QuantumTraceRecord::Kind, std::pair<unsigned, double>> kind2stats = {};
+  QuantumTraceRecord record = {QuantumTraceRecord::CHECKPOINT};
+  auto start = std::chrono::steady_clock::now ();
+  while (reader->Read (record))
+    {
+      if (record.kind == QuantumTraceRecord::CONTRACT && optimizer != "")
+        {
+          record.name = optimizer;
+        }
+      auto begin = std::chrono::steady_clock::now ();
+      qphyent->Replay (record);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - begin;
+      ++kind2stats[record.kind].first;
+      kind2stats[record.kind].second += elapsed.count ();
+    }
+  std::chrono::duration<double> total = std::chrono::steady_clock::now () - start;
+
+  printf ("%-28s %10s %14s %14s\n", "call", "count", "total (s)", "mean (ms)");
+  for (const auto &[kind, stats] : kind2stats)
+    {
+      printf ("%-28s %10u %14.6f %14.6f\n", GetTraceKindName (kind).c_str (), stats.first,
+              stats.second, 1e3 * stats.second / stats.first);
+    }
+  printf ("%-28s %10s %14.6f\n", "total", "", total.count ());
+
+  Simulator::Destroy ();
+  return 0;
+}
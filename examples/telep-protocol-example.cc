@@ -0,0 +1,113 @@
+#include "ns3/csma-module.h" // class CsmaHelper, NetDeviceContainer
+#include "ns3/internet-module.h" // class InternetStackHelper, Ipv6AddressHelper, Ipv6InterfaceContainer
+#include "ns3/command-line.h" // class CommandLine
+
+#include "ns3/quantum-basis.h"
+#include "ns3/quantum-network-simulator.h" // class QuantumNetworkSimulator
+#include "ns3/quantum-phy-entity.h" // class QuantumPhyEntity
+#include "ns3/quantum-node.h" // class QuantumNode
+#include "ns3/quantum-channel.h" // class QuantumChannel
+#include "ns3/distribute-epr-helper.h" // class DistributeEPRSrcHelper, DistributeEPRDstHelper
+#include "ns3/quantum-net-stack-helper.h" // class QuantumNetStackHelper
+#include "ns3/quantum-protocol.h" // class QuantumProtocol
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TelepProtocolExample");
+
+int
+main (int argc, char *argv[])
+{
+  bool adapt = false;
+  CommandLine cmd;
+  cmd.AddValue ("adapt", "Compile the protocol into the control-flow adapted form", adapt);
+  cmd.Parse (argc, argv);
+
+  //
+  // Create a quantum physical entity with three nodes.
+  //
+  std::vector<std::string> owners = {"Alice", "Bob", "God"};
+  Ptr<QuantumPhyEntity> qphyent = CreateObject<QuantumPhyEntity> (owners);
+
+  NodeContainer nodes;
+  Ptr<QuantumNode> alice = qphyent->GetNode ("Alice");
+  nodes.Add (alice);
+
+  Ptr<QuantumNode> bob = qphyent->GetNode ("Bob");
+  nodes.Add (bob);
+
+  Ptr<QuantumNode> god = qphyent->GetNode ("God");
+  nodes.Add (god);
+
+  //
+  // Create a classical connection.
+  //
+  CsmaHelper csmaHelper;
+  csmaHelper.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("1000kbps")));
+  csmaHelper.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (2)));
+  NetDeviceContainer devices = csmaHelper.Install (nodes);
+
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Ipv6AddressHelper address;
+  address.SetBase ("2001:1::", Ipv6Prefix (64));
+  Ipv6InterfaceContainer interfaces = address.Assign (devices);
+
+  unsigned rank = 0;
+  for (const std::string &owner : owners)
+    {
+      qphyent->SetOwnerAddress (owner, interfaces.GetAddress (rank, 1));
+      qphyent->SetOwnerRank (owner, rank);
+      ++rank;
+    }
+
+  //
+  // Install quantum network stack.
+  //
+  QuantumNetStackHelper qstack;
+  qstack.Install (nodes);
+
+  Ptr<QuantumChannel> qconn =
+      CreateObject<QuantumChannel> (std::pair<std::string, std::string>{"Alice", "Bob"});
+  qconn->SetDepolarModel (0.93, qphyent);
+
+  //
+  // Describe the teleportation once, in either form.
+  //
+  Ptr<QuantumProtocol> protocol = CreateObject<QuantumProtocol> (qphyent, adapt);
+  protocol->AddGenerate (Seconds (0.), "Alice",
+                         std::vector<std::complex<double>>{{sqrt (5. / 7.), 0.0},
+                                                           {0.0, sqrt (2. / 7.)}},
+                         {"Alice0"});
+  protocol->AddEPR (Seconds (0.), qconn, {"Alice1", "Bob0"});
+
+  // Alice applies local operations and measures
+  protocol->AddGate (Seconds (CLASSICAL_DELAY), "Alice", QNS_GATE_PREFIX + "CNOT", {},
+                     {"Alice1", "Alice0"});
+  protocol->AddGate (Seconds (CLASSICAL_DELAY), "Alice", QNS_GATE_PREFIX + "H", {}, {"Alice0"});
+  protocol->AddMeasure (Seconds (CLASSICAL_DELAY), "Alice", {"Alice0", "Alice1"}, {"m0", "m1"});
+  protocol->AddTrace (Seconds (CLASSICAL_DELAY), {"Alice0", "Alice1"});
+
+  // Bob corrects after the outcomes arrive
+  protocol->AddConditionalGate (Seconds (TELEP_DELAY), "Bob", QNS_GATE_PREFIX + "PX", {}, {"m1"},
+                                {"Bob0"});
+  protocol->AddConditionalGate (Seconds (TELEP_DELAY), "Bob", QNS_GATE_PREFIX + "PZ", {}, {"m0"},
+                                {"Bob0"});
+
+  alice->AddApplication (protocol);
+  protocol->SetStartTime (Seconds (2.));
+  protocol->SetStopTime (Seconds (20.));
+
+  std::vector<std::complex<double>> dm;
+  Simulator::Schedule (Seconds (2. + TELEP_DELAY + CLASSICAL_DELAY), &QuantumPhyEntity::PeekDM,
+                       qphyent, "Bob", std::vector<std::string>{"Bob0"}, dm);
+
+  //
+  // Run the simulation.
+  //
+  Simulator::Stop (Seconds (20.));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  return 0;
+}
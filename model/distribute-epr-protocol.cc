@@ -5,6 +5,10 @@
 #include "ns3/quantum-phy-entity.h" // class QuantumPhyEntity
 #include "ns3/quantum-node.h" // class QuantumNode
 
+#include "ns3/double.h" // class DoubleValue
+
+#include <limits> // std::numeric_limits
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("DistributeEPRProtocol");
@@ -16,7 +20,8 @@ NS_OBJECT_ENSURE_REGISTERED (DistributeEPRSrcProtocol);
 DistributeEPRSrcProtocol::DistributeEPRSrcProtocol (Ptr<QuantumPhyEntity> qphyent_,
                                                     Ptr<QuantumChannel> conn_,
                                                     const std::pair<std::string, std::string> &epr_)
-    : m_data (0), m_dataSize (0), m_size (0), m_qphyent (qphyent_), m_conn (conn_), m_epr (epr_)
+    : m_data (0), m_dataSize (0), m_size (0), m_qphyent (qphyent_), m_conn (conn_), m_epr (epr_),
+      m_success_prob (1.), m_attempt_duration (Seconds (0)), m_herald_delay (Seconds (0))
 {
   SetRemote (m_conn->GetDst (m_qphyent)->GetAddress (), m_conn->GetDst (m_qphyent)->GetNextPort ());
 }
@@ -33,7 +38,8 @@ DistributeEPRSrcProtocol::~DistributeEPRSrcProtocol ()
 }
 
 DistributeEPRSrcProtocol::DistributeEPRSrcProtocol ()
-    : m_data (0), m_dataSize (0), m_size (0), m_qphyent (nullptr), m_epr ({})
+    : m_data (0), m_dataSize (0), m_size (0), m_qphyent (nullptr), m_epr ({}),
+      m_success_prob (1.), m_attempt_duration (Seconds (0)), m_herald_delay (Seconds (0))
 {
 }
 
@@ -64,7 +70,21 @@ DistributeEPRSrcProtocol::GetTypeId ()
               "EPR", "The EPR pair to be distributed",
               PairValue<StringValue, StringValue> (),
               MakePairAccessor<StringValue, StringValue> (&DistributeEPRSrcProtocol::m_epr),
-              MakePairChecker<StringValue, StringValue> ());
+              MakePairChecker<StringValue, StringValue> ())
+          .AddAttribute ("SuccessProbability", "Probability of success of each attempt, above 0",
+                         DoubleValue (1.),
+                         MakeDoubleAccessor (&DistributeEPRSrcProtocol::m_success_prob),
+                         MakeDoubleChecker<double> (std::numeric_limits<double>::min (), 1.))
+          .AddAttribute ("AttemptDuration", "Duration of each attempt", TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&DistributeEPRSrcProtocol::m_attempt_duration),
+                         MakeTimeChecker ())
+          .AddAttribute ("HeraldDelay", "Latency of the herald after the successful attempt",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&DistributeEPRSrcProtocol::m_herald_delay),
+                         MakeTimeChecker ())
+          .AddTraceSource ("Herald", "An EPR pair has been heralded after a number of attempts",
+                           MakeTraceSourceAccessor (&DistributeEPRSrcProtocol::m_herald_trace),
+                           "ns3::DistributeEPRSrcProtocol::HeraldTracedCallback");
   return tid;
 }
 
@@ -74,9 +94,45 @@ DistributeEPRSrcProtocol::GenerateAndDistributeEPR (const std::pair<std::string,
   if (epr != std::pair<std::string, std::string>{})
     SetEPR (epr);
 
-  m_qphyent->GenerateEPR (m_conn, m_epr);
-  
-  Send (epr);
+  // the link table of a physical channel takes over the attributes
+  double success_prob = m_success_prob;
+  Time attempt_duration = m_attempt_duration;
+  Time herald_delay = m_herald_delay;
+  const QuantumLinkTable *table =
+      m_qphyent->GetLinkTable ({m_conn->GetSrcOwner (), m_conn->GetDstOwner ()});
+  if (table)
+    {
+      success_prob = table->success_prob;
+      attempt_duration = table->attempt_duration;
+      herald_delay = table->herald_delay;
+    }
+
+  if (success_prob >= 1. && attempt_duration.IsZero () && herald_delay.IsZero ())
+    {
+      m_qphyent->GenerateEPR (m_conn, m_epr);
+      m_herald_trace (m_epr, 1);
+
+      Send (epr);
+      return;
+    }
+
+  // only the successful attempt becomes an event, however many attempts fail before it
+  uint64_t attempts = SampleFailures (success_prob) + 1;
+  NS_LOG_LOGIC ("Heralding EPR pair " << m_epr.first << " " << m_epr.second << " after "
+                                      << attempts << " attempts");
+  Simulator::Schedule (TimeStep (attempt_duration.GetTimeStep () * attempts),
+                       &DistributeEPRSrcProtocol::DoHerald, this, m_epr, attempts, herald_delay);
+}
+
+void
+DistributeEPRSrcProtocol::DoHerald (const std::pair<std::string, std::string> &epr,
+                                    uint64_t attempts, Time herald_delay)
+{
+  // generated now, so that the memories decohere during the herald latency
+  m_qphyent->GenerateEPR (m_conn, epr);
+  m_herald_trace (epr, attempts);
+
+  Simulator::Schedule (herald_delay, &DistributeEPRSrcProtocol::Send, this, epr);
 }
 
 void
@@ -5,6 +5,8 @@
 
 #include "ns3/socket.h"
 #include "ns3/application.h"
+#include "ns3/nstime.h"
+#include "ns3/traced-callback.h"
 
 #include <complex>
 
@@ -23,8 +25,28 @@ public:
   DistributeEPRSrcProtocol ();
   static TypeId GetTypeId ();
 
+  /**
+   * \brief Generate an EPR pair and distribute its second qubit.
+   *
+   * With a SuccessProbability below 1 or a nonzero AttemptDuration, the link is heralded:
+   * the number of failed attempts is sampled in a single draw,
+   * the pair is generated when the successful attempt ends,
+   * and it is distributed once the herald arrives HeraldDelay later.
+   * The qubits decohere in the memories from the end of the successful attempt.
+   * If the channel has a physical model, its link table replaces the three attributes.
+   *
+   * \param epr Names of the qubits, or empty to keep the previous ones.
+  */
   void GenerateAndDistributeEPR (const std::pair<std::string, std::string> &epr = {});
 
+  /**
+   * \brief TracedCallback signature for a heralded EPR pair.
+   * \param epr Names of the qubits.
+   * \param attempts Number of attempts, including the successful one.
+  */
+  typedef void (*HeraldTracedCallback) (const std::pair<std::string, std::string> &epr,
+                                        uint64_t attempts);
+
   void SetRemote (Address ip, uint16_t port);
   void SetFill (std::string fill);
   void SendPacket (Ptr<Packet> packet, Ipv6Address destination, uint16_t port);
@@ -35,6 +57,12 @@ public:
 private:
   virtual void StartApplication ();
 
+  /**
+   * \brief Generate a heralded EPR pair as its successful attempt ends, and herald it later.
+  */
+  void DoHerald (const std::pair<std::string, std::string> &epr, uint64_t attempts,
+                 Time herald_delay);
+
   Ptr<Socket> m_send_socket; /**< A socket to listen on a specific port */
 
   Address m_peerAddress; //!< Remote peer address
@@ -47,6 +75,11 @@ private:
   Ptr<QuantumPhyEntity> m_qphyent;
   Ptr<QuantumChannel> m_conn;
   std::pair<std::string, std::string> m_epr;
+
+  double m_success_prob; //!< Probability of success of each attempt
+  Time m_attempt_duration; //!< Duration of each attempt
+  Time m_herald_delay; //!< Latency of the herald after the successful attempt
+  TracedCallback<const std::pair<std::string, std::string> &, uint64_t> m_herald_trace;
 };
 
 class DistributeEPRDstProtocol : public Application // Bob
@@ -123,20 +123,21 @@ EntSwapSrcApp::MeasureAndSend ()
                         std::vector<std::complex<double>>{},
                         std::vector<std::string>{m_qubits.first});
 
-  std::pair<unsigned, std::vector<double>> outcome_Q0 =
-      m_qphyent->Measure (m_conn->GetSrcOwner (), {m_qubits.first});
+  // bell measurement in one go, bit 0 on the former qubit and bit 1 on the latter
+  std::pair<unsigned, std::vector<double>> outcome =
+      m_qphyent->Measure (m_conn->GetSrcOwner (), {m_qubits.first, m_qubits.second});
+  unsigned outcome_Q0 = outcome.first & 1;
+  unsigned outcome_Q1 = (outcome.first >> 1) & 1;
   NS_LOG_LOGIC ("     => " << m_conn->GetSrcOwner ()
-                           << "'s former qubit is measured to outcome-0 = " << outcome_Q0.first);
-  std::pair<unsigned, std::vector<double>> outcome_Q1 =
-      m_qphyent->Measure (m_conn->GetSrcOwner (), {m_qubits.second});
+                           << "'s former qubit is measured to outcome-0 = " << outcome_Q0);
   NS_LOG_LOGIC ("     => " << m_conn->GetSrcOwner ()
-                           << "'s latter qubit is measured to outcome-1 = " << outcome_Q1.first);
+                           << "'s latter qubit is measured to outcome-1 = " << outcome_Q1);
 
   
   Simulator::ScheduleNow (&QuantumPhyEntity::PartialTrace, m_qphyent,
                           std::vector<std::string>{m_qubits.first, m_qubits.second});
 
-  std::string outcomes_send = std::to_string (outcome_Q0.first) + std::to_string (outcome_Q1.first);
+  std::string outcomes_send = std::to_string (outcome_Q0) + std::to_string (outcome_Q1);
   SetFill ((uint8_t *) &outcomes_send[0], 3, 1024);
 
   Ptr<Packet> p;
@@ -53,7 +53,7 @@ operator* (std::complex<double> scalar, std::vector<std::complex<double>> vec)
 }
 
 std::vector<std::complex<double>>
-operator+ (std::vector<std::complex<double>> vec1, std::vector<std::complex<double>> vec2)
+operator+ (std::vector<std::complex<double>> vec1, const std::vector<std::complex<double>> &vec2)
 {
   assert (vec1.size () == vec2.size ());
   for (int i = 0; i < vec1.size (); i++)
@@ -64,7 +64,8 @@ operator+ (std::vector<std::complex<double>> vec1, std::vector<std::complex<doub
 }
 
 bool
-operator== (std::vector<std::complex<double>> vec1, std::vector<std::complex<double>> vec2)
+operator== (const std::vector<std::complex<double>> &vec1,
+            const std::vector<std::complex<double>> &vec2)
 {
   assert (vec1.size () == vec2.size ());
   for (int i = 0; i < vec1.size (); i++)
@@ -115,6 +116,334 @@ PickOutcome (const double &prob)
   return {1.0, 0.0};
 }
 
+unsigned
+PickOutcome (const std::vector<double> &probs)
+{
+  NS_LOG_INFO (LIGHT_YELLOW_CODE << "Picking outcome among " << probs.size () << " outcomes" << END_CODE);
+
+  double div = (double) (rand ()) / ((double) (RAND_MAX));
+  for (unsigned i = 0; i < probs.size (); ++i)
+    {
+      if (div < probs[i])
+        return i;
+      div -= probs[i];
+    }
+  // rounding errors, pick the last possible outcome
+  for (unsigned i = probs.size (); i--;)
+    {
+      if (probs[i] > EPS)
+        return i;
+    }
+  return probs.size () - 1;
+}
+
+uint64_t
+SampleFailures (const double &prob)
+{
+  assert (0 < prob && prob <= 1);
+  if (prob >= 1)
+    return 0;
+
+  // invert the geometric distribution, with div in (0, 1]
+  double div = ((double) (rand ()) + 1.) / ((double) (RAND_MAX) + 1.);
+  double failures = std::floor (std::log (div) / std::log1p (-prob));
+  NS_LOG_INFO (LIGHT_YELLOW_CODE << "Sampled " << failures << " failed attempts with success probability " << prob << END_CODE);
+  return (uint64_t) failures;
+}
+
+bool
+IsDiagonal (const std::vector<std::complex<double>> &data)
+{
+  unsigned dim = std::sqrt (data.size ());
+  assert (dim * dim == data.size ());
+  for (unsigned i = 0; i < data.size (); ++i)
+    {
+      if (i % dim != i / dim && norm (data[i]) > EPS)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+bool
+IsTracePreserving (const std::vector<std::vector<std::complex<double>>> &kraus)
+{
+  if (kraus.empty ())
+    {
+      return false;
+    }
+  unsigned dim = std::sqrt (kraus[0].size ());
+  assert (dim * dim == kraus[0].size ());
+  for (unsigned a = 0; a < dim; ++a)
+    {
+      for (unsigned b = 0; b < dim; ++b)
+        {
+          std::complex<double> sum = 0.0;
+          for (const std::vector<std::complex<double>> &op : kraus)
+            {
+              assert (op.size () == dim * dim);
+              for (unsigned r = 0; r < dim; ++r)
+                {
+                  sum += std::conj (op[r * dim + a]) * op[r * dim + b];
+                }
+            }
+          if (norm (sum - (a == b ? 1.0 : 0.0)) > EPS)
+            {
+              return false;
+            }
+        }
+    }
+  return true;
+}
+
+std::vector<std::complex<double>>
+TraceOutHost (const std::vector<std::complex<double>> &dm, const std::vector<unsigned> &keep)
+{
+  unsigned dim = std::sqrt (dm.size ());
+  assert (dim * dim == dm.size ());
+  unsigned dim_keep = 1 << keep.size ();
+  unsigned mask = 0;
+  for (const unsigned &k : keep)
+    {
+      mask |= 1 << k;
+    }
+
+  // scatter the bits of a kept index onto the positions of the kept qubits
+  auto scatter = [&keep] (unsigned idx) {
+    unsigned out = 0;
+    for (unsigned i = 0; i < keep.size (); ++i)
+      {
+        out |= ((idx >> i) & 1) << keep[i];
+      }
+    return out;
+  };
+
+  std::vector<std::complex<double>> reduced (dim_keep * dim_keep, 0.0);
+  for (unsigned e = 0; e < dim; ++e)
+    {
+      if (e & mask)
+        {
+          continue;
+        }
+      for (unsigned r = 0; r < dim_keep; ++r)
+        {
+          for (unsigned c = 0; c < dim_keep; ++c)
+            {
+              reduced[r + dim_keep * c] += dm[(scatter (r) | e) + dim * (scatter (c) | e)];
+            }
+        }
+    }
+  return reduced;
+}
+
+double
+GetFidelity (const std::vector<std::complex<double>> &dm,
+             const std::vector<std::complex<double>> &state)
+{
+  unsigned dim = state.size ();
+  assert (dm.size () == dim * dim);
+  std::complex<double> overlap = 0.0;
+  for (unsigned r = 0; r < dim; ++r)
+    {
+      for (unsigned c = 0; c < dim; ++c)
+        {
+          overlap += std::conj (state[r]) * dm[r + dim * c] * state[c];
+        }
+    }
+  assert (abs (overlap.imag ()) < EPS);
+  return overlap.real ();
+}
+
+std::vector<std::complex<double>>
+GetPauliString (const std::string &pauli)
+{
+  const std::map<char, std::vector<std::complex<double>>> char2pauli = {
+      {'I', pauli_I}, {'X', pauli_X}, {'Y', pauli_Y}, {'Z', pauli_Z}};
+
+  // qubit i is bit i, so the later characters are the higher bits
+  std::vector<std::complex<double>> data = {1.0};
+  unsigned dim = 1;
+  for (const char &p : pauli)
+    {
+      assert (char2pauli.find (p) != char2pauli.end ());
+      const std::vector<std::complex<double>> &single = char2pauli.at (p);
+      std::vector<std::complex<double>> next (dim * dim * 4, 0.0);
+      for (unsigned r = 0; r < (dim << 1); ++r)
+        {
+          for (unsigned c = 0; c < (dim << 1); ++c)
+            {
+              next[r * (dim << 1) + c] =
+                  single[(r / dim) * 2 + c / dim] * data[(r % dim) * dim + c % dim];
+            }
+        }
+      data = next;
+      dim <<= 1;
+    }
+  return data;
+}
+
+void
+SplitBranches (const std::vector<std::complex<double>> &dm, const unsigned &k,
+               std::vector<double> &probs, std::vector<std::vector<std::complex<double>>> &states)
+{
+  unsigned dim = std::sqrt (dm.size ());
+  assert (dim * dim == dm.size () && (1u << k) <= dim);
+  unsigned dim_meas = 1 << k;
+  unsigned dim_rest = dim / dim_meas;
+
+  // the measured qubits are the low bits of a row or column index
+  probs.assign (dim_meas, 0.0);
+  states.assign (dim_meas, {});
+  for (unsigned o = 0; o < dim_meas; ++o)
+    {
+      for (unsigned r = 0; r < dim_rest; ++r)
+        {
+          unsigned i = o | (r << k);
+          probs[o] += dm[i + dim * i].real ();
+        }
+      probs[o] = std::max (probs[o], 0.0);
+      if (probs[o] < EPS)
+        {
+          continue;
+        }
+      states[o].resize (dim_rest * dim_rest);
+      for (unsigned r = 0; r < dim_rest; ++r)
+        {
+          for (unsigned c = 0; c < dim_rest; ++c)
+            {
+              states[o][r + dim_rest * c] = dm[(o | (r << k)) + dim * (o | (c << k))] / probs[o];
+            }
+        }
+    }
+}
+
+void
+EigenHermitian (const std::vector<std::complex<double>> &data, std::vector<double> &evals,
+                std::vector<std::complex<double>> &evecs)
+{
+  unsigned dim = std::sqrt (data.size ());
+  assert (dim * dim == data.size ());
+  std::vector<std::complex<double>> a = data;
+  evecs.assign (dim * dim, 0.0);
+  for (unsigned i = 0; i < dim; ++i)
+    {
+      evecs[i * dim + i] = 1.0;
+    }
+
+  double scale = 0.;
+  for (const std::complex<double> &val : a)
+    {
+      scale += std::norm (val);
+    }
+  for (unsigned sweep = 0; sweep < 64; ++sweep)
+    {
+      double off = 0.;
+      for (unsigned p = 0; p < dim; ++p)
+        {
+          for (unsigned q = p + 1; q < dim; ++q)
+            {
+              off += std::norm (a[p * dim + q]);
+            }
+        }
+      if (off <= 1e-28 * scale)
+        {
+          break;
+        }
+
+      for (unsigned p = 0; p < dim; ++p)
+        {
+          for (unsigned q = p + 1; q < dim; ++q)
+            {
+              double r = std::abs (a[p * dim + q]);
+              if (r < 1e-300)
+                {
+                  continue;
+                }
+              // the phase makes the (p, q) entry real, then a real rotation zeroes it
+              std::complex<double> phase = a[p * dim + q] / r;
+              double theta = (a[q * dim + q].real () - a[p * dim + p].real ()) / (2. * r);
+              double t = (theta >= 0. ? 1. : -1.) / (std::abs (theta) + std::sqrt (theta * theta + 1.));
+              double c = 1. / std::sqrt (t * t + 1.);
+              double s = t * c;
+              std::complex<double> g_qp = -s * std::conj (phase);
+              std::complex<double> g_qq = c * std::conj (phase);
+
+              for (unsigned k = 0; k < dim; ++k)
+                { // columns, A G
+                  std::complex<double> akp = a[k * dim + p], akq = a[k * dim + q];
+                  a[k * dim + p] = c * akp + g_qp * akq;
+                  a[k * dim + q] = s * akp + g_qq * akq;
+                  std::complex<double> vkp = evecs[k * dim + p], vkq = evecs[k * dim + q];
+                  evecs[k * dim + p] = c * vkp + g_qp * vkq;
+                  evecs[k * dim + q] = s * vkp + g_qq * vkq;
+                }
+              for (unsigned k = 0; k < dim; ++k)
+                { // rows, G^dagger A
+                  std::complex<double> apk = a[p * dim + k], aqk = a[q * dim + k];
+                  a[p * dim + k] = c * apk + std::conj (g_qp) * aqk;
+                  a[q * dim + k] = s * apk + std::conj (g_qq) * aqk;
+                }
+            }
+        }
+    }
+
+  evals.resize (dim);
+  for (unsigned i = 0; i < dim; ++i)
+    {
+      evals[i] = a[i * dim + i].real ();
+    }
+}
+
+void
+WriteBinary (std::ostream &out, const std::string &str)
+{
+  WriteBinary<uint64_t> (out, str.size ());
+  out.write (str.data (), str.size ());
+}
+
+std::string
+ReadBinaryString (std::istream &in)
+{
+  std::string str (ReadBinarySize (in), '\0');
+  in.read (&str[0], str.size ());
+  return str;
+}
+
+uint64_t
+ReadBinarySize (std::istream &in, const uint64_t &elem_size)
+{
+  uint64_t size = ReadBinary<uint64_t> (in);
+  std::streampos pos = in.tellg ();
+  if (in && pos >= 0)
+    {
+      in.seekg (0, std::ios::end);
+      std::streampos end = in.tellg ();
+      in.seekg (pos);
+      if (end >= pos && size > uint64_t (end - pos) / elem_size)
+        {
+          in.setstate (std::ios::failbit);
+        }
+    }
+  return in ? size : 0;
+}
+
+void
+WriteBinary (std::ostream &out, const std::vector<std::complex<double>> &data)
+{
+  WriteBinary<uint64_t> (out, data.size ());
+  out.write (reinterpret_cast<const char *> (data.data ()),
+             data.size () * sizeof (std::complex<double>));
+}
+
+std::vector<std::complex<double>>
+ReadBinaryComplex (std::istream &in)
+{
+  std::vector<std::complex<double>> data (ReadBinarySize (in, sizeof (std::complex<double>)));
+  in.read (reinterpret_cast<char *> (data.data ()), data.size () * sizeof (std::complex<double>));
+  return data;
+}
+
 std::vector<std::complex<double>> GetEPRwithFidelity (const double &f)
 {
   std::vector<std::complex<double>> epr_dm = {
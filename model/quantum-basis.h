@@ -25,8 +25,13 @@
 #include <vector>
 #include <complex>
 #include <map>
+#include <deque>
+#include <set>
 #include <cmath>
 #include <climits>
+#include <functional>
+#include <iostream>
+#include <type_traits>
 
 namespace ns3 {
 
@@ -35,6 +40,9 @@ namespace ns3 {
 /** Threshold to check if a double is zero. */
 #define EPS (1e-6)
 
+/** Threshold to check if a value read back from a single-precision tensor is zero. */
+#define EPS_SINGLE (1e-4)
+
 /** A large enough number of seconds since each Simulator::Run (). */
 #define ETERNITY (1e5)
 
@@ -53,6 +61,15 @@ namespace ns3 {
 
 #define SETUP_DELAY (0.1) // seconds
 
+/** Maximum number of reduced density matrices cached by the simulator. */
+#define QNS_RDM_CACHE_SIZE (64)
+
+/** Alignment in bytes of the tensor data in a checkpoint, so that it can be memory-mapped. */
+#define QNS_CHECKPOINT_ALIGN (64)
+
+/** Maximum number of qubits whose joint reduced density matrix serves a batch of metrics. */
+#define QNS_BATCH_MAX_QUBITS (6)
+
 
 /* logging color */
 
@@ -86,6 +103,15 @@ const std::string QNS_TRACE_PREFIX = QNS_PREFIX + "TRACED";
 const std::string QNS_EXATN_PREFIX = QNS_PREFIX + "EXATN";
 const std::string QNS_ANCILLA_PREFIX = QNS_PREFIX + "ANCILLA";
 
+/** Suffix of the ExaTN tensors shared by name in single precision, apart from the double ones. */
+const std::string QNS_SINGLE_SUFFIX = "_C32";
+
+/** Magic number at the beginning of a checkpoint file, with the format version. */
+const std::string QNS_CHECKPOINT_MAGIC = "QNSCKPT3";
+
+/** Magic number at the beginning of an operation trace, with the format version. */
+const std::string QNS_TRACE_MAGIC = "QNSTRAC1";
+
 const std::string QNS_TELEP_PREFIX = QNS_PREFIX + "TELEP";
 const std::string QNS_DISTILL_PREFIX = QNS_PREFIX + "DISTILL";
 
@@ -111,10 +137,10 @@ std::vector<std::complex<double>> operator* (std::complex<double> scalar,
                                              std::vector<std::complex<double>> complexVec);
 
 std::vector<std::complex<double>> operator+ (std::vector<std::complex<double>> complex1,
-                                             std::vector<std::complex<double>> complex2);
+                                             const std::vector<std::complex<double>> &complex2);
 
-bool operator== (std::vector<std::complex<double>> complex1,
-                 std::vector<std::complex<double>> complex2);
+bool operator== (const std::vector<std::complex<double>> &complex1,
+                 const std::vector<std::complex<double>> &complex2);
 
 unsigned Log2 (unsigned size);
 
@@ -131,6 +157,187 @@ std::vector<std::string> GetSufHalf (const std::vector<std::string> &qubits);
 */
 std::complex<double> PickOutcome (const double &prob);
 
+/**
+ * \brief Pick an outcome according to the probability distribution.
+ * \param probs The probability of each outcome.
+ * \return Index of the outcome.
+*/
+unsigned PickOutcome (const std::vector<double> &probs);
+
+/**
+ * \brief Sample the number of failed attempts before the first success, in a single draw.
+ * \param prob The probability of success of each attempt.
+ * \return Number of failed attempts, geometrically distributed.
+*/
+uint64_t SampleFailures (const double &prob);
+
+/**
+ * \brief Check if a square matrix is diagonal.
+ * \param data Data of the matrix.
+ * \return True if all the off-diagonal entries are zero.
+ * 
+ * \note The data size must be a square number.
+*/
+bool IsDiagonal (const std::vector<std::complex<double>> &data);
+
+/**
+ * \brief Check if Kraus operators preserve the trace, i.e. sum_k k^dagger k = I.
+ * \param kraus Kraus operators, each a square matrix of the same size.
+ * \return True if the sum is the identity up to EPS.
+*/
+bool IsTracePreserving (const std::vector<std::vector<std::complex<double>>> &kraus);
+
+/**
+ * \brief Trace out all but some qubits of a density matrix on the host.
+ * \param dm Density matrix of the qubits, in the layout of QuantumNetworkSimulator::PeekDM.
+ * \param keep Indices of the qubits to keep, where the i-th one becomes the i-th qubit.
+ * \return The reduced density matrix.
+*/
+std::vector<std::complex<double>> TraceOutHost (const std::vector<std::complex<double>> &dm,
+                                                const std::vector<unsigned> &keep);
+
+/**
+ * \brief Calculate the fidelity of a density matrix to a pure state on the host.
+ * \param dm Density matrix of the qubits, in the layout of QuantumNetworkSimulator::PeekDM.
+ * \param state State vector of the qubits.
+ * \return The fidelity <state|dm|state>.
+*/
+double GetFidelity (const std::vector<std::complex<double>> &dm,
+                    const std::vector<std::complex<double>> &state);
+
+/**
+ * \brief Get the matrix of a Pauli string.
+ * \param pauli Pauli string such as "XIZ", whose i-th character acts on the i-th qubit.
+ * \return Data of the matrix.
+*/
+std::vector<std::complex<double>> GetPauliString (const std::string &pauli);
+
+/**
+ * \brief Split a density matrix into the branches of measuring its first k qubits.
+ * \param dm Density matrix of the qubits, in the layout of QuantumNetworkSimulator::PeekDM.
+ * \param k Number of the measured qubits.
+ * \param probs Vector to store the probability of each outcome.
+ * \param states Vector to store the normalized state of the other qubits for each outcome,
+ * which is left empty if the outcome is impossible.
+*/
+void SplitBranches (const std::vector<std::complex<double>> &dm, const unsigned &k,
+                    std::vector<double> &probs,
+                    std::vector<std::vector<std::complex<double>>> &states);
+
+/**
+ * \brief Diagonalize a Hermitian matrix by cyclic complex Jacobi rotations.
+ * \param data Data of the row-major matrix.
+ * \param evals Vector to store the eigenvalues.
+ * \param evecs Vector to store the row-major unitary whose i-th column is the i-th eigenvector.
+ *
+ * \note The data size must be a square number.
+*/
+void EigenHermitian (const std::vector<std::complex<double>> &data, std::vector<double> &evals,
+                     std::vector<std::complex<double>> &evecs);
+
+/**
+ * \brief A non-owning view of contiguous elements, such as the qubit handles of a gate.
+ *
+ * It stands in for std::span, which C++17 lacks. The viewed elements must outlive the view,
+ * so a view of a braced list is only good for the call it is passed to.
+*/
+template <typename T>
+class QuantumSpan
+{
+public:
+  QuantumSpan () : m_data (nullptr), m_size (0)
+  {
+  }
+  QuantumSpan (const T *data, size_t size) : m_data (data), m_size (size)
+  {
+  }
+  QuantumSpan (const std::vector<T> &vec) : m_data (vec.data ()), m_size (vec.size ())
+  {
+  }
+  QuantumSpan (std::initializer_list<T> list) : m_data (list.begin ()), m_size (list.size ())
+  {
+  }
+
+  const T *
+  begin () const
+  {
+    return m_data;
+  }
+  const T *
+  end () const
+  {
+    return m_data + m_size;
+  }
+  size_t
+  size () const
+  {
+    return m_size;
+  }
+  const T &
+  operator[] (size_t i) const
+  {
+    return m_data[i];
+  }
+
+private:
+  const T *m_data;
+  size_t m_size;
+};
+
+/**
+ * \brief Write a trivially copyable value to a checkpoint, as its bytes in host order.
+ * \param out Binary output stream.
+ * \param value The value.
+*/
+template <typename T>
+void
+WriteBinary (std::ostream &out, const T &value)
+{
+  static_assert (std::is_trivially_copyable<T>::value, "only raw bytes are written");
+  out.write (reinterpret_cast<const char *> (&value), sizeof (T));
+}
+
+/**
+ * \brief Read a trivially copyable value from a checkpoint.
+ * \param in Binary input stream.
+ * \return The value.
+*/
+template <typename T>
+T
+ReadBinary (std::istream &in)
+{
+  static_assert (std::is_trivially_copyable<T>::value, "only raw bytes are read");
+  T value = {}; // zero if the stream has failed
+  in.read (reinterpret_cast<char *> (&value), sizeof (T));
+  return value;
+}
+
+/**
+ * \brief Write a string to a checkpoint, prefixed by its length.
+*/
+void WriteBinary (std::ostream &out, const std::string &str);
+
+std::string ReadBinaryString (std::istream &in);
+
+/**
+ * \brief Read the size prefixing some elements in a checkpoint.
+ *
+ * A size that a seekable stream has not enough bytes left for is corrupt,
+ * so it fails the stream instead of being allocated.
+ *
+ * \param in Binary input stream.
+ * \param elem_size Least number of bytes of each element.
+ * \return The size, or 0 if the stream has failed.
+*/
+uint64_t ReadBinarySize (std::istream &in, const uint64_t &elem_size = 1);
+
+/**
+ * \brief Write a vector of complex numbers to a checkpoint, prefixed by its size.
+*/
+void WriteBinary (std::ostream &out, const std::vector<std::complex<double>> &data);
+
+std::vector<std::complex<double>> ReadBinaryComplex (std::istream &in);
+
 
 
 /* constant */
@@ -4,27 +4,55 @@
 #include "ns3/quantum-node.h" // class QuantumNode
 #include "ns3/quantum-phy-entity.h" // class QuantumPhyEntity
 
+#include "ns3/double.h" // class DoubleValue
+
+#include <limits> // std::numeric_limits
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("QuantumChannel");
 
 QuantumChannel::QuantumChannel (const std::pair<std::string, std::string> &conn)
-    : m_src_owner (conn.first), m_dst_owner (conn.second)
+    : m_src_owner (conn.first), m_dst_owner (conn.second),
+      m_length (0.),
+      m_attenuation (0.2),
+      m_speed (2e5),
+      m_coupling (1.),
+      m_source_fidel (1.),
+      m_depolar_length (0.)
 {
 }
 
 QuantumChannel::QuantumChannel (std::string src_owner_, std::string dst_owner_)
-    : m_src_owner (src_owner_), m_dst_owner (dst_owner_)
+    : m_src_owner (src_owner_), m_dst_owner (dst_owner_),
+      m_length (0.),
+      m_attenuation (0.2),
+      m_speed (2e5),
+      m_coupling (1.),
+      m_source_fidel (1.),
+      m_depolar_length (0.)
 {
 }
 
 QuantumChannel::QuantumChannel (const std::pair<Ptr<QuantumNode>, Ptr<QuantumNode>> &conn)
-    : m_src_owner (conn.first->GetOwner ()), m_dst_owner (conn.second->GetOwner ())
+    : m_src_owner (conn.first->GetOwner ()), m_dst_owner (conn.second->GetOwner ()),
+      m_length (0.),
+      m_attenuation (0.2),
+      m_speed (2e5),
+      m_coupling (1.),
+      m_source_fidel (1.),
+      m_depolar_length (0.)
 {
 }
 
 QuantumChannel::QuantumChannel (Ptr<QuantumNode> src, Ptr<QuantumNode> dst)
-    : m_src_owner (src->GetOwner ()), m_dst_owner (dst->GetOwner ())
+    : m_src_owner (src->GetOwner ()), m_dst_owner (dst->GetOwner ()),
+      m_length (0.),
+      m_attenuation (0.2),
+      m_speed (2e5),
+      m_coupling (1.),
+      m_source_fidel (1.),
+      m_depolar_length (0.)
 {
 }
 
@@ -32,7 +60,14 @@ QuantumChannel::~QuantumChannel ()
 {
 }
 
-QuantumChannel::QuantumChannel () : m_src_owner (""), m_dst_owner ("")
+QuantumChannel::QuantumChannel ()
+    : m_src_owner (""), m_dst_owner (""),
+      m_length (0.),
+      m_attenuation (0.2),
+      m_speed (2e5),
+      m_coupling (1.),
+      m_source_fidel (1.),
+      m_depolar_length (0.)
 {
 }
 
@@ -40,7 +75,28 @@ TypeId
 QuantumChannel::GetTypeId ()
 {
   static TypeId tid =
-      TypeId ("ns3::QuantumChannel").SetParent<Object> ().AddConstructor<QuantumChannel> ();
+      TypeId ("ns3::QuantumChannel")
+          .SetParent<Object> ()
+          .AddConstructor<QuantumChannel> ()
+          .AddAttribute ("Length", "Fiber length in km", DoubleValue (0.),
+                         MakeDoubleAccessor (&QuantumChannel::m_length),
+                         MakeDoubleChecker<double> (0.))
+          .AddAttribute ("Attenuation", "Fiber attenuation in dB/km", DoubleValue (0.2),
+                         MakeDoubleAccessor (&QuantumChannel::m_attenuation),
+                         MakeDoubleChecker<double> (0.))
+          .AddAttribute ("Speed", "Speed of light in the fiber in km/s, above 0", DoubleValue (2e5),
+                         MakeDoubleAccessor (&QuantumChannel::m_speed),
+                         MakeDoubleChecker<double> (std::numeric_limits<double>::min ()))
+          .AddAttribute ("CouplingEfficiency",
+                         "Efficiency of coupling the photon into and out of the memories, above 0",
+                         DoubleValue (1.), MakeDoubleAccessor (&QuantumChannel::m_coupling),
+                         MakeDoubleChecker<double> (std::numeric_limits<double>::min (), 1.))
+          .AddAttribute ("SourceFidelity", "Werner fidelity of the EPR pair at the source",
+                         DoubleValue (1.), MakeDoubleAccessor (&QuantumChannel::m_source_fidel),
+                         MakeDoubleChecker<double> (0., 1.))
+          .AddAttribute ("DepolarLength", "Depolarizing length of the fiber in km, or 0 if none",
+                         DoubleValue (0.), MakeDoubleAccessor (&QuantumChannel::m_depolar_length),
+                         MakeDoubleChecker<double> (0.));
   return tid;
 }
 
@@ -76,6 +132,41 @@ QuantumChannel::SetDepolarModel (double fidel, Ptr<QuantumPhyEntity> qphyent)
   qphyent->SetDepolarModel ({m_src_owner, m_dst_owner}, fidel);
 }
 
+QuantumLinkTable
+QuantumChannel::CalculateLinkTable () const
+{
+  double success_prob = m_coupling * std::pow (10., -m_attenuation * m_length / 10.);
+  Time flight = Seconds (m_length / m_speed);
+
+  double werner = (4. * m_source_fidel - 1.) / 3.;
+  if (m_depolar_length > 0.)
+    {
+      werner *= std::exp (-m_length / m_depolar_length);
+    }
+
+  // attempts are emitted one flight apart, and the successful one is heralded one flight later
+  double latency = flight.GetSeconds () / success_prob + flight.GetSeconds ();
+  double rate = latency > 0. ? 1. / latency : INFINITY;
+  return {success_prob, flight, flight, (3. * werner + 1.) / 4., rate};
+}
+
+QuantumLinkTable
+QuantumChannel::SetPhysicalModel (Ptr<QuantumPhyEntity> qphyent)
+{
+  QuantumLinkTable table = CalculateLinkTable ();
+  if (!(table.success_prob > 0.))
+    {
+      // the attenuation over the length underflows, so that no attempt could ever succeed
+      NS_FATAL_ERROR ("Link " << m_src_owner << " <--> " << m_dst_owner << " of " << m_length
+                              << " km never succeeds");
+    }
+  NS_LOG_LOGIC ("Link " << m_src_owner << " <--> " << m_dst_owner << " of " << m_length
+                        << " km succeeds with probability " << table.success_prob
+                        << " and delivers fidelity " << table.fidelity);
+  qphyent->SetLinkTable ({m_src_owner, m_dst_owner}, table);
+  return table;
+}
+
 bool
 QuantumChannel::operator<(const QuantumChannel &other) const
 {
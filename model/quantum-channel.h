@@ -2,12 +2,26 @@
 #define QUANTUM_CHANNEL_H
 
 #include "ns3/object.h"
+#include "ns3/nstime.h"
 
 namespace ns3 {
 
 class QuantumNode;
 class QuantumPhyEntity;
 
+/**
+ * \brief Quantities of a link precomputed from its physical model,
+ * so that distributing an EPR pair over it only takes a lookup.
+*/
+struct QuantumLinkTable
+{
+  double success_prob; /**< Probability of success of each attempt. */
+  Time attempt_duration; /**< Duration of each attempt, the photon flight over the fiber. */
+  Time herald_delay; /**< Latency of the herald back to the source after the successful attempt. */
+  double fidelity; /**< Werner fidelity of the delivered EPR pair. */
+  double rate; /**< Expected number of EPR pairs per second. */
+};
+
 class QuantumChannel : public Object
 {
 
@@ -16,6 +30,13 @@ private:
   /** Names of the source and the destination nodes. */
   std::string m_src_owner, m_dst_owner;
 
+  double m_length; /**< Fiber length in km. */
+  double m_attenuation; /**< Fiber attenuation in dB/km. */
+  double m_speed; /**< Speed of light in the fiber in km/s. */
+  double m_coupling; /**< Efficiency of coupling the photon into and out of the memories. */
+  double m_source_fidel; /**< Werner fidelity of the EPR pair at the source. */
+  double m_depolar_length; /**< Depolarizing length of the fiber in km, or 0 if none. */
+
 public:
 
   QuantumChannel (const std::pair<std::string, std::string> &conn);
@@ -42,6 +63,27 @@ public:
   */
   void SetDepolarModel (double fidel, Ptr<QuantumPhyEntity> qphyent);
 
+  /**
+   * \brief Calculate the link table of the channel from its physical parameters.
+   *
+   * An attempt succeeds with probability CouplingEfficiency * 10^(-Attenuation * Length / 10),
+   * attempts are emitted one photon flight Length / Speed apart,
+   * and the herald of the successful one takes another flight back to the source.
+   * The Werner parameter w = (4F - 1) / 3 of the source decays as exp (-Length / DepolarLength).
+   *
+   * \return The link table.
+  */
+  QuantumLinkTable CalculateLinkTable () const;
+
+  /**
+   * \brief Precompute the link table of the channel and record it,
+   * along with the depolarizing model of the delivered fidelity.
+   * It is a fatal error if the success probability underflows to 0.
+   * \param qphyent Quantum physical entity to record the table.
+   * \return The link table.
+  */
+  QuantumLinkTable SetPhysicalModel (Ptr<QuantumPhyEntity> qphyent);
+
   bool operator<(const QuantumChannel &other) const;
 
 };
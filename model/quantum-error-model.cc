@@ -49,6 +49,13 @@ QuantumErrorModel::ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent,
   assert (false);
 }
 
+bool
+QuantumErrorModel::GetDephasing (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                                 const Time &moment, double &prob) const
+{
+  return false;
+}
+
 
 
 
@@ -83,27 +90,45 @@ TimeModel::ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent, const std::vector<std
 {
   for (const std::string &qubit : qubits)
     {
-      Time duration = moment - qphyent->m_qubit2time[qubit];
-      if (duration.GetDouble () < 0)
+      QuantumOperation time = GetOperation (qphyent, qubit, moment);
+      if (!time.isIdentity ())
         {
-          NS_LOG_WARN ("duration < 0, skip");
-          continue;
+          qphyent->ApplyOperation (time, {qubit});
         }
-      if (abs(duration.GetDouble () - 0) < EPS)
-        {
-          continue;
-        }
-      double prob_time = (1 - exp (-duration.GetSeconds () / m_rate)) / 2;
-      QuantumOperation time = {{"I", "PZ"}, {pauli_I, pauli_Z}, 
-      {1 - prob_time, prob_time}};
+    }
+}
 
-      NS_LOG_LOGIC ("At time " << moment.As (Time::S) << " qubit named " << qubit
-                               << " applied time relevant error with prob " << prob_time
-                               << " (duration = " << duration.As (Time::S)
-                               << ", m_rate = " << m_rate << ")");
+QuantumOperation
+TimeModel::GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                         const Time &moment) const
+{
+  double prob_time = 0.;
+  GetDephasing (qphyent, qubit, moment, prob_time);
+  return PauliChannel (0., 0., prob_time);
+}
 
-      qphyent->ApplyOperation (time, qubits);
+bool
+TimeModel::GetDephasing (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                         const Time &moment, double &prob) const
+{
+  prob = 0.;
+  Time duration = moment - qphyent->m_qubit2time[qubit];
+  if (duration.GetDouble () < 0)
+    {
+      NS_LOG_WARN ("duration < 0, skip");
+      return true;
+    }
+  if (abs (duration.GetDouble () - 0) < EPS)
+    {
+      return true;
     }
+  prob = (1 - exp (-duration.GetSeconds () / m_rate)) / 2;
+
+  NS_LOG_LOGIC ("At time " << moment.As (Time::S) << " qubit named " << qubit
+                           << " applied time relevant error with prob " << prob
+                           << " (duration = " << duration.As (Time::S)
+                           << ", m_rate = " << m_rate << ")");
+  return true;
 }
 
 
@@ -143,18 +168,31 @@ DephaseModel::ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent,
 {
   for (const std::string &qubit : qubits)
     {
-      Time duration = Seconds (GATE_DURATION);
+      qphyent->ApplyOperation (GetOperation (qphyent, qubit, moment), {qubit});
+    }
+}
+
+QuantumOperation
+DephaseModel::GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                            const Time &moment) const
+{
+  double prob_dephase = 0.;
+  GetDephasing (qphyent, qubit, moment, prob_dephase);
+  return PauliChannel (0., 0., prob_dephase);
+}
 
-      double prob_dephase = (1 - exp (- duration.GetSeconds () / m_rate)) / 2;
-      QuantumOperation dephase = {
-          {"I", "PZ"}, {pauli_I, pauli_Z}, 
-          {1 - prob_dephase, prob_dephase}};
+bool
+DephaseModel::GetDephasing (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                            const Time &moment, double &prob) const
+{
+  Time duration = Seconds (GATE_DURATION);
 
-      NS_LOG_LOGIC ("At time " << moment.As (Time::S) << " qubit named " << qubit
-                               << " applied dephasing error with prob = " << prob_dephase
-                               << " (m_rate = " << m_rate << ")");
-      qphyent->ApplyOperation (dephase, qubits);
-    }
+  prob = (1 - exp (- duration.GetSeconds () / m_rate)) / 2;
+
+  NS_LOG_LOGIC ("At time " << moment.As (Time::S) << " qubit named " << qubit
+                           << " applied dephasing error with prob = " << prob
+                           << " (m_rate = " << m_rate << ")");
+  return true;
 }
 
 
@@ -195,15 +233,17 @@ DepolarModel::ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent,
 {
   assert (qubits.size () == 1); // the second qubit in a epr pair
 
-  QuantumOperation depolar = {
-      {"I", "PX", "PY", "PZ"},
-      {pauli_I, pauli_X, pauli_Y, pauli_Z},
-      {m_fidel, (1 - m_fidel) / 3., (1 - m_fidel) / 3., (1 - m_fidel) / 3.}};
+  qphyent->ApplyOperation (GetOperation (qphyent, qubits[0], moment), qubits);
+}
 
-  NS_LOG_LOGIC ("At time +0s qubit named " << qubits[0] << " applied depolar error with fidel "
+QuantumOperation
+DepolarModel::GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                            const Time &moment) const
+{
+  NS_LOG_LOGIC ("At time +0s qubit named " << qubit << " applied depolar error with fidel "
                                            << m_fidel);
 
-  qphyent->ApplyOperation (depolar, qubits);
+  return PauliChannel ((1 - m_fidel) / 3., (1 - m_fidel) / 3., (1 - m_fidel) / 3.);
 }
 
 double 
@@ -212,4 +252,126 @@ DepolarModel::GetFidelity () const
   return m_fidel;
 }
 
+
+
+
+/* amplitude damping model */
+
+AmplitudeDampModel::AmplitudeDampModel (double t1_, double rate_)
+    : QuantumErrorModel (true), m_t1 (t1_), m_rate (rate_)
+{
+  m_type_desc = "AmplitudeDampModel with t1 " + std::to_string (m_t1) + " and rate " +
+                std::to_string (m_rate);
+}
+
+AmplitudeDampModel::AmplitudeDampModel () : QuantumErrorModel (), m_t1 (0), m_rate (0)
+{
+}
+
+void
+AmplitudeDampModel::DoDispose (void)
+{
+  QuantumErrorModel::DoDispose ();
+}
+
+TypeId
+AmplitudeDampModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::AmplitudeDampModel")
+                          .SetParent<QuantumErrorModel> ()
+                          .AddConstructor<AmplitudeDampModel> ();
+  return tid;
+}
+
+void
+AmplitudeDampModel::ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent,
+                                     const std::vector<std::string> &qubits,
+                                     const Time &moment) const
+{
+  for (const std::string &qubit : qubits)
+    {
+      QuantumOperation damp = GetOperation (qphyent, qubit, moment);
+      if (!damp.isIdentity ())
+        {
+          qphyent->ApplyOperation (damp, {qubit});
+        }
+    }
+}
+
+QuantumOperation
+AmplitudeDampModel::GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                                  const Time &moment) const
+{
+  Time duration = moment - qphyent->m_qubit2time[qubit];
+  if (duration.GetDouble () <= 0)
+    {
+      return PauliChannel (0., 0., 0.);
+    }
+  double gamma = 1 - exp (-duration.GetSeconds () / m_t1);
+
+  NS_LOG_LOGIC ("At time " << moment.As (Time::S) << " qubit named " << qubit
+                           << " applied amplitude damping with gamma " << gamma
+                           << " (duration = " << duration.As (Time::S) << ", m_t1 = " << m_t1
+                           << ", m_rate = " << m_rate << ")");
+  if (m_rate <= 0)
+    {
+      return AmplitudeDamping (gamma);
+    }
+  double prob_time = (1 - exp (-duration.GetSeconds () / m_rate)) / 2;
+  return Compose (AmplitudeDamping (gamma), PauliChannel (0., 0., prob_time));
+}
+
+
+
+
+/* Kraus model */
+
+KrausModel::KrausModel (const QuantumOperation &opr_)
+    : QuantumErrorModel (false), // time independent
+      m_opr (ReduceKraus (opr_))
+{
+  m_type_desc = "KrausModel of rank " + std::to_string (m_opr.getSize ());
+}
+
+KrausModel::KrausModel () : QuantumErrorModel (), m_opr (PauliChannel (0., 0., 0.))
+{
+}
+
+void
+KrausModel::DoDispose (void)
+{
+  QuantumErrorModel::DoDispose ();
+}
+
+TypeId
+KrausModel::GetTypeId (void)
+{
+  static TypeId tid =
+      TypeId ("ns3::KrausModel").SetParent<QuantumErrorModel> ().AddConstructor<KrausModel> ();
+  return tid;
+}
+
+void
+KrausModel::ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent, const std::vector<std::string> &qubits,
+                             const Time &moment) const
+{
+  if (m_opr.getDim () > 2)
+    {
+      assert (m_opr.getDim () == (1u << qubits.size ()));
+      qphyent->ApplyOperation (m_opr, qubits);
+      return;
+    }
+  for (const std::string &qubit : qubits)
+    {
+      qphyent->ApplyOperation (m_opr, {qubit});
+    }
+}
+
+QuantumOperation
+KrausModel::GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                          const Time &moment) const
+{
+  return m_opr;
+}
+
 } // namespace ns3
\ No newline at end of file
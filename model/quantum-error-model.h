@@ -3,6 +3,7 @@
 
 #include "ns3/object.h"
 #include "ns3/quantum-basis.h"
+#include "ns3/quantum-operation.h" // class QuantumOperation
 
 namespace ns3 {
 
@@ -38,6 +39,28 @@ public:
   */
   virtual void ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent, const std::vector<std::string> &qubits,
                                 const Time &moment) const = 0;
+
+  /**
+   * \brief Get the channel of the error model on a qubit, for the caller to compose and apply.
+   * \param qphyent Quantum physical entity encapsulating the quantum circuit.
+   * \param qubit Name of the qubit.
+   * \param moment Time when the error model is applied.
+   * \return The channel, which is the identity if no error occurs.
+  */
+  virtual QuantumOperation GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                                         const Time &moment) const = 0;
+
+  /**
+   * \brief Get the channel of the error model on a qubit as a dephasing, if it is one,
+   * so that the caller fuses it into the diagonal of the qubit without building the channel.
+   * \param qphyent Quantum physical entity encapsulating the quantum circuit.
+   * \param qubit Name of the qubit.
+   * \param moment Time when the error model is applied.
+   * \param prob To store the probability of a Z error.
+   * \return True if the channel is a dephasing, or else GetOperation is to be used.
+  */
+  virtual bool GetDephasing (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                             const Time &moment, double &prob) const;
 };
 
 
@@ -66,6 +89,10 @@ public:
   */
   void ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent, const std::vector<std::string> &qubits,
                         const Time &moment) const override;
+  QuantumOperation GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                                 const Time &moment) const override;
+  bool GetDephasing (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit, const Time &moment,
+                     double &prob) const override;
 };
 
 /**
@@ -102,6 +129,8 @@ public:
   */
   void ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent, const std::vector<std::string> &qubits,
                         const Time &moment) const override;
+  QuantumOperation GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                                 const Time &moment) const override;
   double GetFidelity () const;
 };
 
@@ -137,6 +166,10 @@ public:
   */
   void ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent, const std::vector<std::string> &qubits,
                         const Time &moment) const override;
+  QuantumOperation GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                                 const Time &moment) const override;
+  bool GetDephasing (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit, const Time &moment,
+                     double &prob) const override;
 };
 
 /**
@@ -145,6 +178,76 @@ public:
 */
 const TimeModel default_time_model = TimeModel (1.);
 
+
+
+/**
+ * \brief Time relevant model of a memory relaxing with T1, and dephasing if given a rate.
+*/
+class AmplitudeDampModel : public QuantumErrorModel
+{
+
+private:
+
+  /** Relaxation time T1. */
+  const double m_t1;
+
+  /** Dephase rate, or 0 if none. */
+  const double m_rate;
+
+public:
+
+  AmplitudeDampModel (double t1_, double rate_ = 0.);
+
+  AmplitudeDampModel ();
+  void DoDispose (void) override;
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Apply the amplitude damping model to some qubits in some quantum circuit.
+   * \param qphyent Quantum physical entity encapsulating the quantum circuit.
+   * \param qubits Names of the qubits to be applied the amplitude damping model.
+   * \param moment Time when the model is applied.
+  */
+  void ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent, const std::vector<std::string> &qubits,
+                        const Time &moment) const override;
+  QuantumOperation GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                                 const Time &moment) const override;
+};
+
+
+
+/**
+ * \brief Time independent model of an arbitrary channel, such as one after a gate.
+*/
+class KrausModel : public QuantumErrorModel
+{
+
+private:
+
+  /** The channel, of minimal Kraus rank. */
+  const QuantumOperation m_opr;
+
+public:
+
+  KrausModel (const QuantumOperation &opr_);
+
+  KrausModel ();
+  void DoDispose (void) override;
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Apply the channel to some qubits in some quantum circuit,
+   * to each qubit if it is a single-qubit channel or else to all of them at once.
+   * \param qphyent Quantum physical entity encapsulating the quantum circuit.
+   * \param qubits Names of the qubits to be applied the channel.
+   * \param moment Time when the model is applied.
+  */
+  void ApplyErrorModel (Ptr<QuantumPhyEntity> qphyent, const std::vector<std::string> &qubits,
+                        const Time &moment) const override;
+  QuantumOperation GetOperation (Ptr<QuantumPhyEntity> qphyent, const std::string &qubit,
+                                 const Time &moment) const override;
+};
+
 } // namespace ns3
 
 #endif /* QUANTUM_ERROR_MODEL_H */
\ No newline at end of file
@@ -1,19 +1,25 @@
 #include "ns3/quantum-memory.h" // class QuantumMemory
 
+#include "ns3/quantum-basis.h"
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("QuantumMemory");
 
-QuantumMemory::QuantumMemory (std::vector<std::string> qubits_) : m_qubits (qubits_)
+QuantumMemory::QuantumMemory (std::vector<std::string> qubits_)
+    : m_qubits ({}), m_qubit2slot ({}), m_free ({}), m_capacity (0)
 {
+  SetQubits (qubits_);
 }
 
 QuantumMemory::~QuantumMemory ()
 {
   m_qubits.clear ();
+  m_qubit2slot.clear ();
+  m_free.clear ();
 }
 
-QuantumMemory::QuantumMemory () : m_qubits ({})
+QuantumMemory::QuantumMemory () : m_qubits ({}), m_qubit2slot ({}), m_free ({}), m_capacity (0)
 {
 }
 
@@ -21,28 +27,73 @@ TypeId
 QuantumMemory::GetTypeId ()
 {
   static TypeId tid =
-      TypeId ("ns3::QuantumMemory").SetParent<Object> ().AddConstructor<QuantumMemory> ();
+      TypeId ("ns3::QuantumMemory")
+          .SetParent<Object> ()
+          .AddConstructor<QuantumMemory> ()
+          .AddAttribute ("Capacity", "Maximum number of slots, or 0 if unbounded",
+                         UintegerValue (0),
+                         MakeUintegerAccessor (&QuantumMemory::SetCapacity,
+                                               &QuantumMemory::GetCapacity),
+                         MakeUintegerChecker<unsigned> ());
   return tid;
 }
 
 void
+QuantumMemory::SetQubits (std::vector<std::string> qubits)
+{
+  m_qubits = qubits;
+  m_qubit2slot.clear ();
+  m_free.clear ();
+  for (unsigned local = m_qubits.size (); local--;)
+    {
+      if (m_qubits[local].empty ())
+        {
+          m_free.push_back (local); // the lowest free slot at the back
+        }
+      else
+        {
+          m_qubit2slot[m_qubits[local]] = local;
+        }
+    }
+}
+
+unsigned
 QuantumMemory::AddQubit (std::string qubit)
 {
-  m_qubits.push_back (qubit);
+  auto it = m_qubit2slot.find (qubit);
+  if (it != m_qubit2slot.end ())
+    {
+      return it->second;
+    }
+  assert (!qubit.empty ());
+  assert (!IsFull ());
+
+  unsigned local = GetFreeSlot ();
+  if (local == m_qubits.size ())
+    {
+      m_qubits.push_back (qubit);
+    }
+  else
+    {
+      m_free.pop_back ();
+      m_qubits[local] = qubit;
+    }
+  m_qubit2slot[qubit] = local;
+  return local;
 }
 
 bool
 QuantumMemory::RemoveQubit (std::string qubit)
 {
-  for (unsigned i = 0; i < m_qubits.size (); ++i)
+  auto it = m_qubit2slot.find (qubit);
+  if (it == m_qubit2slot.end ())
     {
-      if (m_qubits[i] == qubit)
-        {
-          m_qubits.erase (m_qubits.begin () + i);
-          return true;
-        }
+      return false;
     }
-  return false;
+  m_qubits[it->second] = "";
+  m_free.push_back (it->second);
+  m_qubit2slot.erase (it);
+  return true;
 }
 
 unsigned
@@ -51,23 +102,53 @@ QuantumMemory::GetSize () const
   return m_qubits.size ();
 }
 
+unsigned
+QuantumMemory::GetNumQubits () const
+{
+  return m_qubit2slot.size ();
+}
+
 std::string
 QuantumMemory::GetQubit (unsigned local) const
 {
   return m_qubits[local];
 }
 
+unsigned
+QuantumMemory::GetSlot (std::string qubit) const
+{
+  return m_qubit2slot.at (qubit);
+}
+
+unsigned
+QuantumMemory::GetFreeSlot () const
+{
+  return m_free.empty () ? m_qubits.size () : m_free.back ();
+}
+
 bool
 QuantumMemory::ContainQubit (std::string qubit) const
 {
-  for (unsigned i = 0; i < m_qubits.size (); ++i)
-    {
-      if (m_qubits[i] == qubit)
-        {
-          return true;
-        }
-    }
-  return false;
+  return m_qubit2slot.find (qubit) != m_qubit2slot.end ();
+}
+
+bool
+QuantumMemory::IsFull () const
+{
+  return m_capacity && m_qubit2slot.size () >= m_capacity;
+}
+
+void
+QuantumMemory::SetCapacity (unsigned capacity)
+{
+  assert (capacity == 0 || capacity >= m_qubits.size () - m_free.size ());
+  m_capacity = capacity;
+}
+
+unsigned
+QuantumMemory::GetCapacity () const
+{
+  return m_capacity;
 }
 
-} // namespace ns3
\ No newline at end of file
+} // namespace ns3
@@ -3,35 +3,65 @@
 
 #include "ns3/object.h"
 
+#include <unordered_map>
+
 namespace ns3 {
 
 class QuantumPhyEntity;
 class QuantumErrorModel;
 
+/**
+ * \brief Quantum memory of slots, each holding a qubit or free.
+ *
+ * Adding a qubit takes the most recently freed slot, or a new one until the capacity is reached,
+ * and removing a qubit frees its slot for the next one. Both, as well as the ownership check,
+ * take constant time.
+*/
 class QuantumMemory : public Object
 {
 
 private:
 
-  /** Names of the qubits in this quantum memory. */
+  /** Name of the qubit in each slot, or empty if the slot is free. */
   std::vector<std::string> m_qubits;
 
+  /** Map from qubit name to its slot. */
+  std::unordered_map<std::string, unsigned> m_qubit2slot;
+
+  /** Free slots, the next one to be taken at the back. */
+  std::vector<unsigned> m_free;
+
+  /** Maximum number of slots, or 0 if unbounded. */
+  unsigned m_capacity;
+
 public:
 
+  /**
+   * \param qubits_ Names of the qubits in the slots, where an empty name leaves the slot free.
+  */
   QuantumMemory (std::vector<std::string> qubits_);
   ~QuantumMemory ();
 
   QuantumMemory ();
   static TypeId GetTypeId ();
 
+  /**
+   * \brief Replace the slots of the quantum memory, keeping its capacity.
+   * \param qubits Names of the qubits in the slots, where an empty name leaves the slot free.
+  */
+  void SetQubits (std::vector<std::string> qubits);
+
   /**
    * \brief Add a qubit to the quantum memory.
    * \param qubit Name of the qubit to be added.
+   * \return Slot of the qubit.
+   *
+   * \note The quantum memory must not be full, unless it already holds the qubit.
   */
-  void AddQubit (std::string qubit);
+  unsigned AddQubit (std::string qubit);
 
   /**
-   * \brief Remove a qubit from the quantum memory.
+   * \brief Remove a qubit from the quantum memory, freeing its slot.
    * \param qubit Name of the qubit to be removed.
    * \return True if the qubit is successfully removed.
   */
@@ -39,17 +69,35 @@ public:
 
   /**
    * \brief Get the size of the quantum memory.
-   * \return Number of qubits in the quantum memory.
+   * \return Number of slots in the quantum memory, free or not.
   */
   unsigned GetSize () const;
 
+  /**
+   * \brief Get the number of qubits in the quantum memory.
+   * \return Number of slots holding a qubit.
+  */
+  unsigned GetNumQubits () const;
+
   /**
    * \brief Get the qubit at a specific position.
    * \param local The position in the quantum memory to query.
-   * \return Name of the qubit at the position.
+   * \return Name of the qubit at the position, or empty if the slot is free.
   */
   std::string GetQubit (unsigned local) const;
 
+  /**
+   * \brief Get the slot of a qubit.
+   * \param qubit Name of the qubit, which must be in the quantum memory.
+   * \return Slot of the qubit.
+  */
+  unsigned GetSlot (std::string qubit) const;
+
+  /**
+   * \brief Get the slot that the next added qubit will take.
+   * \return The next slot, which equals GetSize () if a new slot is to be taken.
+  */
+  unsigned GetFreeSlot () const;
 
   /**
    * \brief Check if a qubit is in the quantum memory.
@@ -57,8 +105,23 @@ public:
    * \return True if the qubit is in the quantum memory.
   */
   bool ContainQubit (std::string qubit) const;
+
+  /**
+   * \brief Check if no qubit can be added.
+   * \return True if the qubits in the memory reach its capacity,
+   * even if a free slot is left after the capacity was lowered.
+  */
+  bool IsFull () const;
+
+  /**
+   * \brief Bound the number of slots.
+   * \param capacity Maximum number of slots, or 0 if unbounded, no less than the slots in use.
+  */
+  void SetCapacity (unsigned capacity);
+
+  unsigned GetCapacity () const;
 };
 
 } // namespace ns3
 
-#endif /* QUANTUM_MEMORY_H */
\ No newline at end of file
+#endif /* QUANTUM_MEMORY_H */
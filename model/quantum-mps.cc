@@ -0,0 +1,745 @@
+#include "ns3/quantum-mps.h" // class QuantumMPS
+
+#include "ns3/quantum-basis.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("QuantumMPS");
+
+NS_OBJECT_ENSURE_REGISTERED (QuantumMPS);
+
+/**
+ * \brief Build the superoperator of a quantum operation on k sites.
+ *
+ * The physical index of site m is p_m = (i_m << 1) | j_m, and the first site is the most
+ * significant in the index of the k sites, while qubit m is bit m of the Kraus operators.
+*/
+static std::vector<std::complex<double>>
+BuildSuperop (const std::vector<std::vector<std::complex<double>>> &kraus, const unsigned &k)
+{
+  unsigned d = 1 << k;
+  unsigned dim = 1 << (k << 1);
+  auto split = [&k] (unsigned idx, unsigned &i, unsigned &j) {
+    i = j = 0;
+    for (unsigned m = 0; m < k; ++m)
+      {
+        unsigned p = (idx >> ((k - 1 - m) << 1)) & 3;
+        i |= (p >> 1) << m;
+        j |= (p & 1) << m;
+      }
+  };
+
+  std::vector<std::complex<double>> superop (dim * dim, 0.0);
+  for (unsigned out = 0; out < dim; ++out)
+    {
+      unsigned i_out, j_out;
+      split (out, i_out, j_out);
+      for (unsigned in = 0; in < dim; ++in)
+        {
+          unsigned i_in, j_in;
+          split (in, i_in, j_in);
+          for (const std::vector<std::complex<double>> &op : kraus)
+            {
+              assert (op.size () == d * d);
+              superop[out * dim + in] += op[i_out * d + i_in] * std::conj (op[j_out * d + j_in]);
+            }
+        }
+    }
+  return superop;
+}
+
+QuantumMPS::QuantumMPS (const unsigned &max_bond_, const double &tolerance_)
+    : m_sites ({}),
+      m_order ({}),
+      m_position ({}),
+      m_left_env ({}),
+      m_right_env ({}),
+      m_left_vld (0),
+      m_right_vld (0),
+      m_max_bond (max_bond_),
+      m_tolerance (tolerance_),
+      m_trunc_err (0)
+{
+}
+
+QuantumMPS::~QuantumMPS ()
+{
+}
+
+QuantumMPS::QuantumMPS ()
+    : m_sites ({}),
+      m_order ({}),
+      m_position ({}),
+      m_left_env ({}),
+      m_right_env ({}),
+      m_left_vld (0),
+      m_right_vld (0),
+      m_max_bond (64),
+      m_tolerance (1e-12),
+      m_trunc_err (0)
+{
+}
+
+TypeId
+QuantumMPS::GetTypeId ()
+{
+  static TypeId tid =
+      TypeId ("ns3::QuantumMPS")
+          .SetParent<Object> ()
+          .AddConstructor<QuantumMPS> ()
+          .AddAttribute ("MaxBond", "Maximum bond dimension of the chain", UintegerValue (64),
+                         MakeUintegerAccessor (&QuantumMPS::m_max_bond),
+                         MakeUintegerChecker<unsigned> (1))
+          .AddAttribute ("Tolerance", "Singular values below it times the largest one are dropped",
+                         DoubleValue (1e-12), MakeDoubleAccessor (&QuantumMPS::m_tolerance),
+                         MakeDoubleChecker<double> (0));
+  return tid;
+}
+
+void
+QuantumMPS::GenerateQubits (const std::vector<std::complex<double>> &rho,
+                            const std::vector<std::string> &qubits)
+{
+  unsigned n = qubits.size ();
+  unsigned d = 1 << n;
+  assert (rho.size () == d * d);
+
+  std::vector<std::complex<double>> merged (d * d, 0.0);
+  for (unsigned idx = 0; idx < d * d; ++idx)
+    {
+      unsigned i = 0, j = 0;
+      for (unsigned m = 0; m < n; ++m)
+        {
+          unsigned p = (idx >> ((n - 1 - m) << 1)) & 3;
+          i |= (p >> 1) << m;
+          j |= (p & 1) << m;
+        }
+      merged[idx] = rho[i * d + j];
+    }
+
+  for (const Site &site : Split (merged, 1, n, 1))
+    {
+      m_sites.push_back (site);
+    }
+  for (const std::string &qubit : qubits)
+    {
+      m_position[qubit] = m_order.size ();
+      m_order.push_back (qubit);
+    }
+
+  // the new sites are right of all the others
+  m_left_env.resize (m_sites.size ());
+  m_right_env.resize (m_sites.size ());
+  m_right_vld = m_sites.size ();
+}
+
+void
+QuantumMPS::ApplyKraus (const std::vector<std::vector<std::complex<double>>> &kraus,
+                        const std::vector<std::string> &qubits)
+{
+  unsigned pos = qubits.size () == 1 ? GetPosition (qubits[0]) : Gather (qubits);
+  ApplyAdjacent (pos, qubits.size (), BuildSuperop (kraus, qubits.size ()));
+}
+
+void
+QuantumMPS::ApplyDiagonal (const std::string &qubit, const std::vector<std::complex<double>> &diag)
+{
+  assert (diag.size () == 4);
+  unsigned pos = GetPosition (qubit);
+  Invalidate (pos, 1);
+  Site &site = m_sites[pos];
+  for (unsigned l = 0; l < site.left; ++l)
+    {
+      for (unsigned p = 0; p < 4; ++p)
+        {
+          for (unsigned r = 0; r < site.right; ++r)
+            {
+              site.data[(l * 4 + p) * site.right + r] *= diag[p];
+            }
+        }
+    }
+}
+
+void
+QuantumMPS::PartialTrace (const std::vector<std::string> &qubits)
+{
+  for (const std::string &qubit : qubits)
+    {
+      unsigned pos = GetPosition (qubit);
+      const Site site = m_sites[pos];
+
+      // close the wires, leaving a bond matrix M[l][r]
+      std::vector<std::complex<double>> bond (site.left * site.right, 0.0);
+      for (unsigned l = 0; l < site.left; ++l)
+        {
+          for (unsigned r = 0; r < site.right; ++r)
+            {
+              bond[l * site.right + r] = site.data[(l * 4 + 0) * site.right + r] +
+                                         site.data[(l * 4 + 3) * site.right + r];
+            }
+        }
+
+      if (pos > 0)
+        {
+          Site &prev = m_sites[pos - 1];
+          std::vector<std::complex<double>> data (prev.left * 4 * site.right, 0.0);
+          for (unsigned row = 0; row < prev.left * 4; ++row)
+            {
+              for (unsigned m = 0; m < site.left; ++m)
+                {
+                  for (unsigned r = 0; r < site.right; ++r)
+                    {
+                      data[row * site.right + r] +=
+                          prev.data[row * site.left + m] * bond[m * site.right + r];
+                    }
+                }
+            }
+          prev.data = data;
+          prev.right = site.right;
+        }
+      else if (pos + 1 < m_sites.size ())
+        {
+          Site &next = m_sites[pos + 1];
+          std::vector<std::complex<double>> data (site.left * 4 * next.right, 0.0);
+          for (unsigned l = 0; l < site.left; ++l)
+            {
+              for (unsigned m = 0; m < site.right; ++m)
+                {
+                  for (unsigned col = 0; col < 4 * next.right; ++col)
+                    {
+                      data[l * 4 * next.right + col] +=
+                          bond[l * site.right + m] * next.data[m * 4 * next.right + col];
+                    }
+                }
+            }
+          next.data = data;
+          next.left = site.left;
+        }
+      // the last site leaves a scalar, which the normalization drops
+
+      m_sites.erase (m_sites.begin () + pos);
+      m_order.erase (m_order.begin () + pos);
+      m_position.erase (qubit);
+      for (unsigned later = pos; later < m_order.size (); ++later)
+        {
+          m_position[m_order[later]] = later;
+        }
+
+      // the environments past the absorbing neighbour shift along with the sites
+      m_left_env.erase (m_left_env.begin () + pos);
+      m_right_env.erase (m_right_env.begin () + pos);
+      m_left_vld = std::min (m_left_vld, pos);
+      m_right_vld = std::max (m_right_vld, pos + 1) - 1;
+    }
+}
+
+std::vector<std::complex<double>>
+QuantumMPS::ReducedDM (const std::vector<std::string> &qubits) const
+{
+  if (qubits.empty ())
+    {
+      return {1.0};
+    }
+  unsigned first = m_sites.size (), last = 0;
+  for (const std::string &qubit : qubits)
+    {
+      unsigned pos = GetPosition (qubit);
+      first = std::min (first, pos);
+      last = std::max (last, pos);
+    }
+
+  // sweep from the first to the last qubit with an environment E[kept][bond],
+  // where the physical indices of the kept sites are appended in the order of the chain,
+  // starting from the trace of the sites on the left
+  std::vector<std::complex<double>> env = GetLeftEnv (first);
+  unsigned kept = 1, bond = env.size ();
+  std::vector<unsigned> kept_order = {};
+  for (unsigned pos = first; pos <= last; ++pos)
+    {
+      const Site &site = m_sites[pos];
+      assert (site.left == bond);
+      auto it = std::find (qubits.begin (), qubits.end (), m_order[pos]);
+      bool keep = it != qubits.end ();
+      unsigned phys = keep ? 4 : 1;
+
+      std::vector<std::complex<double>> next (kept * phys * site.right, 0.0);
+      for (unsigned kk = 0; kk < kept; ++kk)
+        {
+          for (unsigned l = 0; l < bond; ++l)
+            {
+              std::complex<double> e = env[kk * bond + l];
+              if (e == 0.0)
+                {
+                  continue;
+                }
+              for (unsigned r = 0; r < site.right; ++r)
+                {
+                  if (keep)
+                    {
+                      for (unsigned p = 0; p < 4; ++p)
+                        {
+                          next[(kk * 4 + p) * site.right + r] +=
+                              e * site.data[(l * 4 + p) * site.right + r];
+                        }
+                    }
+                  else
+                    {
+                      next[kk * site.right + r] += e * (site.data[(l * 4 + 0) * site.right + r] +
+                                                        site.data[(l * 4 + 3) * site.right + r]);
+                    }
+                }
+            }
+        }
+      env = next;
+      kept *= phys;
+      bond = site.right;
+      if (keep)
+        {
+          kept_order.push_back (it - qubits.begin ());
+        }
+    }
+  assert (kept_order.size () == qubits.size ());
+
+  // close the bond with the trace of the sites on the right
+  const std::vector<std::complex<double>> &right_env = GetRightEnv (last);
+  assert (right_env.size () == bond);
+  std::vector<std::complex<double>> closed (kept, 0.0);
+  for (unsigned kk = 0; kk < kept; ++kk)
+    {
+      for (unsigned r = 0; r < bond; ++r)
+        {
+          closed[kk] += env[kk * bond + r] * right_env[r];
+        }
+    }
+
+  unsigned dim = 1 << qubits.size ();
+  std::vector<std::complex<double>> dm (dim * dim, 0.0);
+  for (unsigned kk = 0; kk < kept; ++kk)
+    {
+      unsigned i = 0, j = 0;
+      for (unsigned t = 0; t < kept_order.size (); ++t)
+        {
+          unsigned p = (kk >> ((kept_order.size () - 1 - t) << 1)) & 3;
+          i |= (p >> 1) << kept_order[t];
+          j |= (p & 1) << kept_order[t];
+        }
+      dm[i + dim * j] = closed[kk];
+    }
+
+  // normalize away the trace lost to the truncations
+  std::complex<double> trace = 0.0;
+  for (unsigned i = 0; i < dim; ++i)
+    {
+      trace += dm[i + dim * i];
+    }
+  if (abs (trace) > EPS)
+    {
+      for (std::complex<double> &entry : dm)
+        {
+          entry /= trace;
+        }
+    }
+  return dm;
+}
+
+double
+QuantumMPS::GetTruncationError () const
+{
+  return m_trunc_err;
+}
+
+unsigned
+QuantumMPS::GetMaxBondDim () const
+{
+  unsigned max_bond = 1;
+  for (const Site &site : m_sites)
+    {
+      max_bond = std::max (max_bond, site.right);
+    }
+  return max_bond;
+}
+
+void
+QuantumMPS::Save (std::ostream &out) const
+{
+  WriteBinary<uint32_t> (out, m_max_bond);
+  WriteBinary (out, m_tolerance);
+  WriteBinary (out, m_trunc_err);
+  WriteBinary<uint64_t> (out, m_sites.size ());
+  for (unsigned pos = 0; pos < m_sites.size (); ++pos)
+    {
+      WriteBinary (out, m_order[pos]);
+      WriteBinary<uint32_t> (out, m_sites[pos].left);
+      WriteBinary<uint32_t> (out, m_sites[pos].right);
+      WriteBinary (out, m_sites[pos].data);
+    }
+}
+
+bool
+QuantumMPS::Load (std::istream &in)
+{
+  m_max_bond = ReadBinary<uint32_t> (in);
+  m_tolerance = ReadBinary<double> (in);
+  m_trunc_err = ReadBinary<double> (in);
+  m_sites.resize (ReadBinarySize (in));
+  m_order.resize (m_sites.size ());
+  m_position.clear ();
+  m_left_env.assign (m_sites.size (), {});
+  m_right_env.assign (m_sites.size (), {});
+  m_left_vld = 0;
+  m_right_vld = m_sites.size ();
+  for (unsigned pos = 0; pos < m_sites.size (); ++pos)
+    {
+      m_order[pos] = ReadBinaryString (in);
+      m_position[m_order[pos]] = pos;
+      m_sites[pos].left = ReadBinary<uint32_t> (in);
+      m_sites[pos].right = ReadBinary<uint32_t> (in);
+      m_sites[pos].data = ReadBinaryComplex (in);
+      if (!in || m_sites[pos].data.size () != m_sites[pos].left * 4 * m_sites[pos].right)
+        {
+          return false;
+        }
+    }
+  return bool (in);
+}
+
+unsigned
+QuantumMPS::GetPosition (const std::string &qubit) const
+{
+  auto it = m_position.find (qubit);
+  assert (it != m_position.end ());
+  return it->second;
+}
+
+void
+QuantumMPS::SwapOrder (const unsigned &left)
+{
+  std::swap (m_order[left], m_order[left + 1]);
+  m_position[m_order[left]] = left;
+  m_position[m_order[left + 1]] = left + 1;
+}
+
+void
+QuantumMPS::Invalidate (const unsigned &pos, const unsigned &k)
+{
+  assert (k > 0 && pos + k <= m_sites.size ());
+  m_left_vld = std::min (m_left_vld, pos + 1);
+  m_right_vld = std::max (m_right_vld, pos + k - 1);
+}
+
+const std::vector<std::complex<double>> &
+QuantumMPS::GetLeftEnv (const unsigned &pos) const
+{
+  assert (pos < m_sites.size ());
+  if (m_left_vld == 0)
+    {
+      m_left_env[0] = {1.0};
+      m_left_vld = 1;
+    }
+  for (; m_left_vld <= pos; ++m_left_vld)
+    {
+      const Site &site = m_sites[m_left_vld - 1];
+      const std::vector<std::complex<double>> &prev = m_left_env[m_left_vld - 1];
+      std::vector<std::complex<double>> env (site.right, 0.0);
+      for (unsigned l = 0; l < site.left; ++l)
+        {
+          for (unsigned r = 0; r < site.right; ++r)
+            {
+              env[r] += prev[l] * (site.data[(l * 4 + 0) * site.right + r] +
+                                   site.data[(l * 4 + 3) * site.right + r]);
+            }
+        }
+      m_left_env[m_left_vld] = env;
+    }
+  return m_left_env[pos];
+}
+
+const std::vector<std::complex<double>> &
+QuantumMPS::GetRightEnv (const unsigned &pos) const
+{
+  assert (pos < m_sites.size ());
+  if (m_right_vld == m_sites.size ())
+    {
+      m_right_env.back () = {1.0};
+      --m_right_vld;
+    }
+  for (; m_right_vld > pos; --m_right_vld)
+    {
+      const Site &site = m_sites[m_right_vld];
+      const std::vector<std::complex<double>> &next = m_right_env[m_right_vld];
+      std::vector<std::complex<double>> env (site.left, 0.0);
+      for (unsigned l = 0; l < site.left; ++l)
+        {
+          for (unsigned r = 0; r < site.right; ++r)
+            {
+              env[l] += (site.data[(l * 4 + 0) * site.right + r] +
+                         site.data[(l * 4 + 3) * site.right + r]) *
+                        next[r];
+            }
+        }
+      m_right_env[m_right_vld - 1] = env;
+    }
+  return m_right_env[pos];
+}
+
+unsigned
+QuantumMPS::Gather (const std::vector<std::string> &qubits)
+{
+  // the swap of two adjacent sites, as a superoperator on their physical indices
+  std::vector<std::complex<double>> swap (256, 0.0);
+  for (unsigned p0 = 0; p0 < 4; ++p0)
+    {
+      for (unsigned p1 = 0; p1 < 4; ++p1)
+        {
+          swap[(p1 * 4 + p0) * 16 + (p0 * 4 + p1)] = 1.0;
+        }
+    }
+
+  // move each qubit right after the previous one, passing through the others
+  for (unsigned m = 1; m < qubits.size (); ++m)
+    {
+      while (GetPosition (qubits[m]) != GetPosition (qubits[m - 1]) + 1)
+        {
+          unsigned pos = GetPosition (qubits[m]);
+          unsigned left = pos < GetPosition (qubits[m - 1]) ? pos : pos - 1;
+          ApplyAdjacent (left, 2, swap);
+          SwapOrder (left);
+        }
+    }
+  return GetPosition (qubits[0]);
+}
+
+void
+QuantumMPS::ApplyAdjacent (const unsigned &pos, const unsigned &k,
+                           const std::vector<std::complex<double>> &superop)
+{
+  assert (pos + k <= m_sites.size ());
+  unsigned dim = 1 << (k << 1);
+  assert (superop.size () == dim * dim);
+  Invalidate (pos, k);
+
+  // merge the sites into T[l][p_0]..[p_{k-1}][r]
+  unsigned left = m_sites[pos].left;
+  unsigned right = m_sites[pos].right;
+  std::vector<std::complex<double>> merged = m_sites[pos].data;
+  unsigned rows = left * 4;
+  for (unsigned s = 1; s < k; ++s)
+    {
+      const Site &site = m_sites[pos + s];
+      assert (site.left == right);
+      std::vector<std::complex<double>> next (rows * 4 * site.right, 0.0);
+      for (unsigned row = 0; row < rows; ++row)
+        {
+          for (unsigned m = 0; m < right; ++m)
+            {
+              std::complex<double> e = merged[row * right + m];
+              if (e == 0.0)
+                {
+                  continue;
+                }
+              for (unsigned col = 0; col < 4 * site.right; ++col)
+                {
+                  next[row * 4 * site.right + col] += e * site.data[m * 4 * site.right + col];
+                }
+            }
+        }
+      merged = next;
+      rows *= 4;
+      right = site.right;
+    }
+
+  // apply the superoperator on the physical indices
+  std::vector<std::complex<double>> applied (merged.size (), 0.0);
+  for (unsigned l = 0; l < left; ++l)
+    {
+      for (unsigned out = 0; out < dim; ++out)
+        {
+          for (unsigned in = 0; in < dim; ++in)
+            {
+              std::complex<double> s = superop[out * dim + in];
+              if (s == 0.0)
+                {
+                  continue;
+                }
+              for (unsigned r = 0; r < right; ++r)
+                {
+                  applied[(l * dim + out) * right + r] += s * merged[(l * dim + in) * right + r];
+                }
+            }
+        }
+    }
+
+  std::vector<Site> sites = Split (applied, left, k, right);
+  std::copy (sites.begin (), sites.end (), m_sites.begin () + pos);
+}
+
+std::vector<QuantumMPS::Site>
+QuantumMPS::Split (std::vector<std::complex<double>> merged, unsigned left, const unsigned &k,
+                   const unsigned &right)
+{
+  std::vector<Site> sites = {};
+  for (unsigned s = 0; s + 1 < k; ++s)
+    {
+      unsigned rows = left * 4;
+      unsigned cols = merged.size () / rows;
+      std::vector<std::complex<double>> u, vh;
+      std::vector<double> sv;
+      TruncatedSvd (merged, rows, cols, u, sv, vh);
+
+      sites.push_back ({left, (unsigned) sv.size (), u});
+      merged.assign (sv.size () * cols, 0.0);
+      for (unsigned a = 0; a < sv.size (); ++a)
+        {
+          for (unsigned c = 0; c < cols; ++c)
+            {
+              merged[a * cols + c] = sv[a] * vh[a * cols + c];
+            }
+        }
+      left = sv.size ();
+    }
+  sites.push_back ({left, right, merged});
+  return sites;
+}
+
+void
+QuantumMPS::TruncatedSvd (const std::vector<std::complex<double>> &m, const unsigned &rows,
+                          const unsigned &cols, std::vector<std::complex<double>> &u,
+                          std::vector<double> &s, std::vector<std::complex<double>> &vh)
+{
+  // one-sided Jacobi on the columns of A, where A is M or its adjoint with rows >= cols
+  bool adjoint = rows < cols;
+  unsigned r_a = adjoint ? cols : rows;
+  unsigned c_a = adjoint ? rows : cols;
+  std::vector<std::complex<double>> a (r_a * c_a);
+  for (unsigned x = 0; x < rows; ++x)
+    {
+      for (unsigned y = 0; y < cols; ++y)
+        {
+          if (adjoint)
+            a[y * c_a + x] = std::conj (m[x * cols + y]);
+          else
+            a[x * c_a + y] = m[x * cols + y];
+        }
+    }
+  std::vector<std::complex<double>> v (c_a * c_a, 0.0);
+  for (unsigned c = 0; c < c_a; ++c)
+    {
+      v[c * c_a + c] = 1.0;
+    }
+
+  for (unsigned sweep = 0; sweep < 64; ++sweep)
+    {
+      bool rotated = false;
+      for (unsigned p = 0; p + 1 < c_a; ++p)
+        {
+          for (unsigned q = p + 1; q < c_a; ++q)
+            {
+              double alpha = 0, beta = 0;
+              std::complex<double> gamma = 0.0;
+              for (unsigned x = 0; x < r_a; ++x)
+                {
+                  alpha += std::norm (a[x * c_a + p]);
+                  beta += std::norm (a[x * c_a + q]);
+                  gamma += std::conj (a[x * c_a + p]) * a[x * c_a + q];
+                }
+              if (abs (gamma) <= 1e-15 * std::sqrt (alpha * beta) || abs (gamma) < 1e-300)
+                {
+                  continue;
+                }
+              rotated = true;
+
+              // a real rotation of a_p and the phase-aligned a_q
+              double zeta = (beta - alpha) / (2 * abs (gamma));
+              double t = (zeta >= 0 ? 1.0 : -1.0) / (std::abs (zeta) + std::sqrt (1 + zeta * zeta));
+              double c = 1 / std::sqrt (1 + t * t);
+              double sn = c * t;
+              std::complex<double> e = gamma / abs (gamma);
+              for (unsigned x = 0; x < r_a; ++x)
+                {
+                  std::complex<double> ap = a[x * c_a + p], aq = a[x * c_a + q];
+                  a[x * c_a + p] = c * ap - sn * std::conj (e) * aq;
+                  a[x * c_a + q] = sn * e * ap + c * aq;
+                }
+              for (unsigned x = 0; x < c_a; ++x)
+                {
+                  std::complex<double> vp = v[x * c_a + p], vq = v[x * c_a + q];
+                  v[x * c_a + p] = c * vp - sn * std::conj (e) * vq;
+                  v[x * c_a + q] = sn * e * vp + c * vq;
+                }
+            }
+        }
+      if (!rotated)
+        {
+          break;
+        }
+    }
+
+  // singular values in descending order
+  std::vector<double> sigma (c_a, 0.0);
+  for (unsigned c = 0; c < c_a; ++c)
+    {
+      for (unsigned x = 0; x < r_a; ++x)
+        {
+          sigma[c] += std::norm (a[x * c_a + c]);
+        }
+      sigma[c] = std::sqrt (sigma[c]);
+    }
+  std::vector<unsigned> idx (c_a);
+  std::iota (idx.begin (), idx.end (), 0);
+  std::sort (idx.begin (), idx.end (), [&sigma] (unsigned x, unsigned y) {
+    return sigma[x] > sigma[y];
+  });
+
+  // truncate
+  double total = 0;
+  for (const double &sig : sigma)
+    {
+      total += sig * sig;
+    }
+  unsigned kept = 1;
+  while (kept < c_a && kept < m_max_bond && sigma[idx[kept]] > m_tolerance * sigma[idx[0]])
+    {
+      ++kept;
+    }
+  double discarded = 0;
+  for (unsigned i = kept; i < c_a; ++i)
+    {
+      discarded += sigma[idx[i]] * sigma[idx[i]];
+    }
+  if (total > 0 && discarded > 0)
+    {
+      m_trunc_err += discarded / total;
+      NS_LOG_LOGIC ("Truncated to bond dimension " << kept << " discarding weight "
+                                                   << discarded / total);
+    }
+
+  // M = U S V^dagger, or M = V' S U'^dagger if A is the adjoint
+  s.assign (kept, 0.0);
+  u.assign (rows * kept, 0.0);
+  vh.assign (kept * cols, 0.0);
+  for (unsigned k = 0; k < kept; ++k)
+    {
+      unsigned c = idx[k];
+      s[k] = sigma[c];
+      double inv = sigma[c] > 1e-300 ? 1 / sigma[c] : 0;
+      if (adjoint)
+        {
+          for (unsigned x = 0; x < rows; ++x)
+            u[x * kept + k] = v[x * c_a + c];
+          for (unsigned y = 0; y < cols; ++y)
+            vh[k * cols + y] = std::conj (a[y * c_a + c]) * inv;
+        }
+      else
+        {
+          for (unsigned x = 0; x < rows; ++x)
+            u[x * kept + k] = a[x * c_a + c] * inv;
+          for (unsigned y = 0; y < cols; ++y)
+            vh[k * cols + y] = std::conj (v[y * c_a + c]);
+        }
+    }
+}
+
+} // namespace ns3
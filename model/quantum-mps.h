@@ -0,0 +1,188 @@
+#ifndef QUANTUM_MPS_H
+#define QUANTUM_MPS_H
+
+#include "ns3/object.h"
+
+#include <complex>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+namespace ns3 {
+
+/**
+ * \brief Density matrix kept as a matrix product state of its vectorization, on the host.
+ *
+ * Each qubit is a site tensor A[l][p][r] with a physical index p = (i << 1) | j
+ * for the entry rho_{..i.., ..j..}, so that a chain of sites is a 1-D MPO of the density matrix.
+ * An operation on k qubits swaps them next to each other, merges their sites,
+ * applies its superoperator in place and splits them back by truncated SVDs.
+ *
+ * The truncation keeps at most MaxBond singular values above Tolerance times the largest one,
+ * and the discarded weight of each truncation is summed up as the truncation error.
+ * The chain is not kept in a canonical form, so the error is an estimate
+ * rather than a bound on the trace distance.
+ *
+ * The trace environments on both sides of every site are cached and invalidated
+ * only past the sites an operation changed, so that a reduced density matrix
+ * contracts the sites between its qubits rather than the whole chain.
+*/
+class QuantumMPS : public Object
+{
+public:
+  QuantumMPS (const unsigned &max_bond_, const double &tolerance_);
+  ~QuantumMPS ();
+
+  QuantumMPS ();
+  static TypeId GetTypeId ();
+
+  /**
+   * \brief Append n qubits in a product with the others.
+   * \param rho Density matrix of the qubits, row-major, where qubit i is bit i.
+   * \param qubits Names of the qubits.
+  */
+  void GenerateQubits (const std::vector<std::complex<double>> &rho,
+                       const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Apply a quantum operation to n qubits.
+   * \param kraus Kraus operators, row-major, where qubit i is bit i.
+   * \param qubits Names of the qubits.
+  */
+  void ApplyKraus (const std::vector<std::vector<std::complex<double>>> &kraus,
+                   const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Apply a diagonal superoperator to a qubit.
+   * \param qubit Name of the qubit.
+   * \param diag Diagonal superoperator d, scaling rho_{..i.., ..j..} by d[(i << 1) | j].
+  */
+  void ApplyDiagonal (const std::string &qubit, const std::vector<std::complex<double>> &diag);
+
+  /**
+   * \brief Trace out n qubits, absorbing their sites into the neighbours.
+   * \param qubits Names of the qubits.
+  */
+  void PartialTrace (const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Calculate the reduced density matrix of n qubits.
+   * \param qubits Names of the qubits.
+   * \return The normalized density matrix, in the layout of QuantumNetworkSimulator::PeekDM.
+  */
+  std::vector<std::complex<double>> ReducedDM (const std::vector<std::string> &qubits) const;
+
+  /**
+   * \brief Get the truncation error incurred so far.
+   * \return Sum of the relative discarded weights of all the truncations.
+  */
+  double GetTruncationError () const;
+
+  /**
+   * \brief Get the largest bond dimension in the chain.
+   * \return The largest bond dimension.
+  */
+  unsigned GetMaxBondDim () const;
+
+  /**
+   * \brief Write the chain to a checkpoint.
+   * \param out Binary output stream.
+  */
+  void Save (std::ostream &out) const;
+
+  /**
+   * \brief Replace the chain by the one in a checkpoint.
+   * \param in Binary input stream.
+   * \return False if the checkpoint is truncated or corrupt.
+  */
+  bool Load (std::istream &in);
+
+private:
+  /** A site tensor A[l][p][r], row-major. */
+  struct Site
+  {
+    unsigned left;
+    unsigned right;
+    std::vector<std::complex<double>> data;
+  };
+
+  /**
+   * \brief Get the position of a qubit in the chain.
+  */
+  unsigned GetPosition (const std::string &qubit) const;
+
+  /**
+   * \brief Swap the qubits at two adjacent positions in the order of the chain.
+   * \param left Position of the first qubit.
+  */
+  void SwapOrder (const unsigned &left);
+
+  /**
+   * \brief Invalidate the trace environments depending on k adjacent sites.
+   * \param pos Position of the first changed site.
+   * \param k Number of changed sites.
+  */
+  void Invalidate (const unsigned &pos, const unsigned &k);
+
+  /**
+   * \brief Get the trace of the sites left of a position, updating the cache.
+   * \return Vector over the left bond of the site at pos.
+  */
+  const std::vector<std::complex<double>> &GetLeftEnv (const unsigned &pos) const;
+
+  /**
+   * \brief Get the trace of the sites right of a position, updating the cache.
+   * \return Vector over the right bond of the site at pos.
+  */
+  const std::vector<std::complex<double>> &GetRightEnv (const unsigned &pos) const;
+
+  /**
+   * \brief Bring n qubits next to each other in their order, by swapping adjacent sites.
+   * \return Position of the first qubit.
+  */
+  unsigned Gather (const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Apply a superoperator to k adjacent sites.
+   * \param pos Position of the first site.
+   * \param k Number of sites.
+   * \param superop Superoperator, row-major over the physical indices of the sites,
+   * where the first site is the most significant.
+  */
+  void ApplyAdjacent (const unsigned &pos, const unsigned &k,
+                      const std::vector<std::complex<double>> &superop);
+
+  /**
+   * \brief Split a merged tensor T[l][p_0]..[p_{k-1}][r] into k sites by truncated SVDs.
+  */
+  std::vector<Site> Split (std::vector<std::complex<double>> merged, unsigned left,
+                           const unsigned &k, const unsigned &right);
+
+  /**
+   * \brief Truncated SVD M = U S V^dagger of a row-major matrix.
+   * \param m Matrix of rows x cols.
+   * \param u Matrix to store U of rows x kept.
+   * \param s Vector to store the kept singular values.
+   * \param vh Matrix to store V^dagger of kept x cols.
+  */
+  void TruncatedSvd (const std::vector<std::complex<double>> &m, const unsigned &rows,
+                     const unsigned &cols, std::vector<std::complex<double>> &u,
+                     std::vector<double> &s, std::vector<std::complex<double>> &vh);
+
+  std::vector<Site> m_sites; /**< Site tensors along the chain. */
+  std::vector<std::string> m_order; /**< Name of the qubit at each position in the chain. */
+  std::unordered_map<std::string, unsigned> m_position; /**< Position of each qubit. */
+  mutable std::vector<std::vector<std::complex<double>>>
+      m_left_env; /**< Trace of the sites left of each position. */
+  mutable std::vector<std::vector<std::complex<double>>>
+      m_right_env; /**< Trace of the sites right of each position. */
+  mutable unsigned m_left_vld; /**< The left environments before it are up to date. */
+  mutable unsigned m_right_vld; /**< The right environments from it on are up to date. */
+  unsigned m_max_bond; /**< Maximum bond dimension. */
+  double m_tolerance; /**< Relative cutoff of singular values. */
+  double m_trunc_err; /**< Truncation error so far. */
+};
+
+} // namespace ns3
+
+#endif /* QUANTUM_MPS_H */
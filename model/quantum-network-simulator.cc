@@ -2,53 +2,267 @@
 
 #include "ns3/quantum-basis.h"
 #include "ns3/quantum-operation.h" // class QuantumOperation
+#include "ns3/quantum-mps.h" // class QuantumMPS
+
+#include "ns3/global-value.h" // class GlobalValue
+
+#ifdef _OPENMP
+#include <omp.h> // omp_set_num_threads
+#endif
+
+#ifdef QNS_MPI
+#include <mpi.h>
+
+#include <cstdlib> // std::atexit
+#endif
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("QuantumNetworkSimulator");
 
+/* ExaTN runtime, shared by all the simulators in a process */
+
+static GlobalValue g_exatnThreads ("ExatnThreads",
+                                   "Number of threads of the ExaTN node executor, or 0 for its default",
+                                   UintegerValue (0), MakeUintegerChecker<unsigned> ());
+
+static GlobalValue g_exatnHostBufferGB ("ExatnHostBufferGB",
+                                        "Size of the ExaTN host memory buffer in GB, or 0 for its default",
+                                        UintegerValue (0), MakeUintegerChecker<unsigned> ());
+
+static GlobalValue g_exatnGraphExecutor ("ExatnGraphExecutor", "Name of the ExaTN graph executor",
+                                         StringValue ("lazy-dag-executor"), MakeStringChecker ());
+
+static GlobalValue g_exatnNodeExecutor ("ExatnNodeExecutor",
+                                        "Name of the ExaTN node executor, i.e. the numerical backend",
+                                        StringValue ("talsh-node-executor"), MakeStringChecker ());
+
+/** Number of simulators using the ExaTN runtime. */
+static unsigned g_exatnUsers = 0;
+
+/** Count of ExaTN tensor names allocated automatically, unique across the simulators. */
+static unsigned g_exatnNameCount = 0;
+
+/** Flops of the ExaTN runtime already added to the statistics of some simulator. */
+static double g_exatnFlopsCounted = 0;
+
+#ifdef QNS_MPI
+/** Communicator of the ranks sharing the contractions. */
+static MPI_Comm g_exatnComm = MPI_COMM_WORLD;
+
+/**
+ * \brief Finalize MPI initialized by AcquireExatn, at the exit of the process,
+ * as MPI cannot be initialized again once finalized.
+*/
+static void
+FinalizeMpi ()
+{
+  if (exatn::isInitialized ()) // a simulator was never destroyed
+    {
+      exatn::finalize ();
+    }
+  int mpi_finalized = 0;
+  MPI_Finalized (&mpi_finalized);
+  if (!mpi_finalized)
+    {
+      MPI_Finalize ();
+    }
+}
+#endif
+
+static void
+AcquireExatn ()
+{
+  if (g_exatnUsers++)
+    {
+      return;
+    }
+
+  UintegerValue threads;
+  g_exatnThreads.GetValue (threads);
+  if (threads.Get ())
+    {
+#ifdef _OPENMP
+      // the OpenMP runtime read OMP_NUM_THREADS when it was loaded, so it is too late to set it
+      omp_set_num_threads ((int) threads.Get ());
+#else
+      NS_LOG_WARN ("ExatnThreads is ignored without OpenMP, set OMP_NUM_THREADS instead");
+#endif
+    }
+
+  exatn::ParamConf conf;
+  UintegerValue buffer_gb;
+  g_exatnHostBufferGB.GetValue (buffer_gb);
+  if (buffer_gb.Get ())
+    {
+      conf.setParameter ("host_memory_buffer_size", (long long) buffer_gb.Get () << 30);
+    }
+
+  StringValue graph_executor, node_executor;
+  g_exatnGraphExecutor.GetValue (graph_executor);
+  g_exatnNodeExecutor.GetValue (node_executor);
+  NS_LOG_INFO ("Initializing ExaTN with " << graph_executor.Get () << " and " << node_executor.Get ());
+#ifdef QNS_MPI
+  // every rank runs the same simulation, so that the collective ExaTN calls line up,
+  // and only rank 0 writes the output
+  int mpi_initialized = 0;
+  MPI_Initialized (&mpi_initialized);
+  if (!mpi_initialized)
+    {
+      int provided = 0;
+      MPI_Init_thread (nullptr, nullptr, MPI_THREAD_MULTIPLE, &provided);
+      NS_ABORT_MSG_IF (provided != MPI_THREAD_MULTIPLE,
+                       "The MPI library does not provide MPI_THREAD_MULTIPLE, needed by ExaTN");
+      std::atexit (&FinalizeMpi);
+    }
+  exatn::initialize (exatn::MPICommProxy (&g_exatnComm), conf, graph_executor.Get (),
+                     node_executor.Get ());
+  int rank = 0;
+  MPI_Comm_rank (g_exatnComm, &rank);
+  if (rank != 0)
+    {
+      if (!freopen ("/dev/null", "w", stdout))
+        {
+          NS_LOG_WARN ("Rank " << rank << " failed to discard its standard output");
+        }
+      std::clog.rdbuf (nullptr);
+    }
+#else
+  exatn::initialize (conf, graph_executor.Get (), node_executor.Get ());
+#endif
+}
+
+static void
+ReleaseExatn ()
+{
+  assert (g_exatnUsers);
+  if (--g_exatnUsers == 0)
+    {
+      exatn::finalize (); // MPI stays initialized until the exit, for the next simulator
+    }
+}
+
+/**
+ * \brief Wait for a submitted evaluation, and give every rank its output tensor.
+*/
+static bool
+SyncEvaluation (exatn::TensorNetwork &network)
+{
+  bool synced = exatn::sync (network);
+#ifdef QNS_MPI
+  synced &= exatn::replicateTensorSync (exatn::getDefaultProcessGroup (),
+                                        network.getTensor (0)->getName (), 0);
+#endif
+  return synced;
+}
+
 QuantumNetworkSimulator::QuantumNetworkSimulator (const std::vector<std::string> &owners)
     : m_dm (exatn::TensorNetwork ()),
       m_dm_id (1),
+      m_connected (true),
+      m_unit_traces (true),
       m_qubits_all (std::vector<std::string> ()),
       m_qubits_vld (std::vector<std::string> ()),
+      m_qubits_vld_set (std::unordered_set<std::string> ()),
       m_qubit2tensor (std::map<std::string, std::pair<unsigned, unsigned>> ()),
       m_qubit2tensor_dag (std::map<std::string, std::pair<unsigned, unsigned>> ()),
-
-      m_exatn_name_count (0),
-      m_exatn_tensors (std::vector<std::string> ())
+      m_qubit2diag (std::map<std::string, std::vector<std::complex<double>>> ()),
+      m_creg2qubit (std::map<std::string, std::string> ()),
+      m_dm_version (0),
+      m_collapse_epoch (0),
+      m_qubit2version (std::map<std::string, unsigned> ()),
+      m_rdm_cache (std::map<std::vector<std::string>, ReducedDMEntry> ()),
+      m_pending (std::map<unsigned, PendingEvaluation> ()),
+      m_next_ticket (0),
+      m_optimizer ("greed"),
+      m_eval_stats ({0, 0, 0., 0.}),
+      m_mps (nullptr),
+
+      m_exatn_tensors (std::unordered_set<std::string> ()),
+      m_exatn_user (true),
+      m_element_type (exatn::TensorElementType::COMPLEX64)
 {
   /* circuit */
 
-  exatn::initialize ();
+  AcquireExatn ();
 
   m_dm.rename (AllocExatnName ());
 }
 
 QuantumNetworkSimulator::QuantumNetworkSimulator (const QuantumNetworkSimulator &other)
+    : m_exatn_user (other.m_exatn_user), m_element_type (other.m_element_type)
 {
+  if (m_exatn_user)
+    {
+      AcquireExatn ();
+    }
   m_dm = other.m_dm;
   m_dm.rename (AllocExatnName ());
 
   m_dm_id = other.m_dm_id;
+  m_connected = other.m_connected;
+  m_unit_traces = other.m_unit_traces;
   m_qubits_all = other.m_qubits_all;
   m_qubits_vld = other.m_qubits_vld;
+  m_qubits_vld_set = other.m_qubits_vld_set;
   m_qubit2tensor = other.m_qubit2tensor;
   m_qubit2tensor_dag = other.m_qubit2tensor_dag;
+  m_qubit2diag = other.m_qubit2diag;
+  m_creg2qubit = other.m_creg2qubit;
+  m_dm_version = other.m_dm_version;
+  m_collapse_epoch = other.m_collapse_epoch;
+  m_qubit2version = other.m_qubit2version;
+  m_rdm_cache = other.m_rdm_cache;
+  m_pending = {}; // the copy collects none of the evaluations submitted before
+  m_next_ticket = other.m_next_ticket;
+  m_optimizer = other.m_optimizer;
+  m_eval_stats = other.m_eval_stats;
+  m_mps = other.m_mps ? CopyObject<QuantumMPS> (other.m_mps) : nullptr;
+  m_exatn_tensors = other.m_exatn_tensors; // shared by name, and never written once created
+
+  m_gates = other.m_gates;
+  m_gate2handle = other.m_gate2handle;
+  m_handle2qubit = other.m_handle2qubit;
+  for (QubitEntry &entry : m_handle2qubit)
+    { // resolved again into the maps of this copy
+      entry.tensor = nullptr;
+      entry.tensor_dag = nullptr;
+    }
+  m_qubit2handle = other.m_qubit2handle;
+  m_free_handles = other.m_free_handles;
 }
 
 QuantumNetworkSimulator::~QuantumNetworkSimulator ()
 {
-  exatn::finalize ();
+  if (m_exatn_user)
+    {
+      ReleaseExatn ();
+    }
 }
 
 QuantumNetworkSimulator::QuantumNetworkSimulator ()
     : m_dm (exatn::TensorNetwork ()),
       m_dm_id (1),
+      m_connected (true),
+      m_unit_traces (true),
       m_qubits_all (std::vector<std::string> ()),
       m_qubits_vld (std::vector<std::string> ()),
+      m_qubits_vld_set (std::unordered_set<std::string> ()),
       m_qubit2tensor (std::map<std::string, std::pair<unsigned, unsigned>> ()),
-      m_qubit2tensor_dag (std::map<std::string, std::pair<unsigned, unsigned>> ())
+      m_qubit2tensor_dag (std::map<std::string, std::pair<unsigned, unsigned>> ()),
+      m_qubit2diag (std::map<std::string, std::vector<std::complex<double>>> ()),
+      m_creg2qubit (std::map<std::string, std::string> ()),
+      m_dm_version (0),
+      m_collapse_epoch (0),
+      m_qubit2version (std::map<std::string, unsigned> ()),
+      m_rdm_cache (std::map<std::vector<std::string>, ReducedDMEntry> ()),
+      m_pending (std::map<unsigned, PendingEvaluation> ()),
+      m_next_ticket (0),
+      m_optimizer ("greed"),
+      m_eval_stats ({0, 0, 0., 0.}),
+      m_mps (nullptr),
+      m_exatn_user (false),
+      m_element_type (exatn::TensorElementType::COMPLEX64)
 {
 }
 
@@ -69,79 +283,75 @@ void
 QuantumNetworkSimulator::PrepareQubitsPure (const std::string &name,
                                            std::vector<std::complex<double>> data)
 {
-  if (std::find (m_exatn_tensors.begin (), m_exatn_tensors.end (), name) != m_exatn_tensors.end ())
+  if (m_exatn_tensors.count (name))
     {
       std::cout << "Preparing a tensor named \"" + name + "\" for some qubits' state twice. \\
                     Its okay but data ignored :)"
                 << std::endl;
       return;
     }
-  m_exatn_tensors.push_back (name);
+  m_exatn_tensors.insert (name);
 
   std::vector<size_t> extents (Log2 (data.size ()), 2);
-  assert (exatn::createTensor (name, exatn::TensorElementType::COMPLEX64, extents));
-  assert (exatn::initTensorData (name, data));
+  CreateTensor (name, extents, data);
 }
 
 void
 QuantumNetworkSimulator::PrepareQubitsMixed (const std::string &name,
                                              std::vector<std::complex<double>> data)
 {
-  if (std::find (m_exatn_tensors.begin (), m_exatn_tensors.end (), name) != m_exatn_tensors.end ())
+  if (m_exatn_tensors.count (name))
     {
       std::cout << "Preparing a tensor named \"" + name + "\" for some qubits' state twice. \\
                     Its okay but data ignored :)"
                 << std::endl;
       return;
     }
-  m_exatn_tensors.push_back (name);
+  m_exatn_tensors.insert (name);
 
   std::vector<size_t> extents ((Log2 (sqrt (data.size ())) << 1), 2);
-  assert (exatn::createTensor (name, exatn::TensorElementType::COMPLEX64, extents));
-  assert (exatn::initTensorData (name, data));
+  CreateTensor (name, extents, data);
 }
 
 void
 QuantumNetworkSimulator::PrepareGate (const std::string &name,
                                       const std::vector<std::complex<double>> &data)
 {
-  if (std::find (m_exatn_tensors.begin (), m_exatn_tensors.end (), name) != m_exatn_tensors.end ())
+  if (m_exatn_tensors.count (name))
     {
       return;
     }
   NS_LOG_LOGIC ("Preparing a gate named \"" << name << "\"");
-  m_exatn_tensors.push_back (name);
+  m_exatn_tensors.insert (name);
 
   std::vector<size_t> extents = {};
   for (size_t i = 0; i < (Log2 (sqrt (data.size ())) << 1); ++i)
     extents.push_back (2);
 
-  assert (exatn::createTensor (name, exatn::TensorElementType::COMPLEX64, extents));
-  assert (exatn::initTensorData (name, data));
+  CreateTensor (name, extents, data);
 }
 
 void
 QuantumNetworkSimulator::PrepareOperation (
     const std::string &name, const std::vector<std::vector<std::complex<double>>> &data)
 {
-  if (std::find (m_exatn_tensors.begin (), m_exatn_tensors.end (), name) != m_exatn_tensors.end ())
+  if (m_exatn_tensors.count (name))
     {
       return;
     }
-  m_exatn_tensors.push_back (name);
+  m_exatn_tensors.insert (name);
 
   std::vector<size_t> extents = {};
   for (size_t i = 0; i < sqrt (data[0].size ()); ++i)
     extents.push_back (2);
   extents.push_back (data.size ());
-  assert (exatn::createTensor (name, exatn::TensorElementType::COMPLEX64, extents));
 
   std::vector<std::complex<double>> data_flat = {};
   for (const std::vector<std::complex<double>> &op : data)
     {
       data_flat.insert (data_flat.end (), op.begin (), op.end ());
     }
-  assert (exatn::initTensorData (name, data_flat));
+  CreateTensor (name, extents, data_flat);
 }
 
 void
@@ -149,14 +359,42 @@ QuantumNetworkSimulator::PrepareTensor (const std::string &name,
                                         const std::vector<unsigned> &extents,
                                         const std::vector<std::complex<double>> &data)
 {
-  if (std::find (m_exatn_tensors.begin (), m_exatn_tensors.end (), name) != m_exatn_tensors.end ())
+  if (m_exatn_tensors.count (name))
+    {
+      return;
+    }
+  m_exatn_tensors.insert (name);
+
+  CreateTensor (name, std::vector<size_t> (extents.begin (), extents.end ()), data);
+}
+
+void
+QuantumNetworkSimulator::SetPrecision (const std::string &precision)
+{
+  assert (precision == "double" || precision == "single");
+  exatn::TensorElementType element_type = precision == "single"
+                                              ? exatn::TensorElementType::COMPLEX32
+                                              : exatn::TensorElementType::COMPLEX64;
+  if (element_type == m_element_type)
     {
       return;
     }
-  m_exatn_tensors.push_back (name);
+  assert (m_qubits_all.empty ()); // only before any qubit is generated
+  m_element_type = element_type;
+
+  // the tensors prepared so far are in the other precision, so prepare them again when used
+  m_exatn_tensors.clear ();
+  for (GateEntry &entry : m_gates)
+    {
+      entry.tensor = nullptr;
+    }
+  NS_LOG_INFO ("Simulating in " << precision << " precision");
+}
 
-  assert (exatn::createTensor (name, exatn::TensorElementType::COMPLEX64, extents));
-  assert (exatn::initTensorData (name, data));
+std::string
+QuantumNetworkSimulator::GetPrecision () const
+{
+  return m_element_type == exatn::TensorElementType::COMPLEX32 ? "single" : "double";
 }
 
 
@@ -170,6 +408,20 @@ QuantumNetworkSimulator::GenerateQubitsPure (
     const std::vector<std::string> &qubits
 )
 {
+  if (m_mps)
+    {
+      // rho = |psi><psi|
+      std::vector<std::complex<double>> rho = {};
+      for (const std::complex<double> &row : data)
+        {
+          for (const std::complex<double> &col : data)
+            {
+              rho.push_back (row * std::conj (col));
+            }
+        }
+      return GenerateQubitsMixed (owner, rho, qubits);
+    }
+
   Time moment = Simulator::Now ();
   std::string name = AllocExatnName ();
   PrepareQubitsPure (name, data);
@@ -193,14 +445,16 @@ QuantumNetworkSimulator::GenerateQubitsPure (
       assert (m_qubit2tensor_dag.find (qubit) == m_qubit2tensor_dag.end ());
     }
 
+  m_connected = m_connected && m_dm.getNumTensors () == 0; // a new component unless the first
+
   // onto the left half
-  m_dm.appendTensor (m_dm_id++, exatn::getTensor (name), {}, leg_dir, false);
+  m_dm.appendTensor (m_dm_id++, GetTensor (name), {}, leg_dir, false);
   NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
   unsigned tensor_id = m_dm.getMaxTensorId ();
   assert (tensor_id == m_dm_id - 1);
 
   // onto the right half
-  m_dm.appendTensor (m_dm_id++, exatn::getTensor (name), {}, leg_dir_dag, true);
+  m_dm.appendTensor (m_dm_id++, GetTensor (name), {}, leg_dir_dag, true);
   NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
   unsigned tensor_id_dag = m_dm.getMaxTensorId ();
   assert (tensor_id_dag == m_dm_id - 1);
@@ -209,8 +463,7 @@ QuantumNetworkSimulator::GenerateQubitsPure (
     {
       std::string qubit = qubits[i];
 
-      m_qubits_all.push_back (qubit);
-      m_qubits_vld.push_back (qubit);
+      AddValid (qubit);
 
       //             qubit idx tensor id  leg idx
       m_qubit2tensor[qubit] = {tensor_id, i};
@@ -228,6 +481,19 @@ QuantumNetworkSimulator::GenerateQubitsMixed (
 )
 {
   Time moment = Simulator::Now ();
+  if (m_mps)
+    {
+      NS_LOG_INFO (BLUE_CODE << "At time " << moment.As (Time::S) << " " << owner
+                             << " generates " << qubits.size () << " qubit(s) onto the chain"
+                             << END_CODE);
+      m_mps->GenerateQubits (data, qubits);
+      for (const std::string &qubit : qubits)
+        {
+          AddValid (qubit);
+        }
+      return true;
+    }
+
   std::string name = AllocExatnName ();
   PrepareQubitsMixed (name, data);
   
@@ -248,7 +514,8 @@ QuantumNetworkSimulator::GenerateQubitsMixed (
       leg_dirs.push_back (exatn::LegDirection::OUTWARD);
     }
 
-  m_dm.appendTensor (m_dm_id++, exatn::getTensor (name), {}, leg_dirs, false);
+  m_connected = m_connected && m_dm.getNumTensors () == 0; // a new component unless the first
+  m_dm.appendTensor (m_dm_id++, GetTensor (name), {}, leg_dirs, false);
   NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
   unsigned tensor_id = m_dm.getMaxTensorId ();
 
@@ -256,8 +523,7 @@ QuantumNetworkSimulator::GenerateQubitsMixed (
     {
       std::string qubit = qubits[i];
 
-      m_qubits_all.push_back (qubit);
-      m_qubits_vld.push_back (qubit);
+      AddValid (qubit);
 
       //             qubit idx tensor id  leg idx
       m_qubit2tensor[qubit] = {tensor_id, delta_height + i};
@@ -275,94 +541,168 @@ QuantumNetworkSimulator::ApplyGate (
     const std::vector<std::string> &qubits
 )
 {
-  Time moment = Simulator::Now ();
+  unsigned handle = RegisterGate (gate, data);
+  m_scratch_handles.clear ();
+  for (const std::string &qubit : qubits)
+    {
+      m_scratch_handles.push_back (GetQubitHandle (qubit));
+    }
+  return ApplyRegisteredGate (owner, handle, m_scratch_handles);
+}
 
-  assert (CheckValid (qubits));
+unsigned
+QuantumNetworkSimulator::RegisterGate (const std::string &gate,
+                                       const std::vector<std::complex<double>> &data)
+{
+  auto it = m_gate2handle.find (gate);
+  if (it != m_gate2handle.end ())
+    {
+      return it->second;
+    }
 
-  if (gate2data.find (gate) != gate2data.end ())
-    PrepareGate (gate, gate2data.find (gate)->second);
-  else {
-    assert (data.size ());
-    PrepareGate (gate, data);
-  }
+  const std::vector<std::complex<double>> &gate_data =
+      gate2data.find (gate) != gate2data.end () ? gate2data.find (gate)->second : data;
+  assert (gate_data.size ());
+  m_gates.push_back ({gate, gate_data, IsDiagonal (gate_data), nullptr});
+  m_gate2handle[gate] = m_gates.size () - 1;
+  return m_gates.size () - 1;
+}
 
-  NS_LOG_INFO (BLUE_CODE << "At time " << moment.As (Time::S) << " " << owner << " applies gate "
-                         << gate << " to qubits(s)");
-  for (const std::string &qubit : qubits)
+const std::string &
+QuantumNetworkSimulator::GetGateName (const unsigned &gate) const
+{
+  return m_gates.at (gate).name;
+}
+
+const std::vector<std::complex<double>> &
+QuantumNetworkSimulator::GetGateData (const unsigned &gate) const
+{
+  return m_gates.at (gate).data;
+}
+
+unsigned
+QuantumNetworkSimulator::GetQubitHandle (const std::string &qubit)
+{
+  auto it = m_qubit2handle.find (qubit);
+  if (it != m_qubit2handle.end ())
     {
-      NS_LOG_INFO (qubit);
+      return it->second;
+    }
+  unsigned handle = m_handle2qubit.size ();
+  if (m_free_handles.empty ())
+    {
+      m_handle2qubit.push_back ({qubit, nullptr, nullptr});
+    }
+  else
+    {
+      handle = m_free_handles.back ();
+      m_free_handles.pop_back ();
+      m_handle2qubit[handle].name = qubit;
+    }
+  m_qubit2handle[qubit] = handle;
+  return handle;
+}
+
+const std::string &
+QuantumNetworkSimulator::GetQubitName (const unsigned &qubit) const
+{
+  return m_handle2qubit.at (qubit).name;
+}
+
+bool
+QuantumNetworkSimulator::ApplyRegisteredGate (const std::string &owner, const unsigned &gate,
+                                              QuantumSpan<unsigned> qubits)
+{
+  assert (gate < m_gates.size ());
+  GateEntry &entry = m_gates[gate];
+  const unsigned n = qubits.size ();
+
+  NS_LOG_INFO (BLUE_CODE << "At time " << Simulator::Now ().As (Time::S) << " " << owner
+                         << " applies gate " << entry.name << " to qubits(s)");
+  for (const unsigned &qubit : qubits)
+    {
+      assert (qubit < m_handle2qubit.size ());
+      assert (m_qubits_vld_set.count (m_handle2qubit[qubit].name));
+      NS_LOG_INFO (m_handle2qubit[qubit].name);
     }
   NS_LOG_INFO (END_CODE);
 
-  // using qubit2tensor
-  std::vector<unsigned> old_tensor = {};
-  std::vector<unsigned> old_leg = {};
-  for (const std::string &qubit : qubits)
+  if (m_mps)
     {
-      old_tensor.push_back (m_qubit2tensor[qubit].first);
-      old_leg.push_back (m_qubit2tensor[qubit].second);
+      std::vector<std::string> names = {};
+      for (const unsigned &qubit : qubits)
+        {
+          names.push_back (m_handle2qubit[qubit].name);
+        }
+      Touch (names);
+      m_mps->ApplyKraus ({entry.data}, names);
+      return true;
     }
-  std::vector<unsigned> old_tensor_dag = {};
-  std::vector<unsigned> old_leg_dag = {};
-  for (const std::string &qubit : qubits)
+
+  // a diagonal single-qubit gate u is fused as d_ij = u_i * conj (u_j)
+  if (n == 1 && entry.diagonal)
     {
-      old_tensor_dag.push_back (m_qubit2tensor_dag[qubit].first);
-      old_leg_dag.push_back (m_qubit2tensor_dag[qubit].second);
+      const std::vector<std::complex<double>> &u = entry.data;
+      m_scratch_diag.resize (4);
+      m_scratch_diag[0] = u[0] * std::conj (u[0]);
+      m_scratch_diag[1] = u[0] * std::conj (u[3]);
+      m_scratch_diag[2] = u[3] * std::conj (u[0]);
+      m_scratch_diag[3] = u[3] * std::conj (u[3]);
+      AccumulateDiagonal (m_handle2qubit[qubits[0]].name, m_scratch_diag);
+      return true;
     }
-  std::vector<unsigned> new_leg = {};
-  for (unsigned i = 0; i < qubits.size (); ++i)
+  for (const unsigned &qubit : qubits)
+    {
+      FlushDiagonal (m_handle2qubit[qubit].name);
+      Touch (m_handle2qubit[qubit].name);
+    }
+  if (!entry.tensor)
     {
-      new_leg.push_back (i);
+      PrepareGate (entry.name, entry.data);
+      entry.tensor = GetTensor (entry.name);
     }
 
   // onto the left half
-  std::vector<std::pair<unsigned, unsigned>> pairing = {};
-  for (unsigned i = 0; i < old_tensor.size (); ++i)
+  m_scratch_pairing.clear ();
+  m_scratch_leg_dir.assign (n, exatn::LegDirection::INWARD);
+  m_scratch_leg_dir.resize (n << 1, exatn::LegDirection::OUTWARD);
+  for (unsigned i = 0; i < n; ++i)
     {
-      pairing.push_back (
-          {m_dm.getTensorConn (old_tensor[i])->getTensorLeg (old_leg[i]).getDimensionId (),
-           new_leg[i]});
+      const std::pair<unsigned, unsigned> &old = *ResolveQubit (qubits[i]).tensor;
+      m_scratch_pairing.push_back (
+          {m_dm.getTensorConn (old.first)->getTensorLeg (old.second).getDimensionId (), i});
     }
-  std::vector<exatn::LegDirection> leg_dir = {};
-  for (const std::string &qubit : qubits)
-    leg_dir.push_back (exatn::LegDirection::INWARD);
-  for (const std::string &qubit : qubits)
-    leg_dir.push_back (exatn::LegDirection::OUTWARD);
-  m_dm.appendTensor (m_dm_id++, exatn::getTensor (gate), pairing, leg_dir, false);
+  m_dm.appendTensor (m_dm_id++, entry.tensor, m_scratch_pairing, m_scratch_leg_dir, false);
   NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
 
   unsigned tensor_id = m_dm.getMaxTensorId ();
   assert (tensor_id == m_dm_id - 1);
 
   // updating qubit2tensor
-  for (unsigned i = 0; i < qubits.size (); ++i)
+  for (unsigned i = 0; i < n; ++i)
     {
-      //             qubit idx     tensor id  leg idx
-      m_qubit2tensor[qubits[i]] = {tensor_id, qubits.size () + i};
+      //                                  tensor id  leg idx
+      *m_handle2qubit[qubits[i]].tensor = {tensor_id, n + i};
     }
 
-  // onto the right half
-  std::vector<std::pair<unsigned, unsigned>> pairing_dag = {};
-  for (unsigned i = 0; i < old_tensor_dag.size (); ++i)
+  // onto the right half, whose open legs are numbered after the left half is appended
+  m_scratch_pairing_dag.clear ();
+  m_scratch_leg_dir_dag.assign (n, exatn::LegDirection::OUTWARD);
+  m_scratch_leg_dir_dag.resize (n << 1, exatn::LegDirection::INWARD);
+  for (unsigned i = 0; i < n; ++i)
     {
-      pairing_dag.push_back (
-          {m_dm.getTensorConn (old_tensor_dag[i])->getTensorLeg (old_leg_dag[i]).getDimensionId (),
-           new_leg[i]});
+      const std::pair<unsigned, unsigned> &old = *m_handle2qubit[qubits[i]].tensor_dag;
+      m_scratch_pairing_dag.push_back (
+          {m_dm.getTensorConn (old.first)->getTensorLeg (old.second).getDimensionId (), i});
     }
-  std::vector<exatn::LegDirection> leg_dir_dag = {};
-  for (const std::string &qubit : qubits)
-    leg_dir_dag.push_back (exatn::LegDirection::OUTWARD);
-  for (const std::string &qubit : qubits)
-    leg_dir_dag.push_back (exatn::LegDirection::INWARD);
-
-  m_dm.appendTensor (m_dm_id++, exatn::getTensor (gate), pairing_dag, leg_dir_dag, true);
+  m_dm.appendTensor (m_dm_id++, entry.tensor, m_scratch_pairing_dag, m_scratch_leg_dir_dag, true);
   NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
   unsigned tensor_id_dag = m_dm.getMaxTensorId ();
   assert (tensor_id_dag == m_dm_id - 1);
 
-  for (unsigned i = 0; i < qubits.size (); ++i)
+  for (unsigned i = 0; i < n; ++i)
     {
-      m_qubit2tensor_dag[qubits[i]] = {tensor_id_dag, qubits.size () + i};
+      *m_handle2qubit[qubits[i]].tensor_dag = {tensor_id_dag, n + i};
     }
 
   return true;
@@ -381,9 +721,12 @@ QuantumNetworkSimulator::ApplyOperation (
     }
 
   assert (CheckValid (qubits));
-
-  std::string name = AllocExatnName ();
-  PrepareOperation (name, quantumOperation.getOprs ());
+  if (!IsTracePreserving (quantumOperation.getOprs ()))
+    {
+      NS_LOG_LOGIC ("The operation does not preserve the trace");
+      ++m_collapse_epoch; // so its component rescales the reduced density matrix of any qubit
+      m_unit_traces = false;
+    }
 
   NS_LOG_LOGIC ("At time " << moment.As (Time::S) << " applying operation to qubits(s)");
   for (const auto &qubit : qubits)
@@ -391,6 +734,37 @@ QuantumNetworkSimulator::ApplyOperation (
       NS_LOG_LOGIC (qubit);
     }
   NS_LOG_LOGIC (END_CODE);
+  if (m_mps)
+    {
+      Touch (qubits);
+      m_mps->ApplyKraus (quantumOperation.getOprs (), qubits);
+      return true;
+    }
+
+  // a diagonal single-qubit operation {k} is fused as d_ij = sum_k k_i * conj (k_j)
+  bool diagonal = (qubits.size () == 1);
+  for (const std::vector<std::complex<double>> &opr : quantumOperation.getOprs ())
+    {
+      diagonal = diagonal && IsDiagonal (opr);
+    }
+  if (diagonal)
+    {
+      std::vector<std::complex<double>> diag (4, 0.0);
+      for (const std::vector<std::complex<double>> &opr : quantumOperation.getOprs ())
+        {
+          diag[0] += opr[0] * std::conj (opr[0]);
+          diag[1] += opr[0] * std::conj (opr[3]);
+          diag[2] += opr[3] * std::conj (opr[0]);
+          diag[3] += opr[3] * std::conj (opr[3]);
+        }
+      AccumulateDiagonal (qubits[0], diag);
+      return true;
+    }
+  FlushDiagonal (qubits);
+  Touch (qubits);
+
+  std::string name = AllocExatnName ();
+  PrepareOperation (name, quantumOperation.getOprs ());
 
   // using qubit2tensor
   std::vector<unsigned> tensor_id = {};
@@ -421,7 +795,7 @@ QuantumNetworkSimulator::ApplyOperation (
     }
   leg_dir.push_back (exatn::LegDirection::OUTWARD);
 
-  m_dm.appendTensor (m_dm_id++, exatn::getTensor (name), pairing, leg_dir, false);
+  m_dm.appendTensor (m_dm_id++, GetTensor (name), pairing, leg_dir, false);
   NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
 
   // updating qubit2tensor
@@ -445,7 +819,7 @@ QuantumNetworkSimulator::ApplyOperation (
     }
   leg_dir_dag.push_back (exatn::LegDirection::INWARD);
 
-  m_dm.appendTensor (m_dm_id++, exatn::getTensor (name), pairing_dag, leg_dir_dag, true);
+  m_dm.appendTensor (m_dm_id++, GetTensor (name), pairing_dag, leg_dir_dag, true);
   NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
 
   for (unsigned i = 0; i < qubits.size (); ++i)
@@ -478,244 +852,528 @@ QuantumNetworkSimulator::Measure (
 )
 {
   Time moment = Simulator::Now ();
-  assert (qubits.size () == 1);
+  assert (qubits.size () && CheckValid (qubits));
 
-  std::string qubit = qubits[0];
   NS_LOG_INFO (BLUE_CODE << "At time " << moment.As (Time::S) << " " << owner
-                         << " measures the qubit named " << qubits[0] << END_CODE);
-
-  // using qubit2tensor
-  std::vector<unsigned> tensor_id = {};
-  std::vector<unsigned> leg_idx = {};
-  for (const std::string &qubit : qubits)
-    {
-      tensor_id.push_back (m_qubit2tensor[qubit].first);
-      leg_idx.push_back (m_qubit2tensor[qubit].second);
-    }
-  std::vector<unsigned> tensor_id_dag = {};
-  std::vector<unsigned> leg_idx_dag = {};
+                         << " measures qubit(s) named");
   for (const std::string &qubit : qubits)
     {
-      tensor_id_dag.push_back (m_qubit2tensor_dag[qubit].first);
-      leg_idx_dag.push_back (m_qubit2tensor_dag[qubit].second);
+      NS_LOG_INFO (qubit);
     }
+  NS_LOG_INFO (END_CODE);
 
-  std::vector<unsigned> other_tensor_id = {};
-  std::vector<unsigned> other_leg_idx = {};
-  std::vector<unsigned> other_tensor_id_dag = {};
-  std::vector<unsigned> other_leg_idx_dag = {};
-  for (const std::string &q : m_qubits_all)
-    {
-      if (!CheckValid ({q}))
-        {
-          continue;
-        }
-      if (q != qubit)
-        {
-          other_tensor_id.push_back (m_qubit2tensor[q].first);
-          other_leg_idx.push_back (m_qubit2tensor[q].second);
-          other_tensor_id_dag.push_back (m_qubit2tensor_dag[q].first);
-          other_leg_idx_dag.push_back (m_qubit2tensor_dag[q].second);
-        }
-    }
+  // the full outcome distribution from one contraction
+  std::vector<double> prob_dist = GetDistribution (qubits);
 
-  // pick outcome
-  std::vector<double> prob_dist = {};
-  unsigned outcome = 0;
+  // pick the outcome according to the probability distribution
+  unsigned outcome = NextOutcome (prob_dist);
 
-  exatn::TensorNetwork circuit_meas;
-  std::string gate = QNS_GATE_PREFIX + "M0";
-  PrepareGate (gate, meas_0);
+  // update circuit
+  Collapse (qubits, outcome, prob_dist);
 
-  circuit_meas = m_dm;
-  unsigned id = m_dm_id;
-  circuit_meas.rename (AllocExatnName ());
-  circuit_meas.appendTensor (
-      id++, exatn::getTensor (gate),
-      {{circuit_meas.getTensorConn (tensor_id[0])->getTensorLeg (leg_idx[0]).getDimensionId (), 0}},
-      {exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD}, false);
-  circuit_meas.appendTensor (
-      id++, exatn::getTensor (gate),
-      {{circuit_meas.getTensorConn (tensor_id_dag[0])
-            ->getTensorLeg (leg_idx_dag[0])
-            .getDimensionId (),
-        0},
-       {circuit_meas.getTensorConn (id - 1)->getTensorLeg (1).getDimensionId (), 1}},
-      {exatn::LegDirection::OUTWARD, exatn::LegDirection::INWARD}, true);
+  return {outcome, prob_dist};
+}
 
-  PrepareGate (QNS_GATE_PREFIX + "I", pauli_I);
-  for (unsigned i = 0; i < other_tensor_id.size (); ++i)
-    {
-      circuit_meas.appendTensor (id++, exatn::getTensor (QNS_GATE_PREFIX + "I"),
-                                 {{circuit_meas.getTensorConn (other_tensor_id[i])
-                                       ->getTensorLeg (other_leg_idx[i])
-                                       .getDimensionId (),
-                                   0},
-                                  {circuit_meas.getTensorConn (other_tensor_id_dag[i])
-                                       ->getTensorLeg (other_leg_idx_dag[i])
-                                       .getDimensionId (),
-                                   1}},
-                                 {exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD},
-                                 false);
-    }
-  double prob = 0.0;
-  Evaluate (&circuit_meas);
-  auto talsh_tensor = exatn::getLocalTensor (circuit_meas.getTensor (0)->getName ());
-  assert (talsh_tensor->getVolume () == 1);
-  const std::complex<double> *body_ptr;
-  if (talsh_tensor->getDataAccessHostConst (&body_ptr))
+std::vector<std::pair<unsigned, std::vector<double>>>
+QuantumNetworkSimulator::MeasureBatch (
+    const std::vector<std::pair<std::string, std::vector<std::string>>> &requests
+)
+{
+  Time moment = Simulator::Now ();
+
+  std::vector<std::string> qubits = {};
+  for (const auto &[owner, request] : requests)
     {
-      assert (abs ((*body_ptr).imag ()) < EPS);
-      prob = (*body_ptr).real ();
+      NS_LOG_INFO (BLUE_CODE << "At time " << moment.As (Time::S) << " " << owner
+                             << " measures qubit(s) named");
+      for (const std::string &qubit : request)
+        {
+          NS_LOG_INFO (qubit);
+          assert (std::find (qubits.begin (), qubits.end (), qubit) == qubits.end ());
+          qubits.push_back (qubit);
+        }
+      NS_LOG_INFO (END_CODE);
     }
+  assert (qubits.size () && CheckValid (qubits));
 
-  // set the probability distribution
-  prob_dist.push_back (prob);
-  prob_dist.push_back (1.0 - prob);
-
-  // pick the outcome according to the probability distribution
-  std::complex<double> outcome_dirty = PickOutcome (prob);
-  outcome = (fabs (outcome_dirty.real () - 1.0) < EPS);
+  // the joint outcome distribution from one contraction
+  std::vector<double> prob_dist = GetDistribution (qubits);
+  unsigned outcome = NextOutcome (prob_dist);
+  Collapse (qubits, outcome, prob_dist);
 
-  // update circuit
-  std::string name;
-  std::vector<std::complex<double>> data;
-  if (outcome)
+  // split the joint outcome and marginalize the joint distribution for each request
+  std::vector<std::pair<unsigned, std::vector<double>>> results = {};
+  unsigned offset = 0;
+  for (const auto &[owner, request] : requests)
     {
-      data = (1 / sqrt (1 - prob)) * meas_1;
-    }
-  else
-    {
-      data = (1 / sqrt (prob)) * meas_0;
+      unsigned mask = (1 << request.size ()) - 1;
+      std::vector<double> marginal (1 << request.size (), 0.0);
+      for (unsigned i = 0; i < prob_dist.size (); ++i)
+        {
+          marginal[(i >> offset) & mask] += prob_dist[i];
+        }
+      results.push_back ({(outcome >> offset) & mask, marginal});
+      offset += request.size ();
     }
 
-  ApplyGate (owner, AllocExatnName (), data, qubits);
+  return results;
+}
 
-  return {outcome, prob_dist};
+void
+QuantumNetworkSimulator::ForceOutcome (const unsigned &outcome)
+{
+  m_forced_outcomes.push_back (outcome);
 }
 
-std::vector<std::complex<double>>
-QuantumNetworkSimulator::PeekDM (
-    const std::string &owner,
-    const std::vector<std::string> &qubits,
-    std::vector<std::complex<double>> &dm
-)
+unsigned
+QuantumNetworkSimulator::NextOutcome (const std::vector<double> &prob_dist)
 {
-  NS_LOG_LOGIC ("DM has now the number of tensors: " << m_dm.getNumTensors ());
-  Time moment = Simulator::Now ();
-  NS_LOG_INFO (BLUE_CODE << "At time " << moment.As (Time::S) << " " << owner
-                         << " peeks density matrix on qubit(s)");
-  for (const std::string &qubit : qubits)
+  if (m_forced_outcomes.empty ())
     {
-      NS_LOG_INFO (qubit);
+      return PickOutcome (prob_dist);
     }
-  NS_LOG_INFO (END_CODE);
+  unsigned outcome = m_forced_outcomes.front ();
+  m_forced_outcomes.pop_front ();
+  assert (outcome < prob_dist.size () && prob_dist[outcome] > 0);
+  return outcome;
+}
 
-  // using qubit2tensor
-  std::vector<unsigned> other_tensor_id = {};
-  std::vector<unsigned> other_leg_idx = {};
-  std::vector<unsigned> other_tensor_id_dag = {};
-  std::vector<unsigned> other_leg_idx_dag = {};
-  for (const std::string &q : m_qubits_all)
-    {
-      if (!CheckValid ({q}))
+std::vector<double>
+QuantumNetworkSimulator::GetDistribution (const std::vector<std::string> &qubits)
+{
+  // the diagonal of a cached reduced density matrix
+  auto cached = m_rdm_cache.find (qubits);
+  if (cached != m_rdm_cache.end () && cached->second.versions == GetVersions (qubits))
+    {
+      NS_LOG_LOGIC ("Reusing the cached reduced density matrix");
+      unsigned dim = 1 << qubits.size ();
+      std::vector<double> prob_dist = {};
+      for (unsigned i = 0; i < dim; ++i)
         {
-          continue;
+          prob_dist.push_back (std::max (cached->second.dm[i + dim * i].real (), 0.0));
         }
-      if (std::find (qubits.begin (), qubits.end (), q) == qubits.end ())
+      return prob_dist;
+    }
+  if (m_mps)
+    {
+      std::vector<std::complex<double>> dm = m_mps->ReducedDM (qubits);
+      unsigned dim = 1 << qubits.size ();
+      std::vector<double> prob_dist = {};
+      for (unsigned i = 0; i < dim; ++i)
         {
-          other_tensor_id.push_back (m_qubit2tensor[q].first);
-          other_leg_idx.push_back (m_qubit2tensor[q].second);
-          other_tensor_id_dag.push_back (m_qubit2tensor_dag[q].first);
-          other_leg_idx_dag.push_back (m_qubit2tensor_dag[q].second);
+          prob_dist.push_back (std::max (dm[i + dim * i].real (), 0.0));
         }
+      return prob_dist;
     }
 
-  // copy out the circuit
-  exatn::TensorNetwork circuit_peek = m_dm;
-  circuit_peek.rename (AllocExatnName ());
+  // copy out the light cone of the qubits
+  std::vector<std::string> qubits_cone = {};
+  exatn::TensorNetwork circuit_meas = ExtractLightCone (qubits, qubits_cone);
+  circuit_meas.rename (AllocExatnName ());
   unsigned id = m_dm_id;
 
   // partial trace
-  PrepareGate (QNS_GATE_PREFIX + "I", pauli_I);
-  for (unsigned i = 0; i < other_tensor_id.size (); ++i)
+  for (const std::string &q : qubits_cone)
     {
-      circuit_peek.appendTensor (id++, exatn::getTensor (QNS_GATE_PREFIX + "I"),
-                                 {{circuit_peek.getTensorConn (other_tensor_id[i])
-                                       ->getTensorLeg (other_leg_idx[i])
+      if (std::find (qubits.begin (), qubits.end (), q) != qubits.end ())
+        {
+          continue;
+        }
+      circuit_meas.appendTensor (id++, GetTensor (PrepareTrace (q)),
+                                 {{circuit_meas.getTensorConn (m_qubit2tensor[q].first)
+                                       ->getTensorLeg (m_qubit2tensor[q].second)
                                        .getDimensionId (),
                                    0},
-                                  {circuit_peek.getTensorConn (other_tensor_id_dag[i])
-                                       ->getTensorLeg (other_leg_idx_dag[i])
+                                  {circuit_meas.getTensorConn (m_qubit2tensor_dag[q].first)
+                                       ->getTensorLeg (m_qubit2tensor_dag[q].second)
                                        .getDimensionId (),
                                    1}},
                                  {exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD},
                                  false);
     }
 
-  // reorder the output legs
+  // close the wires of each measured qubit in a diagonal copy tensor, leaving one leg open
+  std::vector<unsigned> copy_id = {};
+  for (const std::string &qubit : qubits)
+    {
+      copy_id.push_back (id);
+      circuit_meas.appendTensor (id++, GetTensor (PrepareCopy (qubit)),
+                                 {{circuit_meas.getTensorConn (m_qubit2tensor[qubit].first)
+                                       ->getTensorLeg (m_qubit2tensor[qubit].second)
+                                       .getDimensionId (),
+                                   0},
+                                  {circuit_meas.getTensorConn (m_qubit2tensor_dag[qubit].first)
+                                       ->getTensorLeg (m_qubit2tensor_dag[qubit].second)
+                                       .getDimensionId (),
+                                   1}},
+                                 {exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD,
+                                  exatn::LegDirection::OUTWARD},
+                                 false);
+    }
+
+  // reorder the output legs such that bit i of an outcome is on qubits[i]
   std::vector<unsigned> order = {};
   for (unsigned i = 0; i < qubits.size (); ++i)
     {
-      order.push_back (circuit_peek.getTensorConn (m_qubit2tensor[qubits[i]].first)
-                           ->getTensorLeg (m_qubit2tensor[qubits[i]].second)
-                           .getDimensionId ());
+      order.push_back (circuit_meas.getTensorConn (copy_id[i])->getTensorLeg (2).getDimensionId ());
+    }
+  circuit_meas.reorderOutputModes (order);
+
+  Evaluate (&circuit_meas);
+
+  // access data
+  std::vector<double> prob_dist = {};
+  assert (circuit_meas.getTensor (0));
+  std::vector<std::complex<double>> body = ReadTensor (circuit_meas.getTensor (0)->getName ());
+  assert (body.size () == (1ull << qubits.size ()));
+  for (const std::complex<double> &val : body)
+    {
+      assert (abs (val.imag ()) < GetReadbackEps ());
+      prob_dist.push_back (std::max (val.real (), 0.0));
+    }
+
+  return prob_dist;
+}
+
+void
+QuantumNetworkSimulator::Collapse (const std::vector<std::string> &qubits, const unsigned &outcome,
+                                   const std::vector<double> &prob_dist)
+{
+  assert (prob_dist.size () == (1u << qubits.size ()) && prob_dist[outcome] > 0);
+  ++m_collapse_epoch; // a collapse is seen by the reduced density matrix of any qubit
+
+  // the bits of the qubits in each component, which are independent of the other components
+  std::vector<unsigned> masks = {(1u << qubits.size ()) - 1};
+  std::vector<unsigned> firsts = {0};
+  if (!m_mps && !m_connected)
+    {
+      std::map<unsigned, unsigned> components = FindComponents ();
+      std::map<unsigned, unsigned> root2idx = {};
+      masks.clear ();
+      firsts.clear ();
+      for (unsigned i = 0; i < qubits.size (); ++i)
+        {
+          unsigned root = components[m_qubit2tensor.at (qubits[i]).first];
+          if (root2idx.insert ({root, masks.size ()}).second)
+            {
+              masks.push_back (0);
+              firsts.push_back (i);
+            }
+          masks[root2idx[root]] |= 1u << i;
+        }
+    }
+
+  // the projectors are diagonal, and the renormalization of each component
+  // goes to its first qubit
+  std::vector<double> scales (qubits.size (), 1.0);
+  for (unsigned c = 0; c < masks.size (); ++c)
+    {
+      double marginal = 0;
+      for (unsigned o = 0; o < prob_dist.size (); ++o)
+        {
+          marginal += ((o ^ outcome) & masks[c]) ? 0. : prob_dist[o];
+        }
+      scales[firsts[c]] = 1.0 / marginal;
     }
   for (unsigned i = 0; i < qubits.size (); ++i)
     {
-      order.push_back (circuit_peek.getTensorConn (m_qubit2tensor_dag[qubits[i]].first)
-                           ->getTensorLeg (m_qubit2tensor_dag[qubits[i]].second)
-                           .getDimensionId ());
+      unsigned bit = (outcome >> i) & 1;
+      std::vector<std::complex<double>> proj (4, 0.0);
+      proj[(bit << 1) | bit] = scales[i];
+      AccumulateDiagonal (qubits[i], proj);
     }
-  circuit_peek.reorderOutputModes (order);
+}
+
+bool
+QuantumNetworkSimulator::MeasureToRegister (const std::string &owner,
+                                            const std::vector<std::string> &qubits,
+                                            const std::vector<std::string> &cregs)
+{
+  Time moment = Simulator::Now ();
+  assert (qubits.size () == cregs.size ());
+  assert (CheckValid (qubits));
 
+  NS_LOG_INFO (BLUE_CODE << "At time " << moment.As (Time::S) << " " << owner
+                         << " measures into classical register(s)");
+  for (unsigned i = 0; i < qubits.size (); ++i)
+    {
+      NS_LOG_INFO (qubits[i] << " -> " << cregs[i]);
 
-  Evaluate (&circuit_peek);
+      // the Kraus operators {|0><0|, |1><1|} are diagonal
+      AccumulateDiagonal (qubits[i], {1.0, 0.0, 0.0, 1.0});
+      m_creg2qubit[cregs[i]] = qubits[i];
+    }
+  NS_LOG_INFO (END_CODE);
 
-  // access data
-  assert (circuit_peek.getTensor (0));
-  auto talsh_tensor = exatn::getLocalTensor (circuit_peek.getTensor (0)->getName ());
-  NS_LOG_INFO (LIGHT_YELLOW_CODE << "Density Matrix: " << END_CODE);
-  assert (talsh_tensor);
-  const std::complex<double> *body_ptr;
-  if (talsh_tensor->getDataAccessHostConst (&body_ptr))
+  return true;
+}
+
+bool
+QuantumNetworkSimulator::ApplyClassicallyControlledGate (
+    const std::string &owner, const std::string &gate,
+    const std::vector<std::complex<double>> &data, const std::vector<std::string> &cregs,
+    const std::vector<std::string> &target_qubits)
+{
+  const std::vector<std::complex<double>> &gate_data =
+      gate2data.find (gate) != gate2data.end () ? gate2data.find (gate)->second : data;
+  unsigned dim_target = 1 << target_qubits.size ();
+  assert (gate_data.size () == dim_target * dim_target);
+
+  // targets are the low bits and registers the high bits, as in ApplyControlledOperation
+  std::vector<std::string> operated_qubits = target_qubits;
+  for (const std::string &creg : cregs)
+    {
+      assert (m_creg2qubit.find (creg) != m_creg2qubit.end ());
+      operated_qubits.push_back (m_creg2qubit[creg]);
+    }
+  unsigned dim = 1 << operated_qubits.size ();
+  unsigned ctrl = (1 << cregs.size ()) - 1;
+
+  std::vector<std::complex<double>> ctrl_data (dim * dim, 0.0);
+  for (unsigned c = 0; c <= ctrl; ++c)
     {
-      printf ("[\n");
-      assert (std::sqrt (talsh_tensor->getVolume ()) == std::pow (2, qubits.size ()));
-      if (qubits.size () < 5)
+      for (unsigned o = 0; o < dim_target; ++o)
         {
-          unsigned dim = std::sqrt (talsh_tensor->getVolume ());
-          for (unsigned i = 0; i < talsh_tensor->getVolume (); ++i)
-            {              
-              if (i % dim == i / dim) // diagonal
-                {
-                  std::cout << "<" << body_ptr[i] << ">";
-                }
-              else
-                {
-                  std::cout << " " << body_ptr[i] << " ";
-                }
-              if ((i + 1) % dim == 0)
-                {
-                  printf ("\n");
-                }
-              dm.push_back (body_ptr[i]);
+          for (unsigned i = 0; i < dim_target; ++i)
+            {
+              unsigned out = (c << target_qubits.size ()) | o;
+              unsigned in = (c << target_qubits.size ()) | i;
+              ctrl_data[out * dim + in] =
+                  (c == ctrl ? gate_data[o * dim_target + i] : (o == i ? 1.0 : 0.0));
             }
         }
-      else
-        { // too long for readability
-          printf ("...");
-          for (unsigned i = 0; i < talsh_tensor->getVolume (); ++i)
+    }
+
+  NS_LOG_INFO (BLUE_CODE << owner << " classically controls gate " << gate << " by "
+                         << cregs.size () << " register(s)" << END_CODE);
+
+  return ApplyGate ("God", QNS_GATE_PREFIX + "C" + std::to_string (cregs.size ()) + "_" + gate,
+                    ctrl_data, operated_qubits);
+}
+
+void
+QuantumNetworkSimulator::PeekBranches (const std::string &owner,
+                                       const std::vector<std::string> &cregs,
+                                       const std::vector<std::string> &qubits,
+                                       std::vector<double> &probs,
+                                       std::vector<std::vector<std::complex<double>>> &states)
+{
+  NS_LOG_INFO (BLUE_CODE << "At time " << Simulator::Now ().As (Time::S) << " " << owner
+                         << " peeks " << (1 << cregs.size ()) << " branches" << END_CODE);
+
+  std::vector<std::string> peeked = {};
+  for (const std::string &creg : cregs)
+    {
+      assert (m_creg2qubit.find (creg) != m_creg2qubit.end ());
+      peeked.push_back (m_creg2qubit[creg]);
+    }
+  peeked.insert (peeked.end (), qubits.begin (), qubits.end ());
+
+  SplitBranches (ReducedDM (peeked), cregs.size (), probs, states);
+}
+
+std::vector<std::complex<double>>
+QuantumNetworkSimulator::PeekDM (
+    const std::string &owner,
+    const std::vector<std::string> &qubits,
+    std::vector<std::complex<double>> &dm
+)
+{
+  NS_LOG_LOGIC ("DM has now the number of tensors: " << m_dm.getNumTensors ());
+  Time moment = Simulator::Now ();
+  NS_LOG_INFO (BLUE_CODE << "At time " << moment.As (Time::S) << " " << owner
+                         << " peeks density matrix on qubit(s)");
+  for (const std::string &qubit : qubits)
+    {
+      NS_LOG_INFO (qubit);
+    }
+  NS_LOG_INFO (END_CODE);
+
+  std::vector<std::complex<double>> reduced = ReducedDM (qubits);
+
+  NS_LOG_INFO (LIGHT_YELLOW_CODE << "Density Matrix: " << END_CODE);
+  printf ("[\n");
+  if (qubits.size () < 5)
+    {
+      unsigned dim = 1 << qubits.size ();
+      for (unsigned i = 0; i < reduced.size (); ++i)
+        {              
+          if (i % dim == i / dim) // diagonal
             {
-              dm.push_back (body_ptr[i]);
+              std::cout << "<" << reduced[i] << ">";
+            }
+          else
+            {
+              std::cout << " " << reduced[i] << " ";
+            }
+          if ((i + 1) % dim == 0)
+            {
+              printf ("\n");
             }
         }
-      printf ("]\n");
     }
+  else
+    { // too long for readability
+      printf ("...");
+    }
+  printf ("]\n");
+
+  dm.insert (dm.end (), reduced.begin (), reduced.end ());
+  return dm;
+}
+
+std::vector<std::complex<double>>
+QuantumNetworkSimulator::ReducedDM (const std::vector<std::string> &qubits)
+{
+  return CollectReducedDM (SubmitReducedDM (qubits));
+}
+
+unsigned
+QuantumNetworkSimulator::SubmitReducedDM (const std::vector<std::string> &qubits)
+{
+  assert (CheckValid (qubits));
+  unsigned ticket = m_next_ticket++;
+  PendingEvaluation &pending = m_pending[ticket];
+  pending.qubits = qubits;
+
+  auto cached = m_rdm_cache.find (qubits);
+  if (cached != m_rdm_cache.end () && cached->second.versions == GetVersions (qubits))
+    {
+      NS_LOG_LOGIC ("Reusing the cached reduced density matrix");
+      pending.dm = cached->second.dm;
+      return ticket;
+    }
+  if (m_mps)
+    {
+      pending.dm = m_mps->ReducedDM (qubits);
+      m_rdm_cache[qubits] = {GetVersions (qubits), pending.dm};
+      return ticket;
+    }
+  FlushDiagonal (qubits);
+  pending.versions = GetVersions (qubits);
+
+  // copy out the light cone of the qubits
+  std::vector<std::string> qubits_cone = {};
+  pending.circuit = std::make_shared<exatn::TensorNetwork> (ExtractLightCone (qubits, qubits_cone));
+  exatn::TensorNetwork &circuit_peek = *pending.circuit;
+  circuit_peek.rename (AllocExatnName ());
+  unsigned id = m_dm_id;
+
+  // partial trace
+  for (const std::string &q : qubits_cone)
+    {
+      if (std::find (qubits.begin (), qubits.end (), q) != qubits.end ())
+        {
+          continue;
+        }
+      circuit_peek.appendTensor (id++, GetTensor (PrepareTrace (q)),
+                                 {{circuit_peek.getTensorConn (m_qubit2tensor[q].first)
+                                       ->getTensorLeg (m_qubit2tensor[q].second)
+                                       .getDimensionId (),
+                                   0},
+                                  {circuit_peek.getTensorConn (m_qubit2tensor_dag[q].first)
+                                       ->getTensorLeg (m_qubit2tensor_dag[q].second)
+                                       .getDimensionId (),
+                                   1}},
+                                 {exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD},
+                                 false);
+    }
+
+  // reorder the output legs
+  std::vector<unsigned> order = {};
+  for (unsigned i = 0; i < qubits.size (); ++i)
+    {
+      order.push_back (circuit_peek.getTensorConn (m_qubit2tensor[qubits[i]].first)
+                           ->getTensorLeg (m_qubit2tensor[qubits[i]].second)
+                           .getDimensionId ());
+    }
+  for (unsigned i = 0; i < qubits.size (); ++i)
+    {
+      order.push_back (circuit_peek.getTensorConn (m_qubit2tensor_dag[qubits[i]].first)
+                           ->getTensorLeg (m_qubit2tensor_dag[qubits[i]].second)
+                           .getDimensionId ());
+    }
+  circuit_peek.reorderOutputModes (order);
+
+  Evaluate (&circuit_peek, "", true);
+  return ticket;
+}
+
+bool
+QuantumNetworkSimulator::IsReady (const unsigned &ticket)
+{
+  assert (m_pending.find (ticket) != m_pending.end ());
+  const PendingEvaluation &pending = m_pending[ticket];
+  return pending.circuit == nullptr || exatn::sync (*pending.circuit, false);
+}
+
+std::vector<std::complex<double>>
+QuantumNetworkSimulator::CollectReducedDM (const unsigned &ticket)
+{
+  auto it = m_pending.find (ticket);
+  assert (it != m_pending.end () && !it->second.contract);
+  PendingEvaluation pending = it->second;
+  m_pending.erase (it);
+  if (pending.circuit == nullptr) // served by the cache
+    {
+      return pending.dm;
+    }
+  exatn::TensorNetwork &circuit_peek = *pending.circuit;
+  auto time_start = exatn::Timer::timeInSecHR ();
+  bool synced = SyncEvaluation (circuit_peek);
+  assert (synced);
+  AddEvalCost (exatn::Timer::timeInSecHR (time_start));
+
+  // access data
+  assert (circuit_peek.getTensor (0));
+  std::vector<std::complex<double>> dm = ReadTensor (circuit_peek.getTensor (0)->getName ());
+  assert (dm.size () == (1ull << (pending.qubits.size () << 1)));
+
+  // keyed by the versions at submission, so stale if the qubits were touched since
+  if (m_rdm_cache.size () >= QNS_RDM_CACHE_SIZE)
+    {
+      m_rdm_cache.clear ();
+    }
+  m_rdm_cache[pending.qubits] = {pending.versions, dm};
 
   return dm;
 }
 
+std::vector<unsigned>
+QuantumNetworkSimulator::Sample (
+    const std::string &owner,
+    const std::vector<std::string> &qubits,
+    const unsigned &shots,
+    const std::vector<std::string> &keep_qubits,
+    std::vector<std::vector<std::complex<double>>> &states
+)
+{
+  Time moment = Simulator::Now ();
+  NS_LOG_INFO (BLUE_CODE << "At time " << moment.As (Time::S) << " " << owner << " samples "
+                         << shots << " shot(s) on qubit(s)");
+  for (const std::string &qubit : qubits)
+    {
+      NS_LOG_INFO (qubit);
+    }
+  NS_LOG_INFO (END_CODE);
+
+  // one contraction for the measured qubits and the kept ones
+  std::vector<std::string> peeked = qubits;
+  peeked.insert (peeked.end (), keep_qubits.begin (), keep_qubits.end ());
+  std::vector<double> prob_dist = {};
+  states.clear ();
+  SplitBranches (ReducedDM (peeked), qubits.size (), prob_dist, states);
+
+  // cheap sampling from the distribution
+  std::vector<unsigned> histogram (prob_dist.size (), 0);
+  for (unsigned shot = 0; shot < shots; ++shot)
+    {
+      ++histogram[PickOutcome (prob_dist)];
+    }
+
+  return histogram;
+}
+
 bool
 QuantumNetworkSimulator::PartialTrace (
   const std::vector<std::string> &qubits
@@ -731,33 +1389,44 @@ QuantumNetworkSimulator::PartialTrace (
 
   assert (CheckValid (qubits));
 
-  // using qubit2tensor
-  std::vector<unsigned> tensor_id = {};
-  std::vector<unsigned> leg_idx = {};
-  for (const std::string &qubit : qubits)
+  if (m_mps)
     {
-      tensor_id.push_back (m_qubit2tensor[qubit].first);
-      leg_idx.push_back (m_qubit2tensor[qubit].second);
+      m_mps->PartialTrace (qubits);
     }
-  std::vector<unsigned> tensor_id_dag = {};
-  std::vector<unsigned> leg_idx_dag = {};
-  for (const std::string &qubit : qubits)
+  else
     {
-      tensor_id_dag.push_back (m_qubit2tensor_dag[qubit].first);
-      leg_idx_dag.push_back (m_qubit2tensor_dag[qubit].second);
-    }
+      // using qubit2tensor
+      std::vector<unsigned> tensor_id = {};
+      std::vector<unsigned> leg_idx = {};
+      for (const std::string &qubit : qubits)
+        {
+          tensor_id.push_back (m_qubit2tensor[qubit].first);
+          leg_idx.push_back (m_qubit2tensor[qubit].second);
+        }
+      std::vector<unsigned> tensor_id_dag = {};
+      std::vector<unsigned> leg_idx_dag = {};
+      for (const std::string &qubit : qubits)
+        {
+          tensor_id_dag.push_back (m_qubit2tensor_dag[qubit].first);
+          leg_idx_dag.push_back (m_qubit2tensor_dag[qubit].second);
+        }
 
-  // partial trace
-  PrepareGate (QNS_GATE_PREFIX + "I", pauli_I);
-  for (unsigned i = 0; i < tensor_id.size (); ++i)
-    {
-      m_dm.appendTensor (
-          m_dm_id++, exatn::getTensor (QNS_GATE_PREFIX + "I"),
-          {{m_dm.getTensorConn (tensor_id[i])->getTensorLeg (leg_idx[i]).getDimensionId (), 0},
-           {m_dm.getTensorConn (tensor_id_dag[i])->getTensorLeg (leg_idx_dag[i]).getDimensionId (),
-            1}},
-          {exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD}, false);
-      NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
+      // partial trace, where a pending diagonal only weighs the closed wires
+      for (unsigned i = 0; i < tensor_id.size (); ++i)
+        {
+          std::string trace = PrepareTrace (qubits[i]);
+          m_qubit2diag.erase (qubits[i]);
+          m_dm.appendTensor (
+              m_dm_id++, GetTensor (trace),
+              {{m_dm.getTensorConn (tensor_id[i])->getTensorLeg (leg_idx[i]).getDimensionId (),
+                0},
+               {m_dm.getTensorConn (tensor_id_dag[i])
+                    ->getTensorLeg (leg_idx_dag[i])
+                    .getDimensionId (),
+                1}},
+              {exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD}, false);
+          NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
+        }
     }
 
   NS_LOG_LOGIC ("(qubit(s) named");
@@ -766,6 +1435,27 @@ QuantumNetworkSimulator::PartialTrace (
       NS_LOG_LOGIC (qubit);
       assert (CheckValid ({qubit}));
       m_qubits_vld.erase (std::find (m_qubits_vld.begin (), m_qubits_vld.end (), qubit));
+      m_qubits_vld_set.erase (qubit);
+      // free the handle, so that the name can be generated again
+      m_qubit2tensor.erase (qubit);
+      m_qubit2tensor_dag.erase (qubit);
+      auto handle = m_qubit2handle.find (qubit);
+      if (handle != m_qubit2handle.end ())
+        {
+          QubitEntry &entry = m_handle2qubit[handle->second];
+          entry.name.clear ();
+          entry.tensor = nullptr;
+          entry.tensor_dag = nullptr;
+          m_free_handles.push_back (handle->second);
+          m_qubit2handle.erase (handle);
+        }
+    }
+  for (auto it = m_creg2qubit.begin (); it != m_creg2qubit.end ();)
+    {
+      if (CheckValid ({it->second}))
+        ++it;
+      else
+        it = m_creg2qubit.erase (it);
     }
   NS_LOG_LOGIC ("traced out)" << END_CODE);
 
@@ -774,50 +1464,89 @@ QuantumNetworkSimulator::PartialTrace (
 
 std::vector<std::complex<double>>
 QuantumNetworkSimulator::Contract (const std::string &optimizer)
+{
+  return CollectContract (SubmitContract (optimizer));
+}
+
+unsigned
+QuantumNetworkSimulator::SubmitContract (const std::string &optimizer)
 {
   NS_LOG_INFO (BLUE_CODE << "Contracting the tensor network" << END_CODE);
+  FlushDiagonal (m_qubits_vld);
 
-  // evaluate the tensor network to get the density matrix
-  Evaluate (&m_dm, optimizer);
-  std::vector<std::complex<double>> dm;
-  auto talsh_tensor = exatn::getLocalTensor (m_dm.getTensor (0)->getName ());
-  const std::complex<double> *body_ptr;
-  assert (talsh_tensor);
-  if (talsh_tensor->getDataAccessHostConst (&body_ptr))
+  unsigned ticket = m_next_ticket++;
+  PendingEvaluation &pending = m_pending[ticket];
+  pending.contract = true;
+  if (m_mps)
     {
-      for (unsigned i = 0; i < talsh_tensor->getVolume (); ++i)
-        {
-          dm.push_back (body_ptr[i]);
-        }
+      // the chain stays as it is
+      pending.dm = m_mps->ReducedDM (m_qubits_vld);
+      return ticket;
+    }
+  pending.dm_name = m_dm.getName ();
+  pending.versions = {m_dm_id, m_dm_version, m_collapse_epoch};
+
+  // evaluate a copy, so that the tensor network may grow meanwhile
+  pending.circuit = std::make_shared<exatn::TensorNetwork> (m_dm);
+  pending.circuit->rename (AllocExatnName ());
+  Evaluate (pending.circuit.get (), optimizer, true);
+  return ticket;
+}
+
+std::vector<std::complex<double>>
+QuantumNetworkSimulator::CollectContract (const unsigned &ticket)
+{
+  auto it = m_pending.find (ticket);
+  assert (it != m_pending.end () && it->second.contract);
+  PendingEvaluation pending = it->second;
+  m_pending.erase (it);
+  if (pending.circuit == nullptr) // on the MPS backend
+    {
+      return pending.dm;
+    }
+  exatn::TensorNetwork &circuit = *pending.circuit;
+  auto time_start = exatn::Timer::timeInSecHR ();
+  bool synced = SyncEvaluation (circuit);
+  assert (synced);
+  AddEvalCost (exatn::Timer::timeInSecHR (time_start));
+
+  std::vector<std::complex<double>> dm = ReadTensor (circuit.getTensor (0)->getName ());
+
+  // the tensor network has grown since the submission, so keep it as is
+  if (pending.dm_name != m_dm.getName () ||
+      pending.versions != std::vector<unsigned>{m_dm_id, m_dm_version, m_collapse_epoch})
+    {
+      NS_LOG_LOGIC ("The tensor network changed since the contraction was submitted");
+      return dm;
     }
 
   // construct a tensor of the density matrix
   std::string contracted_name = AllocExatnName ();
-  std::vector<unsigned> extents (m_dm.getRank (), 2);
+  std::vector<unsigned> extents (circuit.getRank (), 2);
   PrepareTensor (contracted_name, extents, dm);
 
   // update qubit2tensor
-  assert (m_dm.getRank () == m_qubits_vld.size () * 2);
+  assert (circuit.getRank () == m_qubits_vld.size () * 2);
   for (unsigned i = 0; i < m_qubits_vld.size (); ++i)
     {
       m_qubit2tensor[m_qubits_vld[i]] = {1,
-        m_dm.getTensorConn (m_qubit2tensor[m_qubits_vld[i]].first)
+        circuit.getTensorConn (m_qubit2tensor[m_qubits_vld[i]].first)
             ->getTensorLeg (m_qubit2tensor[m_qubits_vld[i]].second)
             .getDimensionId ()};
       m_qubit2tensor_dag[m_qubits_vld[i]] = {1,
-        m_dm.getTensorConn (m_qubit2tensor_dag[m_qubits_vld[i]].first)
+        circuit.getTensorConn (m_qubit2tensor_dag[m_qubits_vld[i]].first)
             ->getTensorLeg (m_qubit2tensor_dag[m_qubits_vld[i]].second)
             .getDimensionId ()};
     }
   
   // reset the tensor network
-  std::vector<exatn::LegDirection> leg_dirs (m_dm.getRank (), exatn::LegDirection::UNDIRECT);
+  std::vector<exatn::LegDirection> leg_dirs (circuit.getRank (), exatn::LegDirection::UNDIRECT);
   for (unsigned i = 0; i < m_qubits_vld.size (); ++i)
     {
       leg_dirs[m_qubit2tensor[m_qubits_vld[i]].second] = exatn::LegDirection::OUTWARD;
       leg_dirs[m_qubit2tensor_dag[m_qubits_vld[i]].second] = exatn::LegDirection::INWARD;
     }
-  for (unsigned i = 0; i < m_dm.getRank (); ++i)
+  for (unsigned i = 0; i < circuit.getRank (); ++i)
     {
       assert (leg_dirs[i] != exatn::LegDirection::UNDIRECT);
     }
@@ -825,7 +1554,8 @@ QuantumNetworkSimulator::Contract (const std::string &optimizer)
   m_dm = exatn::TensorNetwork ();
   m_dm.rename (AllocExatnName ());
   m_dm_id = 1;
-  m_dm.appendTensor (m_dm_id++, exatn::getTensor (contracted_name), {}, leg_dirs, false);
+  m_connected = true;
+  m_dm.appendTensor (m_dm_id++, GetTensor (contracted_name), {}, leg_dirs, false);
   NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
    
   return dm;
@@ -838,161 +1568,586 @@ QuantumNetworkSimulator::CalculateFidelity (
 {
   NS_LOG_INFO (CYAN_CODE << "Calculating fidelity for epr pair (" << epr.first << ", " << epr.second << ")" << END_CODE);
 
-  // state vector of bell
-  PrepareTensor (QNS_PREFIX + "BellSV", {2, 2}, q_bell);
-
   // the epr density matrix rho with noise
   std::vector<std::string> qubits = {epr.first, epr.second};
-  std::vector<unsigned> other_tensor_id = {};
-  std::vector<unsigned> other_leg_idx = {};
-  std::vector<unsigned> other_tensor_id_dag = {};
-  std::vector<unsigned> other_leg_idx_dag = {};
-  for (const std::string &q : m_qubits_all)
+  std::vector<std::complex<double>> rho = ReducedDM (qubits);
+
+  NS_LOG_INFO (LIGHT_YELLOW_CODE << "Density Matrix: " << END_CODE);
+  printf ("[\n");
+  unsigned dim = 1 << qubits.size ();
+  for (unsigned i = 0; i < rho.size (); ++i)
+    {              
+      if (i % dim == i / dim) // diagonal
+        {
+          std::cout << "<" << rho[i] << ">";
+        }
+      else
+        {
+          std::cout << " " << rho[i] << " ";
+        }
+      if ((i + 1) % dim == 0)
+        {
+          printf ("\n");
+        }
+    }
+  printf ("]\n");
+
+  // calculate <bell|rho|bell> on the host
+  fidel = GetFidelity (rho, q_bell);
+
+  NS_LOG_INFO (CYAN_CODE << "=> The fidelity is " << fidel << END_CODE);
+
+  return fidel;
+}
+
+std::vector<double>
+QuantumNetworkSimulator::EvaluateMetrics (const std::vector<QuantumMetric> &requests)
+{
+  NS_LOG_INFO (CYAN_CODE << "Evaluating a batch of " << requests.size () << " metrics" << END_CODE);
+
+  // group the requests by the component of their first qubit
+  std::map<unsigned, unsigned> components = FindComponents ();
+  std::map<unsigned, std::vector<unsigned>> comp2requests = {};
+  for (unsigned idx = 0; idx < requests.size (); ++idx)
+    {
+      assert (requests[idx].qubits.size () && CheckValid (requests[idx].qubits));
+      unsigned comp = m_mps ? 0 : components[m_qubit2tensor[requests[idx].qubits[0]].first];
+      comp2requests[comp].push_back (idx);
+    }
+
+  // within a component, greedily merge the requests while the union stays small
+  std::vector<std::pair<std::vector<std::string>, std::vector<unsigned>>> groups = {};
+  for (const auto &[comp, idxs] : comp2requests)
+    {
+      groups.push_back ({{}, {}});
+      for (const unsigned &idx : idxs)
+        {
+          std::vector<std::string> merged = groups.back ().first;
+          for (const std::string &qubit : requests[idx].qubits)
+            {
+              if (std::find (merged.begin (), merged.end (), qubit) == merged.end ())
+                {
+                  merged.push_back (qubit);
+                }
+            }
+          if (merged.size () > QNS_BATCH_MAX_QUBITS && groups.back ().second.size ())
+            {
+              groups.push_back ({requests[idx].qubits, {}});
+            }
+          else
+            {
+              groups.back ().first = merged;
+            }
+          groups.back ().second.push_back (idx);
+        }
+    }
+  NS_LOG_LOGIC ("Grouped into " << groups.size () << " reduced density matrices");
+
+  // every group is submitted before any is collected, so that ExaTN overlaps their contractions
+  std::vector<unsigned> tickets = {};
+  for (const auto &[qubits, idxs] : groups)
+    {
+      tickets.push_back (SubmitReducedDM (qubits));
+    }
+
+  std::vector<double> values (requests.size (), 0.0);
+  for (unsigned g = 0; g < groups.size (); ++g)
+    {
+      const auto &[qubits, idxs] = groups[g];
+      std::vector<std::complex<double>> rho_group = CollectReducedDM (tickets[g]);
+      for (const unsigned &idx : idxs)
+        {
+          const QuantumMetric &request = requests[idx];
+          std::vector<unsigned> keep = {};
+          for (const std::string &qubit : request.qubits)
+            {
+              keep.push_back (std::find (qubits.begin (), qubits.end (), qubit) - qubits.begin ());
+            }
+          std::vector<std::complex<double>> rho = TraceOutHost (rho_group, keep);
+          unsigned dim = 1 << request.qubits.size ();
+
+          std::complex<double> value = 0.0;
+          switch (request.kind)
+            {
+            case QuantumMetric::FIDELITY:
+              value = GetFidelity (rho, request.data);
+              break;
+            case QuantumMetric::WERNER:
+              value = (4.0 * GetFidelity (rho, q_bell) - 1.0) / 3.0;
+              break;
+            case QuantumMetric::EXPECTATION:
+            case QuantumMetric::PAULI: {
+              // Tr (O rho), where O is row-major
+              const std::vector<std::complex<double>> &obs =
+                  request.kind == QuantumMetric::PAULI ? GetPauliString (request.pauli)
+                                                       : request.data;
+              assert (obs.size () == dim * dim);
+              for (unsigned r = 0; r < dim; ++r)
+                {
+                  for (unsigned c = 0; c < dim; ++c)
+                    {
+                      value += obs[r * dim + c] * rho[c + dim * r];
+                    }
+                }
+              break;
+            }
+            }
+          assert (abs (value.imag ()) < GetReadbackEps ());
+          values[idx] = value.real ();
+          NS_LOG_LOGIC ("     => metric " << idx << " = " << values[idx]);
+        }
+    }
+
+  return values;
+}
+
+/* the following functions and variables are for the "distill" optimizer only */
+
+// a subcircuit is identified by its smallest and largest tensor id (lo and hi)
+struct Subcircuit
+{
+  unsigned lo, hi, lc, rc;
+};
+
+std::vector<Subcircuit> subcircs;
+
+void
+QuantumNetworkSimulator::Checkpoint ()
+{
+  FlushDiagonal (m_qubits_vld);
+  if (subcircs.size())
+    subcircs.back().hi = m_dm_id - 1;
+  subcircs.push_back({m_dm_id, m_dm_id});
+  NS_LOG_DEBUG (YELLOW_CODE << "Checkpoint: " << m_dm_id << END_CODE);
+}
+
+void
+QuantumNetworkSimulator::SetBackend (const std::string &backend)
+{
+  assert (backend == "exatn" || backend == "mps");
+  if ((backend == "mps") == (m_mps != nullptr))
+    {
+      return;
+    }
+  assert (m_qubits_all.empty ()); // only before any qubit is generated
+  m_mps = backend == "mps" ? CreateObject<QuantumMPS> () : nullptr;
+  NS_LOG_INFO ("Simulating on the " << backend << " backend");
+}
+
+double
+QuantumNetworkSimulator::GetTruncationError () const
+{
+  return m_mps ? m_mps->GetTruncationError () : 0;
+}
+
+QuantumEvalStats
+QuantumNetworkSimulator::GetEvalStats () const
+{
+  return m_eval_stats;
+}
+
+void
+QuantumNetworkSimulator::Compact (const unsigned &max_qubits)
+{
+  if (m_mps)
     {
-      if (!CheckValid ({q}))
+      return;
+    }
+  FlushDiagonal (m_qubits_vld);
+  unsigned num_tensors = m_dm.getNumTensors ();
+  std::map<unsigned, unsigned> components = FindComponents ();
+
+  std::map<unsigned, std::vector<std::string>> root2qubits = {};
+  for (const std::string &qubit : m_qubits_vld)
+    {
+      root2qubits[components[m_qubit2tensor[qubit].first]].push_back (qubit);
+    }
+
+  // components kept as they are, including those without valid qubits
+  // if they may not trace to 1
+  std::set<unsigned> kept_roots = {};
+  if (!m_unit_traces)
+    {
+      for (const auto &[id, root] : components)
         {
+          if (root2qubits.find (root) == root2qubits.end ())
+            {
+              kept_roots.insert (root);
+            }
+        }
+    }
+
+  exatn::TensorNetwork compacted = exatn::TensorNetwork ();
+  compacted.rename (AllocExatnName ());
+  unsigned compacted_id = 1;
+  std::map<std::string, std::pair<unsigned, unsigned>> qubit2tensor = {};
+  std::map<std::string, std::pair<unsigned, unsigned>> qubit2tensor_dag = {};
+
+  // first the density matrices of the small components
+  for (const auto &[root, qubits] : root2qubits)
+    {
+      if (qubits.size () > max_qubits)
+        {
+          kept_roots.insert (root);
           continue;
         }
-      if (std::find (qubits.begin (), qubits.end (), q) == qubits.end ())
+
+      // a tensor of the density matrix, with the ket legs followed by the bra legs
+      std::vector<std::complex<double>> dm = ReducedDM (qubits);
+      std::string contracted_name = AllocExatnName ();
+      std::vector<unsigned> extents (qubits.size () << 1, 2);
+      PrepareTensor (contracted_name, extents, dm);
+
+      std::vector<exatn::LegDirection> leg_dirs (qubits.size (), exatn::LegDirection::OUTWARD);
+      leg_dirs.resize (qubits.size () << 1, exatn::LegDirection::INWARD);
+      compacted.appendTensor (compacted_id, GetTensor (contracted_name), {}, leg_dirs,
+                              false);
+      for (unsigned i = 0; i < qubits.size (); ++i)
         {
-          other_tensor_id.push_back (m_qubit2tensor[q].first);
-          other_leg_idx.push_back (m_qubit2tensor[q].second);
-          other_tensor_id_dag.push_back (m_qubit2tensor_dag[q].first);
-          other_leg_idx_dag.push_back (m_qubit2tensor_dag[q].second);
+          qubit2tensor[qubits[i]] = {compacted_id, i};
+          qubit2tensor_dag[qubits[i]] = {compacted_id, (unsigned) qubits.size () + i};
         }
+      ++compacted_id;
     }
 
-  // copy out the circuit
-  exatn::TensorNetwork circuit_peek = m_dm;
-  circuit_peek.rename (AllocExatnName ());
-  unsigned id = m_dm_id;
+  // then the tensors of the kept components, renumbered in the order they were appended
+  std::map<unsigned, unsigned> old2new = {};
+  for (auto it = m_dm.cbegin (); it != m_dm.cend (); ++it)
+    {
+      if (it->first != 0 && kept_roots.count (components[it->first]))
+        {
+          old2new[it->first] = 0;
+        }
+    }
+  for (auto &[old_id, new_id] : old2new)
+    {
+      new_id = compacted_id++;
+      exatn::numerics::TensorConn *conn = m_dm.getTensorConn (old_id);
+      std::vector<std::pair<unsigned, unsigned>> pairing = {};
+      std::vector<exatn::LegDirection> dirs = {};
+      const std::vector<exatn::numerics::TensorLeg> &legs = conn->getTensorLegs ();
+      for (unsigned leg = 0; leg < legs.size (); ++leg)
+        {
+          unsigned other = legs[leg].getTensorId ();
+          if (other != 0 && other < old_id)
+            {
+              pairing.push_back ({compacted.getTensorConn (old2new[other])
+                                      ->getTensorLeg (legs[leg].getDimensionId ())
+                                      .getDimensionId (),
+                                  leg});
+            }
+          dirs.push_back (legs[leg].getDirection ());
+        }
+      compacted.appendTensor (new_id, conn->getTensor (), pairing, dirs,
+                              conn->isComplexConjugated ());
+    }
+  for (const auto &[root, qubits] : root2qubits)
+    {
+      if (!kept_roots.count (root))
+        {
+          continue;
+        }
+      for (const std::string &qubit : qubits)
+        {
+          qubit2tensor[qubit] = {old2new[m_qubit2tensor[qubit].first], m_qubit2tensor[qubit].second};
+          qubit2tensor_dag[qubit] = {old2new[m_qubit2tensor_dag[qubit].first],
+                                     m_qubit2tensor_dag[qubit].second};
+        }
+    }
 
-  // partial trace
-  PrepareGate (QNS_GATE_PREFIX + "I", pauli_I);
-  for (unsigned i = 0; i < other_tensor_id.size (); ++i)
+  // the subcircuits keep the tensors left in their ranges, which stay contiguous,
+  // and the density matrices join the tensors contracted before the first one
+  bool subcircs_kept = true;
+  if (!subcircs.empty ())
     {
-      circuit_peek.appendTensor (id++, exatn::getTensor (QNS_GATE_PREFIX + "I"),
-                                 {{circuit_peek.getTensorConn (other_tensor_id[i])
-                                       ->getTensorLeg (other_leg_idx[i])
-                                       .getDimensionId (),
-                                   0},
-                                  {circuit_peek.getTensorConn (other_tensor_id_dag[i])
-                                       ->getTensorLeg (other_leg_idx_dag[i])
-                                       .getDimensionId (),
-                                   1}},
-                                 {exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD},
-                                 false);
+      unsigned before = (compacted_id - 1 - old2new.size ()) +
+                        std::distance (old2new.begin (), old2new.lower_bound (subcircs[0].lo));
+      subcircs_kept = before >= 2;
+    }
+  for (unsigned idx = 0; subcircs_kept && idx < subcircs.size (); ++idx)
+    {
+      Subcircuit &subcirc = subcircs[idx];
+      bool last = idx + 1 == subcircs.size (); // its range ends at the next tensor appended
+      auto lo = old2new.lower_bound (subcirc.lo);
+      auto hi = last ? old2new.end () : old2new.upper_bound (subcirc.hi);
+      if (!last && std::distance (lo, hi) < 2)
+        {
+          subcircs_kept = false;
+          break;
+        }
+      subcirc.lo = lo != hi ? lo->second : compacted_id;
+      subcirc.hi = lo != hi ? std::prev (hi)->second : compacted_id;
+    }
+  if (!subcircs_kept)
+    {
+      NS_LOG_LOGIC ("A subcircuit lost its tensors to the compaction, dropping the subcircuits");
+      subcircs.clear ();
     }
 
-  // reorder the output legs
-  std::vector<unsigned> order = {};
-  for (unsigned i = 0; i < qubits.size (); ++i)
+  for (const auto &[qubit, tensor] : qubit2tensor)
     {
-      order.push_back (circuit_peek.getTensorConn (m_qubit2tensor[qubits[i]].first)
-                           ->getTensorLeg (m_qubit2tensor[qubits[i]].second)
-                           .getDimensionId ());
+      m_qubit2tensor[qubit] = tensor;
+      m_qubit2tensor_dag[qubit] = qubit2tensor_dag[qubit];
     }
-  for (unsigned i = 0; i < qubits.size (); ++i)
+  m_dm = compacted;
+  m_dm_id = compacted_id;
+  m_connected = false;
+
+  NS_LOG_INFO (BLUE_CODE << "Compacted the tensor network from " << num_tensors << " to "
+                         << m_dm.getNumTensors () << " tensors" << END_CODE);
+}
+
+void
+QuantumNetworkSimulator::Save (std::ostream &out) const
+{
+  WriteBinary<uint8_t> (out, m_mps != nullptr);
+  WriteBinary<uint8_t> (out, m_element_type == exatn::TensorElementType::COMPLEX32);
+  WriteBinary (out, m_optimizer);
+  WriteBinary<uint32_t> (out, m_dm_id);
+  WriteBinary<uint32_t> (out, m_dm_version);
+  WriteBinary<uint32_t> (out, m_collapse_epoch);
+  WriteBinary<uint8_t> (out, m_unit_traces);
+
+  // qubits
+  WriteBinary<uint64_t> (out, m_qubits_all.size ());
+  for (const std::string &qubit : m_qubits_all)
     {
-      order.push_back (circuit_peek.getTensorConn (m_qubit2tensor_dag[qubits[i]].first)
-                           ->getTensorLeg (m_qubit2tensor_dag[qubits[i]].second)
-                           .getDimensionId ());
+      WriteBinary (out, qubit);
+    }
+  WriteBinary<uint64_t> (out, m_qubits_vld.size ());
+  for (const std::string &qubit : m_qubits_vld)
+    {
+      WriteBinary (out, qubit);
+      WriteBinary<uint32_t> (out, m_qubit2tensor.at (qubit).first);
+      WriteBinary<uint32_t> (out, m_qubit2tensor.at (qubit).second);
+      WriteBinary<uint32_t> (out, m_qubit2tensor_dag.at (qubit).first);
+      WriteBinary<uint32_t> (out, m_qubit2tensor_dag.at (qubit).second);
+    }
+  WriteBinary<uint64_t> (out, m_qubit2diag.size ());
+  for (const auto &[qubit, diag] : m_qubit2diag)
+    {
+      WriteBinary (out, qubit);
+      WriteBinary (out, diag);
+    }
+  WriteBinary<uint64_t> (out, m_creg2qubit.size ());
+  for (const auto &[creg, qubit] : m_creg2qubit)
+    {
+      WriteBinary (out, creg);
+      WriteBinary (out, qubit);
+    }
+  WriteBinary<uint64_t> (out, m_qubit2version.size ());
+  for (const auto &[qubit, version] : m_qubit2version)
+    {
+      WriteBinary (out, qubit);
+      WriteBinary<uint32_t> (out, version);
+    }
+
+  if (m_mps)
+    {
+      m_mps->Save (out);
+      return;
+    }
+
+  // data of the referenced tensors, each written once
+  std::map<std::string, unsigned> name2idx = {};
+  for (auto it = m_dm.cbegin (); it != m_dm.cend (); ++it)
+    {
+      if (it->first != 0)
+        {
+          name2idx.insert ({it->second.getTensor ()->getName (), name2idx.size ()});
+        }
+    }
+  std::vector<std::string> names (name2idx.size ());
+  for (const auto &[name, idx] : name2idx)
+    {
+      names[idx] = name;
+    }
+  WriteBinary<uint64_t> (out, names.size ());
+  for (const std::string &name : names)
+    {
+      WriteBinary (out, name);
+      std::vector<unsigned long long> extents = GetTensor (name)->getDimExtents ();
+      WriteBinary<uint64_t> (out, extents.size ());
+      for (const unsigned long long &extent : extents)
+        {
+          WriteBinary<uint64_t> (out, extent);
+        }
+      std::vector<std::complex<double>> data = ReadTensor (name);
+      WriteBinary<uint64_t> (out, data.size ());
+      while (out && out.tellp () % QNS_CHECKPOINT_ALIGN)
+        {
+          out.put (0);
+        }
+      if (m_element_type == exatn::TensorElementType::COMPLEX32)
+        {
+          std::vector<std::complex<float>> narrowed (data.begin (), data.end ());
+          out.write (reinterpret_cast<const char *> (narrowed.data ()),
+                     narrowed.size () * sizeof (std::complex<float>));
+        }
+      else
+        {
+          out.write (reinterpret_cast<const char *> (data.data ()),
+                     data.size () * sizeof (std::complex<double>));
+        }
+    }
+
+  // structure, in the order the tensors were appended
+  WriteBinary<uint64_t> (out, m_dm.getNumTensors ()); // not counting the output tensor
+  for (auto it = m_dm.cbegin (); it != m_dm.cend (); ++it)
+    {
+      if (it->first == 0)
+        {
+          continue;
+        }
+      const exatn::numerics::TensorConn &conn = it->second;
+      WriteBinary<uint32_t> (out, it->first);
+      WriteBinary<uint32_t> (out, name2idx.at (conn.getTensor ()->getName ()));
+      WriteBinary<uint8_t> (out, conn.isComplexConjugated ());
+      const std::vector<exatn::numerics::TensorLeg> &legs = conn.getTensorLegs ();
+      WriteBinary<uint32_t> (out, legs.size ());
+      for (const exatn::numerics::TensorLeg &leg : legs)
+        {
+          WriteBinary<uint32_t> (out, leg.getTensorId ());
+          WriteBinary<uint32_t> (out, leg.getDimensionId ());
+          WriteBinary<uint8_t> (out, leg.getDirection () == exatn::LegDirection::INWARD);
+        }
+    }
+}
+
+bool
+QuantumNetworkSimulator::Load (std::istream &in)
+{
+  assert (m_qubits_all.empty ()); // only before any qubit is generated
+  SetBackend (ReadBinary<uint8_t> (in) ? "mps" : "exatn");
+  SetPrecision (ReadBinary<uint8_t> (in) ? "single" : "double");
+  m_optimizer = ReadBinaryString (in);
+  m_dm_id = ReadBinary<uint32_t> (in);
+  m_dm_version = ReadBinary<uint32_t> (in);
+  m_collapse_epoch = ReadBinary<uint32_t> (in);
+  m_unit_traces = ReadBinary<uint8_t> (in);
+
+  // qubits
+  m_qubits_all.resize (ReadBinarySize (in));
+  for (std::string &qubit : m_qubits_all)
+    {
+      qubit = ReadBinaryString (in);
+    }
+  m_qubits_vld.resize (ReadBinarySize (in));
+  for (std::string &qubit : m_qubits_vld)
+    {
+      qubit = ReadBinaryString (in);
+      m_qubits_vld_set.insert (qubit);
+      m_qubit2tensor[qubit].first = ReadBinary<uint32_t> (in);
+      m_qubit2tensor[qubit].second = ReadBinary<uint32_t> (in);
+      m_qubit2tensor_dag[qubit].first = ReadBinary<uint32_t> (in);
+      m_qubit2tensor_dag[qubit].second = ReadBinary<uint32_t> (in);
+    }
+  for (uint64_t i = ReadBinarySize (in); i > 0; --i)
+    {
+      std::string qubit = ReadBinaryString (in);
+      m_qubit2diag[qubit] = ReadBinaryComplex (in);
+    }
+  for (uint64_t i = ReadBinarySize (in); i > 0; --i)
+    {
+      std::string creg = ReadBinaryString (in);
+      m_creg2qubit[creg] = ReadBinaryString (in);
+    }
+  for (uint64_t i = ReadBinarySize (in); i > 0; --i)
+    {
+      std::string qubit = ReadBinaryString (in);
+      m_qubit2version[qubit] = ReadBinary<uint32_t> (in);
+    }
+  m_rdm_cache.clear ();
+
+  if (m_mps)
+    {
+      return m_mps->Load (in);
+    }
+
+  // tensors allocated by the saving simulator are renamed, and gates keep their names
+  std::vector<std::string> names (ReadBinarySize (in));
+  for (std::string &name : names)
+    {
+      std::string saved = ReadBinaryString (in);
+      std::vector<unsigned> extents (ReadBinarySize (in, sizeof (uint64_t)));
+      for (unsigned &extent : extents)
+        {
+          extent = ReadBinary<uint64_t> (in);
+        }
+      std::vector<std::complex<double>> data (ReadBinarySize (in, sizeof (std::complex<float>)));
+      while (in && in.tellg () % QNS_CHECKPOINT_ALIGN)
+        {
+          in.get ();
+        }
+      if (m_element_type == exatn::TensorElementType::COMPLEX32)
+        {
+          std::vector<std::complex<float>> narrowed (data.size ());
+          in.read (reinterpret_cast<char *> (narrowed.data ()),
+                   narrowed.size () * sizeof (std::complex<float>));
+          data.assign (narrowed.begin (), narrowed.end ());
+        }
+      else
+        {
+          in.read (reinterpret_cast<char *> (data.data ()),
+                   data.size () * sizeof (std::complex<double>));
+        }
+      if (!in)
+        {
+          return false;
+        }
+      name = saved.rfind (QNS_EXATN_PREFIX, 0) == 0 ? AllocExatnName () : saved;
+      PrepareTensor (name, extents, data);
     }
-  circuit_peek.reorderOutputModes (order);
-
-  Evaluate (&circuit_peek);
-
-  assert (circuit_peek.getTensor (0));
-  NS_LOG_INFO (YELLOW_CODE << ":");
 
-  // access data
-  assert (circuit_peek.getTensor (0));
-  auto talsh_tensor = exatn::getLocalTensor (circuit_peek.getTensor (0)->getName ());
-  NS_LOG_INFO (LIGHT_YELLOW_CODE << "Density Matrix: " << END_CODE);
-  assert (talsh_tensor);
-  const std::complex<double> *body_ptr;
-  if (talsh_tensor->getDataAccessHostConst (&body_ptr))
+  // structure, where each tensor is paired with the ones appended before it
+  // and leaves its legs to the later ones open, to be paired by them
+  m_dm = exatn::TensorNetwork ();
+  m_dm.rename (AllocExatnName ());
+  m_connected = false;
+  for (uint64_t i = ReadBinarySize (in); i > 0; --i)
     {
-      printf ("[\n");
-      assert (std::sqrt (talsh_tensor->getVolume ()) == std::pow (2, qubits.size ()));
-      if (qubits.size () < 5)
+      unsigned id = ReadBinary<uint32_t> (in);
+      unsigned idx = ReadBinary<uint32_t> (in);
+      bool conjugated = ReadBinary<uint8_t> (in);
+      if (!in || idx >= names.size ())
         {
-          unsigned dim = std::sqrt (talsh_tensor->getVolume ());
-          for (unsigned i = 0; i < talsh_tensor->getVolume (); ++i)
-            {              
-              if (i % dim == i / dim) // diagonal
-                {
-                  std::cout << "<" << body_ptr[i] << ">";
-                }
-              else
-                {
-                  std::cout << " " << body_ptr[i] << " ";
-                }
-              if ((i + 1) % dim == 0)
+          return false;
+        }
+      std::vector<std::pair<unsigned, unsigned>> pairing = {};
+      std::vector<exatn::LegDirection> dirs = {};
+      unsigned num_legs = ReadBinary<uint32_t> (in);
+      for (unsigned leg = 0; in && leg < num_legs; ++leg)
+        {
+          unsigned other = ReadBinary<uint32_t> (in);
+          unsigned other_leg = ReadBinary<uint32_t> (in);
+          dirs.push_back (ReadBinary<uint8_t> (in) ? exatn::LegDirection::INWARD
+                                                   : exatn::LegDirection::OUTWARD);
+          if (other != 0 && other < id)
+            {
+              const exatn::numerics::TensorConn *conn = m_dm.getTensorConn (other);
+              if (!conn || other_leg >= conn->getNumLegs ())
                 {
-                  printf ("\n");
+                  return false;
                 }
+              pairing.push_back ({conn->getTensorLeg (other_leg).getDimensionId (), leg});
             }
         }
-      else
-        { // too long for readability
-          printf ("...");
+      if (!in || !m_dm.appendTensor (id, GetTensor (names[idx]), pairing, dirs, conjugated))
+        {
+          return false;
         }
-      printf ("]\n");
     }
-
-  // calculate <bell|rho|bell>
-  exatn::TensorNetwork circuit_fidel = exatn::TensorNetwork ();
-  circuit_fidel.rename (AllocExatnName ());
-  circuit_fidel.appendTensor (1, exatn::getTensor (QNS_PREFIX + "BellSV"), {},
-    {exatn::LegDirection::OUTWARD, exatn::LegDirection::OUTWARD}, false); // |bell>
-  circuit_fidel.appendTensor (2, exatn::getTensor (QNS_PREFIX + "BellSV"), {}, 
-    {exatn::LegDirection::INWARD, exatn::LegDirection::INWARD}, true); // <bell|
-  circuit_fidel.appendTensor (3, exatn::getTensor (circuit_peek.getTensor (0)->getName ()), 
-    {
-      {circuit_fidel.getTensorConn (1)->getTensorLeg (0).getDimensionId (), 0},
-      {circuit_fidel.getTensorConn (1)->getTensorLeg (1).getDimensionId (), 1},
-      {circuit_fidel.getTensorConn (2)->getTensorLeg (0).getDimensionId (), 2},
-      {circuit_fidel.getTensorConn (2)->getTensorLeg (1).getDimensionId (), 3}
-    },
-    {exatn::LegDirection::INWARD, exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD, exatn::LegDirection::OUTWARD},
-    false); // rho  
-
-  Evaluate (&circuit_fidel);
-  
-  // access data
-  assert (circuit_fidel.getTensor (0));
-  talsh_tensor = exatn::getLocalTensor (circuit_fidel.getTensor (0)->getName ());
-  assert (talsh_tensor);
-  assert (talsh_tensor->getVolume () == 1);
-  if (talsh_tensor->getDataAccessHostConst (&body_ptr))
+  if (!in)
     {
-      assert (abs ((*body_ptr).imag ()) < EPS);
-      fidel = (*body_ptr).real ();
+      return false;
     }
 
-  NS_LOG_INFO (CYAN_CODE << "=> The fidelity is " << fidel << END_CODE);
-
-  return fidel;
-}
-
-/* the following functions and variables are for the "distill" optimizer only */
-
-// a subcircuit is identified by its smallest and largest tensor id (lo and hi)
-struct Subcircuit
-{
-  unsigned lo, hi, lc, rc;
-};
-
-std::vector<Subcircuit> subcircs;
+  // the subcircuits refer to the saving simulator
+  subcircs.clear ();
 
-void
-QuantumNetworkSimulator::Checkpoint ()
-{
-  if (subcircs.size())
-    subcircs.back().hi = m_dm_id - 1;
-  subcircs.push_back({m_dm_id, m_dm_id});
-  NS_LOG_DEBUG (YELLOW_CODE << "Checkpoint: " << m_dm_id << END_CODE);
+  NS_LOG_INFO ("Restored " << m_qubits_vld.size () << " valid qubits in "
+                           << m_dm.getNumTensors () << " tensors");
+  return true;
 }
 
 void
@@ -1091,20 +2246,23 @@ AssignDistillSequence () {
 
 
 void
-QuantumNetworkSimulator::Evaluate (exatn::TensorNetwork *circuit, const std::string &optimizer)
+QuantumNetworkSimulator::Evaluate (exatn::TensorNetwork *circuit, const std::string &optimizer,
+                                   const bool &async)
 {
   if (circuit == nullptr)
     {
       circuit = &m_dm;
     }
+  const std::string &opt = optimizer.empty () ? m_optimizer : optimizer;
   NS_LOG_INFO (BLUE_CODE << "Evaluating the tensor network named " << circuit->getName () << END_CODE);
 
   std::vector<std::string> opts = {"dummy", "heuro", "greed", "metis", "cutnn"};
-  if (std::find (opts.begin (), opts.end (), optimizer) != opts.end ()) // hit
+  if (std::find (opts.begin (), opts.end (), opt) != opts.end ()) // hit
     {
-      exatn::resetContrSeqOptimizer (optimizer);
+      exatn::resetContrSeqOptimizer (opt);
     }
-  else if (optimizer == "ascend" && 2 < circuit->getMaxTensorId ())
+  else if (opt == "ascend" && 2 < circuit->getMaxTensorId () &&
+           circuit->getMaxTensorId () == circuit->getNumTensors ()) // contiguous tensor ids
     {
       // set the contraction sequence into an ascending order
       unsigned new_tensor_id = circuit->getMaxTensorId () + 1;
@@ -1122,7 +2280,8 @@ QuantumNetworkSimulator::Evaluate (exatn::TensorNetwork *circuit, const std::str
       contr_seq.push_back (circuit->getNumTensors ()); // right
       circuit->importContractionSequence (contr_seq);
     }
-  else if (optimizer == "distill" && 2 < circuit->getMaxTensorId ())
+  else if (opt == "distill" && subcircs.size () && 2 < circuit->getMaxTensorId () &&
+           circuit->getMaxTensorId () == m_dm_id - 1) // no query tensors appended
     {
       subcircs.back ().hi = m_dm_id - 1;
       distill_id = m_dm_id;
@@ -1137,15 +2296,49 @@ QuantumNetworkSimulator::Evaluate (exatn::TensorNetwork *circuit, const std::str
   // exatn::printContractionSequence (circuit->exportContractionSequence ());
 
   NS_LOG_INFO (PURPLE_CODE << "Evaluating tensor network of size " << circuit->getNumTensors ());
-  auto flops = exatn::getTotalFlopCount ();
+  ++m_eval_stats.evaluations;
+  m_eval_stats.max_tensors =
+      std::max (m_eval_stats.max_tensors, (unsigned) circuit->getNumTensors ());
   auto time_start = exatn::Timer::timeInSecHR ();
   circuit->collapseIsometries ();
+  if (async)
+    {
+      // to be synchronized by whoever needs the result
+#ifdef QNS_MPI
+      exatn::evaluate (exatn::getDefaultProcessGroup (), *circuit);
+#else
+      exatn::evaluate (*circuit);
+#endif
+      NS_LOG_INFO (" submitted" << END_CODE);
+      AddEvalCost (exatn::Timer::timeInSecHR (time_start));
+      return;
+    }
+#ifdef QNS_MPI
+  exatn::evaluateSync (exatn::getDefaultProcessGroup (), *circuit);
+  exatn::replicateTensorSync (exatn::getDefaultProcessGroup (), circuit->getTensor (0)->getName (),
+                              0);
+#else
   exatn::evaluateSync (*circuit);
+#endif
   auto duration = exatn::Timer::timeInSecHR (time_start);
-  flops = exatn::getTotalFlopCount () - flops;
+  AddEvalCost (duration);
   NS_LOG_INFO (" in " << duration << " secs" << END_CODE);
 }
 
+void
+QuantumNetworkSimulator::AddEvalCost (const double &seconds)
+{
+  // the flop count of the runtime is shared, so each flop goes to the first simulator seeing it
+  double flops = exatn::getTotalFlopCount ();
+  if (flops < g_exatnFlopsCounted) // the runtime was restarted
+    {
+      g_exatnFlopsCounted = 0;
+    }
+  m_eval_stats.flops += flops - g_exatnFlopsCounted;
+  m_eval_stats.seconds += seconds;
+  g_exatnFlopsCounted = flops;
+}
+
 /* util */
 
 bool
@@ -1153,16 +2346,7 @@ QuantumNetworkSimulator::CheckValid (const std::vector<std::string> &qubits) con
 {
   for (const std::string &qubit : qubits)
     {
-      bool valid = false;
-      for (const std::string &q : m_qubits_vld)
-        {
-          if (strcmp (qubit.c_str (), q.c_str ()) == 0)
-            {
-              valid = true;
-              break;
-            }
-        }
-      if (!valid)
+      if (m_qubits_vld_set.find (qubit) == m_qubits_vld_set.end ())
         {
           // NS_LOG_LOGIC (GREEN_CODE << "Skipping invalid qubit named " << qubit
           //                          << " with zero defect :)" << END_CODE);
@@ -1175,7 +2359,404 @@ QuantumNetworkSimulator::CheckValid (const std::vector<std::string> &qubits) con
 std::string
 QuantumNetworkSimulator::AllocExatnName ()
 {
-  return QNS_EXATN_PREFIX + std::to_string (m_exatn_name_count++);
+  return QNS_EXATN_PREFIX + std::to_string (g_exatnNameCount++);
+}
+
+std::string
+QuantumNetworkSimulator::ExatnName (const std::string &name) const
+{
+  if (m_element_type != exatn::TensorElementType::COMPLEX32 ||
+      name.rfind (QNS_EXATN_PREFIX, 0) == 0 ||
+      (name.size () >= QNS_SINGLE_SUFFIX.size () &&
+       name.compare (name.size () - QNS_SINGLE_SUFFIX.size (), QNS_SINGLE_SUFFIX.size (),
+                     QNS_SINGLE_SUFFIX) == 0))
+    {
+      return name;
+    }
+  return name + QNS_SINGLE_SUFFIX;
+}
+
+std::shared_ptr<exatn::Tensor>
+QuantumNetworkSimulator::GetTensor (const std::string &name) const
+{
+  return exatn::getTensor (ExatnName (name));
+}
+
+void
+QuantumNetworkSimulator::CreateTensor (const std::string &name, const std::vector<size_t> &extents,
+                                       const std::vector<std::complex<double>> &data)
+{
+  const std::string exatn_name = ExatnName (name);
+  if (exatn::tensorAllocated (exatn_name)) // a gate already prepared by another simulator
+    {
+      return;
+    }
+  bool created = exatn::createTensor (exatn_name, m_element_type, extents);
+  assert (created);
+  bool initialized = false;
+  if (m_element_type == exatn::TensorElementType::COMPLEX32)
+    {
+      initialized = exatn::initTensorData (
+          exatn_name, std::vector<std::complex<float>> (data.begin (), data.end ()));
+    }
+  else
+    {
+      initialized = exatn::initTensorData (exatn_name, data);
+    }
+  assert (initialized);
+}
+
+std::vector<std::complex<double>>
+QuantumNetworkSimulator::ReadTensor (const std::string &name) const
+{
+  auto talsh_tensor = exatn::getLocalTensor (ExatnName (name));
+  assert (talsh_tensor);
+  std::vector<std::complex<double>> data = {};
+  if (m_element_type == exatn::TensorElementType::COMPLEX32)
+    {
+      const std::complex<float> *body_ptr = nullptr;
+      if (talsh_tensor->getDataAccessHostConst (&body_ptr))
+        {
+          data.assign (body_ptr, body_ptr + talsh_tensor->getVolume ());
+        }
+    }
+  else
+    {
+      const std::complex<double> *body_ptr = nullptr;
+      if (talsh_tensor->getDataAccessHostConst (&body_ptr))
+        {
+          data.assign (body_ptr, body_ptr + talsh_tensor->getVolume ());
+        }
+    }
+  return data;
+}
+
+double
+QuantumNetworkSimulator::GetReadbackEps () const
+{
+  return m_element_type == exatn::TensorElementType::COMPLEX32 ? EPS_SINGLE : EPS;
+}
+
+
+
+void
+QuantumNetworkSimulator::AddValid (const std::string &qubit)
+{
+  if (m_qubit2version.find (qubit) == m_qubit2version.end ()) // a reused name is listed once
+    {
+      m_qubits_all.push_back (qubit);
+    }
+  m_qubits_vld.push_back (qubit);
+  m_qubits_vld_set.insert (qubit);
+  Touch ({qubit});
+}
+
+QuantumNetworkSimulator::QubitEntry &
+QuantumNetworkSimulator::ResolveQubit (const unsigned &qubit)
+{
+  QubitEntry &entry = m_handle2qubit[qubit];
+  if (!entry.tensor)
+    {
+      auto it = m_qubit2tensor.find (entry.name);
+      auto it_dag = m_qubit2tensor_dag.find (entry.name);
+      assert (it != m_qubit2tensor.end () && it_dag != m_qubit2tensor_dag.end ());
+      entry.tensor = &it->second; // stable until the qubit is traced out
+      entry.tensor_dag = &it_dag->second;
+    }
+  return entry;
+}
+
+void
+QuantumNetworkSimulator::Touch (const std::vector<std::string> &qubits)
+{
+  for (const std::string &qubit : qubits)
+    {
+      Touch (qubit);
+    }
+}
+
+void
+QuantumNetworkSimulator::Touch (const std::string &qubit)
+{
+  m_qubit2version[qubit] = ++m_dm_version;
+}
+
+std::vector<unsigned>
+QuantumNetworkSimulator::GetVersions (const std::vector<std::string> &qubits) const
+{
+  std::vector<unsigned> versions = {m_collapse_epoch};
+  for (const std::string &qubit : qubits)
+    {
+      auto it = m_qubit2version.find (qubit);
+      versions.push_back (it == m_qubit2version.end () ? 0 : it->second);
+    }
+  return versions;
+}
+
+
+std::map<unsigned, unsigned>
+QuantumNetworkSimulator::FindComponents () const
+{
+  std::map<unsigned, unsigned> parent = {};
+  std::function<unsigned (unsigned)> find = [&parent, &find] (unsigned id) {
+    if (parent.find (id) == parent.end ())
+      {
+        parent[id] = id;
+      }
+    if (parent[id] != id)
+      {
+        parent[id] = find (parent[id]);
+      }
+    return parent[id];
+  };
+  auto unite = [&find, &parent] (unsigned a, unsigned b) {
+    a = find (a);
+    b = find (b);
+    if (a != b)
+      {
+        parent[std::max (a, b)] = std::min (a, b);
+      }
+  };
+
+  for (auto it = m_dm.cbegin (); it != m_dm.cend (); ++it)
+    {
+      if (it->first == 0) // the output tensor
+        {
+          continue;
+        }
+      find (it->first);
+      for (const exatn::numerics::TensorLeg &leg : it->second.getTensorLegs ())
+        {
+          if (leg.getTensorId () != 0)
+            {
+              unite (it->first, leg.getTensorId ());
+            }
+        }
+    }
+  for (const std::string &qubit : m_qubits_vld)
+    {
+      unite (m_qubit2tensor.at (qubit).first, m_qubit2tensor_dag.at (qubit).first);
+    }
+
+  std::map<unsigned, unsigned> components = {};
+  for (const auto &[id, _] : parent)
+    {
+      components[id] = find (id);
+    }
+  return components;
+}
+
+exatn::TensorNetwork
+QuantumNetworkSimulator::ExtractLightCone (const std::vector<std::string> &qubits,
+                                           std::vector<std::string> &qubits_cone) const
+{
+  if (m_connected)
+    {
+      // a single component, nothing to leave out nor to search
+      qubits_cone = m_qubits_vld;
+      return m_dm;
+    }
+  std::map<unsigned, unsigned> components = FindComponents ();
+  std::set<unsigned> roots = {};
+  for (const std::string &qubit : qubits)
+    {
+      roots.insert (components[m_qubit2tensor.at (qubit).first]);
+    }
+  qubits_cone.clear ();
+  for (const std::string &qubit : m_qubits_vld)
+    {
+      if (roots.count (components[m_qubit2tensor.at (qubit).first]))
+        {
+          qubits_cone.push_back (qubit);
+        }
+    }
+
+  std::map<unsigned, const exatn::numerics::TensorConn *> cone = {};
+  for (auto it = m_dm.cbegin (); it != m_dm.cend (); ++it)
+    {
+      if (it->first != 0 && roots.count (components[it->first]))
+        {
+          cone[it->first] = &it->second;
+        }
+    }
+  if (cone.size () == m_dm.getNumTensors ())
+    {
+      // a single component, nothing to leave out
+      return m_dm;
+    }
+  NS_LOG_LOGIC ("Extracting a light cone of " << cone.size () << " out of "
+                                              << m_dm.getNumTensors () << " tensors");
+
+  // append the tensors in the order they were appended to m_dm,
+  // pairing each leg to an earlier tensor with the open leg it was paired with
+  exatn::TensorNetwork view = exatn::TensorNetwork ();
+  for (const auto &[id, conn] : cone)
+    {
+      std::vector<std::pair<unsigned, unsigned>> pairing = {};
+      std::vector<exatn::LegDirection> dirs = {};
+      const std::vector<exatn::numerics::TensorLeg> &legs = conn->getTensorLegs ();
+      for (unsigned leg = 0; leg < legs.size (); ++leg)
+        {
+          unsigned other = legs[leg].getTensorId ();
+          if (other != 0 && other < id)
+            {
+              pairing.push_back (
+                  {view.getTensorConn (other)->getTensorLeg (legs[leg].getDimensionId ()).getDimensionId (),
+                   leg});
+            }
+          dirs.push_back (legs[leg].getDirection ());
+        }
+      view.appendTensor (id, conn->getTensor (), pairing, dirs, conn->isComplexConjugated ());
+    }
+  return view;
+}
+
+
+/* diagonal */
+
+void
+QuantumNetworkSimulator::AccumulateDiagonal (const std::string &qubit,
+                                             const std::vector<std::complex<double>> &diag)
+{
+  assert (diag.size () == 4);
+  Touch ({qubit});
+  if (std::abs (diag[0] - 1.) > EPS || std::abs (diag[3] - 1.) > EPS)
+    {
+      ++m_collapse_epoch; // a projection rescales the reduced density matrix of any qubit
+    }
+  if (m_mps)
+    {
+      m_mps->ApplyDiagonal (qubit, diag);
+      return;
+    }
+  auto it = m_qubit2diag.find (qubit);
+  if (it == m_qubit2diag.end ())
+    {
+      m_qubit2diag[qubit] = diag;
+      return;
+    }
+  for (unsigned i = 0; i < 4; ++i)
+    {
+      it->second[i] *= diag[i];
+    }
+}
+
+void
+QuantumNetworkSimulator::FlushDiagonal (const std::vector<std::string> &qubits)
+{
+  for (const std::string &qubit : qubits)
+    {
+      FlushDiagonal (qubit);
+    }
+}
+
+void
+QuantumNetworkSimulator::FlushDiagonal (const std::string &qubit)
+{
+  auto it = m_qubit2diag.find (qubit);
+  if (it == m_qubit2diag.end ())
+    {
+      return;
+    }
+  std::vector<std::complex<double>> diag = std::move (it->second);
+  m_qubit2diag.erase (it);
+
+  bool identity = true;
+  for (const std::complex<double> &val : diag)
+    {
+      identity = identity && norm (val - 1.0) < EPS;
+    }
+  if (identity)
+    {
+      return;
+    }
+
+  // legs are (ket in, ket out, bra in, bra out) with the first one changing fastest
+  std::vector<std::complex<double>> data (16, 0.0);
+  for (unsigned i = 0; i < 2; ++i)
+    {
+      for (unsigned j = 0; j < 2; ++j)
+        {
+          data[i | (i << 1) | (j << 2) | (j << 3)] = diag[(i << 1) | j];
+        }
+    }
+  std::string name = AllocExatnName ();
+  PrepareTensor (name, {2, 2, 2, 2}, data);
+
+  m_dm.appendTensor (
+      m_dm_id++, GetTensor (name),
+      {{m_dm.getTensorConn (m_qubit2tensor[qubit].first)
+            ->getTensorLeg (m_qubit2tensor[qubit].second)
+            .getDimensionId (),
+        0},
+       {m_dm.getTensorConn (m_qubit2tensor_dag[qubit].first)
+            ->getTensorLeg (m_qubit2tensor_dag[qubit].second)
+            .getDimensionId (),
+        2}},
+      {exatn::LegDirection::INWARD, exatn::LegDirection::OUTWARD,
+       exatn::LegDirection::OUTWARD, exatn::LegDirection::INWARD},
+      false);
+  NS_LOG_DEBUG(YELLOW_CODE << m_dm_id - 1 << END_CODE);
+  unsigned tensor_id = m_dm.getMaxTensorId ();
+  assert (tensor_id == m_dm_id - 1);
+
+  m_qubit2tensor[qubit] = {tensor_id, 1};
+  m_qubit2tensor_dag[qubit] = {tensor_id, 3};
+}
+
+std::string
+QuantumNetworkSimulator::PrepareCopy (const std::string &qubit)
+{
+  std::vector<std::complex<double>> weight = {1.0, 1.0};
+  auto it = m_qubit2diag.find (qubit);
+  if (it != m_qubit2diag.end ())
+    {
+      weight = {it->second[0], it->second[3]};
+    }
+
+  // legs are (ket, bra, open) with the first one changing fastest
+  std::vector<std::complex<double>> data (8, 0.0);
+  data[0] = weight[0];
+  data[7] = weight[1];
+
+  if (norm (weight[0] - 1.0) < EPS && norm (weight[1] - 1.0) < EPS)
+    {
+      PrepareTensor (QNS_GATE_PREFIX + "COPY", {2, 2, 2}, data);
+      return QNS_GATE_PREFIX + "COPY";
+    }
+  std::string name = AllocExatnName ();
+  PrepareTensor (name, {2, 2, 2}, data);
+  return name;
+}
+
+std::string
+QuantumNetworkSimulator::PrepareTrace (const std::string &qubit,
+                                       const std::vector<std::complex<double>> &proj)
+{
+  assert (proj.size () == 4 && IsDiagonal (proj));
+
+  // the trace only sees the diagonal entries d_00 and d_11 of the pending superoperator
+  std::vector<std::complex<double>> weight = proj;
+  auto it = m_qubit2diag.find (qubit);
+  if (it != m_qubit2diag.end ())
+    {
+      weight[0] *= it->second[0];
+      weight[3] *= it->second[3];
+    }
+
+  if (norm (weight[0] - 1.0) < EPS && norm (weight[3] - 1.0) < EPS)
+    {
+      PrepareGate (QNS_GATE_PREFIX + "I", pauli_I);
+      return QNS_GATE_PREFIX + "I";
+    }
+  if (norm (weight[0] - 1.0) < EPS && norm (weight[3]) < EPS)
+    {
+      PrepareGate (QNS_GATE_PREFIX + "M0", meas_0);
+      return QNS_GATE_PREFIX + "M0";
+    }
+  std::string name = AllocExatnName ();
+  PrepareGate (name, weight);
+  return name;
 }
 
 
@@ -1210,12 +2791,14 @@ QuantumNetworkSimulator::PrintTalshTensor (std::shared_ptr<talsh::Tensor> talsh_
 void
 QuantumNetworkSimulator::PrintTalshTensorNamed (const std::string &name)
 {
-  exatn::getTensor (name)->printIt ();
+  GetTensor (name)->printIt ();
   std::cout << "  <= shape, data=> ";
-  auto talsh_tensor = exatn::getLocalTensor (name);
-  assert (talsh_tensor);
-  const std::complex<double> *body_ptr = nullptr;
-  PrintTalshTensor (talsh_tensor, body_ptr);
+  printf ("[");
+  for (const std::complex<double> &val : ReadTensor (name))
+    {
+      std::cout << "< " << val << " >";
+    }
+  printf ("]\n");
 }
 
 } // namespace ns3
\ No newline at end of file
@@ -5,9 +5,44 @@
 
 #include "ns3/quantum-basis.h"
 
+#include <unordered_map>
+#include <unordered_set>
+
 namespace ns3 {
 
 class QuantumOperation;
+class QuantumMPS;
+
+/**
+ * \brief A request in a batched evaluation of metrics on some qubits.
+*/
+struct QuantumMetric
+{
+  /** Kinds of metrics. */
+  enum Kind
+  {
+    FIDELITY, /**< Fidelity to the target state vector in data. */
+    EXPECTATION, /**< Expectation of the observable in data. */
+    PAULI, /**< Expectation of the Pauli string in pauli. */
+    WERNER /**< Werner parameter of an EPR pair, from its fidelity to the bell state. */
+  };
+
+  Kind kind;
+  std::vector<std::string> qubits; /**< Names of the qubits, where the i-th one is bit i. */
+  std::vector<std::complex<double>> data; /**< Target state vector or observable. */
+  std::string pauli; /**< Pauli string, one character for each qubit. */
+};
+
+/**
+ * \brief Statistics of the tensor network evaluations so far.
+*/
+struct QuantumEvalStats
+{
+  unsigned evaluations; /**< Number of evaluations, synchronous or submitted. */
+  unsigned max_tensors; /**< Largest number of tensors in an evaluated network. */
+  double flops; /**< Floating-point operations of the evaluations, synchronous or collected. */
+  double seconds; /**< Time spent evaluating, or submitting and waiting for a submitted one. */
+};
 
 class QuantumNetworkSimulator : public Object
 {
@@ -24,12 +59,23 @@ private:
   /** Next tensor id in the tensor network */
   unsigned m_dm_id;
 
+  /** Whether the tensor network is known to be a single component,
+   * so that the light cone of any qubits is all of it. */
+  bool m_connected;
+
+  /** Whether every component is known to trace to 1, as no operation so far
+   * failed to preserve the trace, so that those without valid qubits can be dropped. */
+  bool m_unit_traces;
+
   /** All generated qubits. */
   std::vector<std::string> m_qubits_all;
 
   /** Valid qubits that are not traced out. */
   std::vector<std::string> m_qubits_vld;
 
+  /** Valid qubits, for a constant-time CheckValid. */
+  std::unordered_set<std::string> m_qubits_vld_set;
+
   /** Map from qubit name to its tensor id in the "ket" half
    * of the tensor network, and the leg id in the tensor. */
   std::map<std::string, std::pair<unsigned, unsigned>> m_qubit2tensor;
@@ -38,14 +84,129 @@ private:
    * of the tensor network, and the leg id in the tensor. */
   std::map<std::string, std::pair<unsigned, unsigned>> m_qubit2tensor_dag;
 
+  /** Map from qubit name to its pending diagonal superoperator d,
+   * which scales the density matrix entries rho_{..i.., ..j..} by d[(i << 1) | j].
+   * Diagonal gates and operations on a single qubit are fused here
+   * instead of being appended to the tensor network. */
+  std::map<std::string, std::vector<std::complex<double>>> m_qubit2diag;
+
+  /** Map from classical register name to the dephased qubit whose wire records it. */
+  std::map<std::string, std::string> m_creg2qubit;
+
+  /** Outcomes of the next measurements, forced instead of sampled. */
+  std::deque<unsigned> m_forced_outcomes;
+
+
+/* cache */
+
+  /** A cached reduced density matrix, valid as long as its versions are current. */
+  struct ReducedDMEntry
+  {
+    std::vector<unsigned> versions; /**< Collapse epoch followed by the version of each qubit. */
+    std::vector<std::complex<double>> dm; /**< The reduced density matrix. */
+  };
+
+  /** Version of the tensor network, bumped by any operation touching some qubits. */
+  unsigned m_dm_version;
+
+  /** Count of collapses and of operations not preserving the trace, each of which
+   * may change the reduced density matrix of any qubit, as it is not normalized. */
+  unsigned m_collapse_epoch;
+
+  /** Map from qubit name to the version of the last operation touching it. */
+  std::map<std::string, unsigned> m_qubit2version;
+
+  /** Map from an ordered set of qubits to its cached reduced density matrix. */
+  std::map<std::vector<std::string>, ReducedDMEntry> m_rdm_cache;
+
+
+
+/* async */
+
+  /** An evaluation submitted to ExaTN but not collected yet. */
+  struct PendingEvaluation
+  {
+    std::shared_ptr<exatn::TensorNetwork> circuit; /**< Circuit being evaluated, or nullptr if served by the cache. */
+    std::vector<std::string> qubits; /**< Qubits of a reduced density matrix. */
+    std::vector<unsigned> versions; /**< Versions of the qubits, or the stamp of m_dm for a contraction. */
+    std::vector<std::complex<double>> dm; /**< Reduced density matrix served by the cache. */
+    bool contract = false; /**< Whether it contracts the whole tensor network. */
+    std::string dm_name = ""; /**< Name of m_dm at the submission of a contraction. */
+  };
+
+  /** Map from ticket to its pending evaluation. */
+  std::map<unsigned, PendingEvaluation> m_pending;
+
+  /** Next ticket of a submitted evaluation. */
+  unsigned m_next_ticket;
+
+  /** Default contraction sequence optimizer. */
+  std::string m_optimizer;
+
+  /** Statistics of the evaluations so far. */
+  QuantumEvalStats m_eval_stats;
+
+
+/* backend */
+
+  /** Matrix product state replacing the tensor network on the "mps" backend, or nullptr. */
+  Ptr<QuantumMPS> m_mps;
+
+
+/* handle */
+
+  /** A gate registered once, to be applied by its handle. */
+  struct GateEntry
+  {
+    std::string name;
+    std::vector<std::complex<double>> data;
+    bool diagonal; /**< Whether a single-qubit application is fused as a diagonal. */
+    std::shared_ptr<exatn::Tensor> tensor; /**< The ExaTN tensor, or nullptr if not prepared yet. */
+  };
+
+  /** A qubit name with its entries in m_qubit2tensor and m_qubit2tensor_dag,
+   * resolved at its first gate after being generated. */
+  struct QubitEntry
+  {
+    std::string name;
+    std::pair<unsigned, unsigned> *tensor; /**< Entry in m_qubit2tensor, or nullptr. */
+    std::pair<unsigned, unsigned> *tensor_dag; /**< Entry in m_qubit2tensor_dag, or nullptr. */
+  };
+
+  /** Registered gates, indexed by handle. */
+  std::vector<GateEntry> m_gates;
+
+  /** Map from gate name to its handle. */
+  std::unordered_map<std::string, unsigned> m_gate2handle;
+
+  /** Qubits with a handle, indexed by handle. */
+  std::vector<QubitEntry> m_handle2qubit;
+
+  /** Map from qubit name to its handle. */
+  std::unordered_map<std::string, unsigned> m_qubit2handle;
+
+  /** Handles freed by traced out qubits, for new qubits to reuse. */
+  std::vector<unsigned> m_free_handles;
+
+  /** Buffers reused by every gate, so that applying one allocates nothing of its own. */
+  std::vector<unsigned> m_scratch_handles;
+  std::vector<std::pair<unsigned, unsigned>> m_scratch_pairing;
+  std::vector<std::pair<unsigned, unsigned>> m_scratch_pairing_dag;
+  std::vector<exatn::LegDirection> m_scratch_leg_dir;
+  std::vector<exatn::LegDirection> m_scratch_leg_dir_dag;
+  std::vector<std::complex<double>> m_scratch_diag;
+
 
 /* util */
   
-  /** Count of ExaTN tensor names allocated automatically. */
-  unsigned m_exatn_name_count;
-
   /** All created ExaTN tensors. */
-  std::vector<std::string> m_exatn_tensors = {};
+  std::unordered_set<std::string> m_exatn_tensors = {};
+
+  /** Whether this simulator holds a reference to the ExaTN runtime. */
+  bool m_exatn_user;
+
+  /** Element type of the created ExaTN tensors. */
+  exatn::TensorElementType m_element_type;
 
 public:
   QuantumNetworkSimulator (const std::vector<std::string> &owners);
@@ -108,6 +269,23 @@ public:
   void PrepareTensor (const std::string &name, const std::vector<unsigned> &extents,
                       const std::vector<std::complex<double>> &data);
 
+  /**
+   * \brief Select the precision of the ExaTN tensors.
+   * 
+   * Tensors are created, uploaded and read back in this precision,
+   * while probabilities and fidelities are still accumulated in double on the host.
+   * 
+   * \param precision Either "double" (COMPLEX64) or "single" (COMPLEX32),
+   * selected before any qubit is generated.
+  */
+  void SetPrecision (const std::string &precision);
+
+  /**
+   * \brief Get the precision of the ExaTN tensors.
+   * \return Either "double" or "single".
+  */
+  std::string GetPrecision () const;
+
 
 
 /* circuit */
@@ -157,6 +335,42 @@ public:
                   const std::vector<std::complex<double>> &data, const std::vector<std::string> &qubits
   );
 
+  /**
+   * \brief Register a gate, so that it is applied by its handle without any lookup by name.
+   * \param gate Name of the gate.
+   * \param data Data of the gate, ignored if the gate is a reserved one or already registered.
+   * \return Handle of the gate.
+  */
+  unsigned RegisterGate (const std::string &gate, const std::vector<std::complex<double>> &data);
+
+  const std::string &GetGateName (const unsigned &gate) const;
+  const std::vector<std::complex<double>> &GetGateData (const unsigned &gate) const;
+
+  /**
+   * \brief Get the handle of a qubit, registering its name if new.
+   * \param qubit Name of the qubit.
+   * \return Handle of the qubit, valid until the qubit is traced out, when it is freed
+   * for another qubit to reuse.
+  */
+  unsigned GetQubitHandle (const std::string &qubit);
+
+  const std::string &GetQubitName (const unsigned &qubit) const;
+
+  /**
+   * \brief Apply a registered gate to n qubits given by their handles.
+   *
+   * ApplyGate goes through here as well. Apart from the tensor appended by ExaTN,
+   * a gate allocates nothing once the buffers have grown to its size,
+   * except on the "mps" backend and when flushing a fused diagonal.
+   *
+   * \param owner Owner applying the gate.
+   * \param gate Handle of the gate.
+   * \param qubits Handles of the qubits to be applied on.
+   * \return True if the gate is applied successfully.
+  */
+  bool ApplyRegisteredGate (const std::string &owner, const unsigned &gate,
+                            QuantumSpan<unsigned> qubits);
+
   /**
    * \brief Apply an operation to n qubits.
    * \param owner Owner applying the operation.
@@ -198,11 +412,106 @@ public:
    * \brief Measure n qubits.
    * \param owner Owner measuring the qubits. 
    * \param qubits Names of the qubits to be measured.
-   * \return Measurement outcome and the probability distribution.
+   * \return Measurement outcome and the probability distribution,
+   * where bit i of an outcome is on the i-th qubit.
   */ 
   std::pair<unsigned, std::vector<double>>
   Measure (const std::string &owner, const std::vector<std::string> &qubits);
 
+  /**
+   * \brief Measure a batch of independent requests issued at the same time.
+   * 
+   * The requests are sampled jointly from one contraction,
+   * which is equivalent to measuring them one after another.
+   * 
+   * \param requests Owner and names of the qubits of each request.
+   * \return Measurement outcome and the marginal probability distribution of each request.
+   * 
+   * \note The requests must not share any qubit.
+  */
+  std::vector<std::pair<unsigned, std::vector<double>>>
+  MeasureBatch (const std::vector<std::pair<std::string, std::vector<std::string>>> &requests);
+
+  /**
+   * \brief Force the outcome of the next measurement instead of sampling it, to replay a trace.
+   * \param outcome Outcome of the next call to Measure or MeasureBatch, which must be possible.
+  */
+  void ForceOutcome (const unsigned &outcome);
+
+  /**
+   * \brief Pick the outcome of a measurement, unless it is forced.
+   * \param prob_dist Outcome distribution.
+   * \return The outcome.
+  */
+  unsigned NextOutcome (const std::vector<double> &prob_dist);
+
+  /**
+   * \brief Calculate the outcome distribution of measuring n qubits.
+   * \param qubits Names of the qubits to be measured.
+   * \return Probability of each outcome, bit i of which is on the i-th qubit.
+  */
+  std::vector<double> GetDistribution (const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Collapse n qubits onto a measurement outcome.
+   * 
+   * Each component of the tensor network holding some of the qubits is renormalized
+   * by the marginal probability of its part of the outcome, so that it still traces to 1.
+   * 
+   * \param qubits Names of the measured qubits.
+   * \param outcome Measurement outcome, bit i of which is on the i-th qubit.
+   * \param prob_dist Probability of each outcome, as returned by GetDistribution.
+  */
+  void Collapse (const std::vector<std::string> &qubits, const unsigned &outcome,
+                 const std::vector<double> &prob_dist);
+
+  /**
+   * \brief Measure n qubits into classical registers without sampling.
+   * 
+   * Each qubit is fully dephased in the computational basis, so that its wire
+   * records the outcome distribution and later gates can be classically controlled by it.
+   * 
+   * \param owner Owner measuring the qubits.
+   * \param qubits Names of the qubits to be measured.
+   * \param cregs Names of the classical registers, one for each qubit.
+   * \return True if the qubits are measured successfully.
+   * 
+   * \note Tracing out the qubit of a register discards the register as well.
+  */
+  bool MeasureToRegister (const std::string &owner, const std::vector<std::string> &qubits,
+                          const std::vector<std::string> &cregs);
+
+  /**
+   * \brief Apply a gate to n qubits if all the classical registers hold 1.
+   * 
+   * The branches are not sampled but integrated, by applying the block-controlled gate
+   * to the target qubits and the qubits of the registers.
+   * 
+   * \param owner Owner applying the gate.
+   * \param gate Name of the gate.
+   * \param data Data of the gate.
+   * \param cregs Names of the classical registers.
+   * \param target_qubits Names of the target qubits.
+   * \return True if the gate is applied successfully.
+  */
+  bool ApplyClassicallyControlledGate (const std::string &owner, const std::string &gate,
+                                       const std::vector<std::complex<double>> &data,
+                                       const std::vector<std::string> &cregs,
+                                       const std::vector<std::string> &target_qubits);
+
+  /**
+   * \brief Peek the branches of n classical registers on some qubits from one contraction.
+   * \param owner Owner peeking the branches.
+   * \param cregs Names of the classical registers.
+   * \param qubits Names of the qubits to be peeked.
+   * \param probs Vector to store the probability of each branch,
+   * where bit i of a branch is on the i-th register.
+   * \param states Vector to store the density matrix of the qubits in each branch.
+  */
+  void PeekBranches (const std::string &owner, const std::vector<std::string> &cregs,
+                     const std::vector<std::string> &qubits, std::vector<double> &probs,
+                     std::vector<std::vector<std::complex<double>>> &states);
+
   /**
    * \brief Peek n qubits.
    * \param owner Owner peeking the qubits.
@@ -216,6 +525,47 @@ public:
           std::vector<std::complex<double>> &dm
   );
 
+  /**
+   * \brief Calculate the reduced density matrix of n qubits.
+   * \param qubits Names of the qubits.
+   * \return The composite density matrix of the qubits, in the same layout as PeekDM.
+  */
+  std::vector<std::complex<double>> ReducedDM (const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Submit the evaluation of the reduced density matrix of n qubits without waiting for it.
+   * \param qubits Names of the qubits.
+   * \return Ticket to collect the reduced density matrix with.
+  */
+  unsigned SubmitReducedDM (const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Collect a reduced density matrix, waiting for its evaluation if still running.
+   * \param ticket Ticket returned by SubmitReducedDM.
+   * \return The composite density matrix of the qubits, in the same layout as PeekDM.
+  */
+  std::vector<std::complex<double>> CollectReducedDM (const unsigned &ticket);
+
+  /**
+   * \brief Check without blocking if a submitted evaluation has completed.
+   * \param ticket Ticket of the evaluation.
+   * \return True if collecting it would not wait.
+  */
+  bool IsReady (const unsigned &ticket);
+
+  /**
+   * \brief Sample measurement outcomes of n qubits without collapsing them.
+   * \param owner Owner sampling the qubits.
+   * \param qubits Names of the qubits to be measured.
+   * \param shots Number of samples to draw.
+   * \param keep_qubits Names of the unmeasured qubits whose post-measurement states are wanted.
+   * \param states Vector to store the post-measurement state of the kept qubits for each outcome.
+   * \return Histogram of the outcomes, where bit i of an outcome is on the i-th qubit.
+  */
+  std::vector<unsigned> Sample (const std::string &owner, const std::vector<std::string> &qubits,
+                                const unsigned &shots, const std::vector<std::string> &keep_qubits,
+                                std::vector<std::vector<std::complex<double>>> &states);
+
   /**
    * \brief Trace out n qubits by simply connecting the two ends of their wires.
    * \param qubits Names of the qubits to be traced out.
@@ -228,11 +578,125 @@ public:
    * \brief Contract the tensor network to a single tensor.
    * \return The density matrix of the tensor.
   */
-  std::vector<std::complex<double>> Contract (const std::string &optimizer = "greed");
+  std::vector<std::complex<double>> Contract (const std::string &optimizer = "");
+
+  /**
+   * \brief Submit the contraction of a copy of the tensor network without waiting for it.
+   * \return Ticket to collect the density matrix with.
+  */
+  unsigned SubmitContract (const std::string &optimizer = "");
 
+  /**
+   * \brief Collect a contraction, waiting for its evaluation if still running.
+   * 
+   * The tensor network is replaced by the contracted tensor only if it has not changed
+   * since the submission, otherwise it is kept as is.
+   * 
+   * \param ticket Ticket returned by SubmitContract.
+   * \return The density matrix at the submission.
+  */
+  std::vector<std::complex<double>> CollectContract (const unsigned &ticket);
+
+  /**
+   * \brief Select the backend holding the density matrix.
+   * 
+   * The "exatn" backend keeps the full tensor network and contracts it exactly.
+   * The "mps" backend keeps a matrix product state on the host, truncated as configured
+   * by the attributes of QuantumMPS, and suits the states of linear protocols.
+   * 
+   * \param backend Either "exatn" or "mps", selected before any qubit is generated.
+  */
+  void SetBackend (const std::string &backend);
+
+  /**
+   * \brief Get the truncation error incurred by the backend so far.
+   * \return The truncation error, which is 0 on the exact "exatn" backend.
+  */
+  double GetTruncationError () const;
+
+  /**
+   * \brief Get the statistics of the tensor network evaluations so far.
+   * \return The statistics, which stay zero on the "mps" backend.
+  */
+  QuantumEvalStats GetEvalStats () const;
+
+  /**
+   * \brief Compact the tensor network without changing the state of the valid qubits.
+   * 
+   * Components without valid qubits are dropped, as each of them traces to 1,
+   * unless an operation failed to preserve the trace, in which case they are kept.
+   * Components with at most max_qubits valid qubits are contracted to their density matrix.
+   * The other components are kept, and all the tensors are renumbered contiguously
+   * in the order they were appended, so that the subcircuits of the distill optimizer
+   * keep their ranges, unless one of them is left with fewer than two tensors.
+   * 
+   * \param max_qubits Maximum number of valid qubits in a component to contract.
+  */
+  void Compact (const unsigned &max_qubits);
+
+  /**
+   * \brief Write the state of the simulator to a checkpoint.
+   * 
+   * The checkpoint holds the structure of the tensor network, the data of every tensor
+   * it references, each aligned to QNS_CHECKPOINT_ALIGN bytes so that large tensors can be
+   * memory-mapped, and the qubit maps. Cached and pending evaluations are left out.
+   * 
+   * \param out Binary output stream.
+  */
+  void Save (std::ostream &out) const;
+
+  /**
+   * \brief Restore the state of the simulator from a checkpoint, before any qubit is generated.
+   * 
+   * Tensors allocated by a simulator are restored under new names,
+   * while gates keep their names and are shared with the other simulators.
+   * 
+   * \param in Binary input stream.
+   * \return False if the checkpoint is truncated or corrupt, leaving the simulator unusable.
+  */
+  bool Load (std::istream &in);
+
+  /**
+   * \brief Calculate the fidelity of an EPR pair to the bell state.
+   * \param epr Names of the two qubits.
+   * \param fidel Variable to store the fidelity.
+   * \return The fidelity.
+  */
   double CalculateFidelity (const std::pair<std::string, std::string> &epr, double &fidel);
 
-  void Evaluate (exatn::TensorNetwork *circuit, const std::string &optimizer = "greed");
+  /**
+   * \brief Evaluate a batch of metrics from as few contractions as possible.
+   * 
+   * Requests on the same connected component of the tensor network share
+   * the reduced density matrix of the union of their qubits,
+   * as long as the union has at most QNS_BATCH_MAX_QUBITS qubits.
+   * Each contraction only covers the light cone of its group, and all of them are submitted
+   * before any is collected, so that requests on separate components, such as many EPR pairs,
+   * cost about one pass over the tensor network in total.
+   * 
+   * \note A component queried on more qubits still takes one contraction per group,
+   * since the environment shared by all of them would be their joint reduced density matrix,
+   * of 4^n entries for n qubits.
+   * 
+   * \param requests Metrics to evaluate.
+   * \return Value of each metric.
+  */
+  std::vector<double> EvaluateMetrics (const std::vector<QuantumMetric> &requests);
+
+  /**
+   * \brief Evaluate a tensor network.
+   * \param circuit Tensor network, or nullptr for m_dm.
+   * \param optimizer Contraction sequence optimizer, or "" for the default one.
+   * \param async Whether to return right after the submission, leaving the caller to sync.
+  */
+  void Evaluate (exatn::TensorNetwork *circuit, const std::string &optimizer = "",
+                 const bool &async = false);
+
+  /**
+   * \brief Add the cost of an evaluation to the statistics.
+   * \param seconds Time spent evaluating, submitting or waiting.
+  */
+  void AddEvalCost (const double &seconds);
 
 /* util */
 
@@ -254,6 +718,133 @@ public:
   */
   std::string AllocExatnName ();
 
+  /**
+   * \brief Get the ExaTN name of a tensor in the selected precision,
+   * so that the simulators in different precisions never share a gate by its name.
+   * \param name Name of the tensor.
+   * \return The name suffixed by QNS_SINGLE_SUFFIX in single precision,
+   * unless allocated by AllocExatnName or already suffixed.
+  */
+  std::string ExatnName (const std::string &name) const;
+
+  /**
+   * \brief Get an ExaTN tensor in the selected precision.
+   * \param name Name of the tensor.
+   * \return The ExaTN tensor.
+  */
+  std::shared_ptr<exatn::Tensor> GetTensor (const std::string &name) const;
+
+  /**
+   * \brief Create an ExaTN tensor in the selected precision and upload its data.
+   * \param name Name of the tensor.
+   * \param extents Extents of the tensor.
+   * \param data Data of the tensor, narrowed if in single precision.
+  */
+  void CreateTensor (const std::string &name, const std::vector<size_t> &extents,
+                     const std::vector<std::complex<double>> &data);
+
+  /**
+   * \brief Read back the local data of an ExaTN tensor, widened to double.
+   * \param name Name of the tensor.
+   * \return Data of the tensor.
+  */
+  std::vector<std::complex<double>> ReadTensor (const std::string &name) const;
+
+  /**
+   * \brief Get the threshold to check if a value read back is zero.
+   * \return EPS in double precision, or the looser EPS_SINGLE in single precision.
+  */
+  double GetReadbackEps () const;
+
+
+  /**
+   * \brief Mark a generated qubit as valid.
+   * \param qubit Name of the qubit, which may be the reused name of a traced out qubit.
+  */
+  void AddValid (const std::string &qubit);
+
+  /**
+   * \brief Get a qubit with a handle, resolving its tensor entries if not yet.
+   * \param qubit Handle of a valid qubit.
+  */
+  QubitEntry &ResolveQubit (const unsigned &qubit);
+
+  /**
+   * \brief Bump the versions of n qubits, as an operation touches them.
+   * \param qubits Names of the qubits.
+   * 
+   * \note An operation on other qubits leaves their reduced density matrix unchanged,
+   * unless it is a collapse.
+  */
+  void Touch (const std::vector<std::string> &qubits);
+  void Touch (const std::string &qubit);
+
+  /**
+   * \brief Get the versions of n qubits, keying the cached reduced density matrices.
+   * \param qubits Names of the qubits.
+   * \return The collapse epoch followed by the version of each qubit.
+  */
+  std::vector<unsigned> GetVersions (const std::vector<std::string> &qubits) const;
+
+
+  /**
+   * \brief Find the connected components of the tensor network.
+   * \return Map from each tensor id to the smallest tensor id in its component.
+   * 
+   * \note The ket and bra halves of a valid qubit belong to the same component.
+  */
+  std::map<unsigned, unsigned> FindComponents () const;
+
+  /**
+   * \brief Extract the light cone of n qubits, which is their components of the tensor network.
+   * 
+   * The tensors keep their ids and share their data with m_dm,
+   * and the other components are left out since each of them traces to 1.
+   * 
+   * \param qubits Names of the qubits.
+   * \param qubits_cone Vector to store the names of the valid qubits in the light cone.
+   * \return The tensor network of the light cone, to be closed and evaluated by a query.
+  */
+  exatn::TensorNetwork ExtractLightCone (const std::vector<std::string> &qubits,
+                                         std::vector<std::string> &qubits_cone) const;
+
+
+/* diagonal */
+
+  /**
+   * \brief Fuse a diagonal superoperator into the pending one of a qubit.
+   * \param qubit Name of the qubit.
+   * \param diag Diagonal superoperator d, scaling rho_{..i.., ..j..} by d[(i << 1) | j].
+  */
+  void AccumulateDiagonal (const std::string &qubit,
+                           const std::vector<std::complex<double>> &diag);
+
+  /**
+   * \brief Append the pending diagonal superoperators of n qubits to the tensor network,
+   * each as a single tensor bridging the "ket" half and the "bra" half.
+   * \param qubits Names of the qubits to be flushed.
+  */
+  void FlushDiagonal (const std::vector<std::string> &qubits);
+  void FlushDiagonal (const std::string &qubit);
+
+  /**
+   * \brief Create and initialize an ExaTN tensor connecting the two ends of a qubit's wires
+   * to a third open leg, with the pending diagonal superoperator of the qubit absorbed.
+   * \param qubit Name of the qubit.
+   * \return Name of the tensor.
+  */
+  std::string PrepareCopy (const std::string &qubit);
+
+  /**
+   * \brief Create and initialize an ExaTN tensor connecting the two ends of a qubit's wires,
+   * with the pending diagonal superoperator of the qubit absorbed.
+   * \param qubit Name of the qubit.
+   * \param proj Diagonal projector to be applied before tracing.
+   * \return Name of the tensor.
+  */
+  std::string PrepareTrace (const std::string &qubit,
+                            const std::vector<std::complex<double>> &proj = pauli_I);
+
 
 /* debug */
 
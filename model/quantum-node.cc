@@ -39,6 +39,7 @@ QuantumNode::QuantumNode ()
 void
 QuantumNode::DoDispose (void)
 {
+  m_qphyent = nullptr;
   Node::DoDispose ();
 }
 
@@ -96,15 +97,24 @@ void
 QuantumNode::AddQubit (const std::string &name)
 {
   NS_LOG_INFO (YELLOW_CODE << "Adding qubit " << name << " to " << m_owner << " with local idx "
-                           << m_qmemory.GetSize () << END_CODE);
-  m_qmemory.AddQubit (name.c_str ());
+                           << m_qmemory.GetFreeSlot () << END_CODE);
+  bool entering = !m_qmemory.ContainQubit (name);
+  m_qmemory.AddQubit (name);
+  if (m_qphyent && entering)
+    {
+      m_qphyent->ArmCutoff (m_owner, name);
+    }
 }
 
 bool
 QuantumNode::RemoveQubit (const std::string &name)
 {
   NS_LOG_INFO (RED_CODE << "Removing qubit " << name << " from " << m_owner << END_CODE);
-  return m_qmemory.RemoveQubit (name.c_str ());
+  if (m_qphyent)
+    {
+      m_qphyent->DisarmCutoff (name);
+    }
+  return m_qmemory.RemoveQubit (name);
 }
 
 std::string
@@ -113,10 +123,65 @@ QuantumNode::GetQubit (unsigned local) const
   return m_qmemory.GetQubit (local);
 }
 
+std::vector<std::string>
+QuantumNode::GetQubits () const
+{
+  std::vector<std::string> qubits = {};
+  for (unsigned local = 0; local < m_qmemory.GetSize (); ++local)
+    {
+      if (!m_qmemory.GetQubit (local).empty ())
+        {
+          qubits.push_back (m_qmemory.GetQubit (local));
+        }
+    }
+  return qubits;
+}
+
+std::vector<std::string>
+QuantumNode::GetQubitSlots () const
+{
+  std::vector<std::string> slots = {};
+  for (unsigned local = 0; local < m_qmemory.GetSize (); ++local)
+    {
+      slots.push_back (m_qmemory.GetQubit (local));
+    }
+  return slots;
+}
+
+void
+QuantumNode::SetQubitSlots (const std::vector<std::string> &slots)
+{
+  m_qmemory.SetQubits (slots);
+}
+
+std::string
+QuantumNode::GetFreeQubit () const
+{
+  return m_owner + "_Slot" + std::to_string (m_qmemory.GetFreeSlot ());
+}
+
+void
+QuantumNode::SetMemoryCapacity (unsigned capacity)
+{
+  m_qmemory.SetCapacity (capacity);
+}
+
+unsigned
+QuantumNode::GetMemoryCapacity () const
+{
+  return m_qmemory.GetCapacity ();
+}
+
+bool
+QuantumNode::IsMemoryFull () const
+{
+  return m_qmemory.IsFull ();
+}
+
 bool
 QuantumNode::OwnQubit (const std::string &name) const
 {
-  return m_qmemory.ContainQubit (name.c_str ());
+  return m_qmemory.ContainQubit (name);
 }
 
 void
@@ -139,6 +204,12 @@ QuantumNode::SetTimeModel (double rate) // dephasing rate of the time model
   m_qphyent->SetTimeModel (m_owner, rate);
 }
 
+void
+QuantumNode::SetCutoff (const Time &cutoff, Callback<void, std::string> callback)
+{
+  m_qphyent->SetCutoff (m_owner, cutoff, callback);
+}
+
 const std::string &
 QuantumNode::GetOwner () const
 {
@@ -2,6 +2,8 @@
 #define QUANTUM_NODE_H
 
 #include "ns3/node.h" // class Node
+#include "ns3/nstime.h" // class Time
+#include "ns3/callback.h" // class Callback
 
 #include "ns3/quantum-memory.h" // class QuantumMemory
 
@@ -77,10 +79,51 @@ public:
   /**
    * \brief Get the qubit at a specific position.
    * \param local The position in the quantum memory to query.
-   * \return Name of the qubit at the position.
+   * \return Name of the qubit at the position, or empty if the slot is free.
   */
   std::string GetQubit (unsigned local) const;
 
+  /**
+   * \brief Get all the qubits in the node's quantum memory.
+   * \return Names of the qubits, in their local order.
+  */
+  std::vector<std::string> GetQubits () const;
+
+  /**
+   * \brief Get the slots of the node's quantum memory.
+   * \return Name of the qubit in each slot, or empty if the slot is free.
+  */
+  std::vector<std::string> GetQubitSlots () const;
+
+  /**
+   * \brief Replace the slots of the node's quantum memory, as by a fork or a checkpoint.
+   * \param slots Name of the qubit in each slot, or empty if the slot is free.
+  */
+  void SetQubitSlots (const std::vector<std::string> &slots);
+
+  /**
+   * \brief Get a name for a new qubit, after the slot it is going to take.
+   * \return Name of the form owner_SlotN, reused once the qubit in slot N is freed.
+   *
+   * \note Generating qubits under these names keeps the simulator's maps
+   * bounded by the capacity of the quantum memories.
+  */
+  std::string GetFreeQubit () const;
+
+  /**
+   * \brief Bound the number of qubits in the node's quantum memory.
+   * \param capacity Maximum number of slots, or 0 if unbounded.
+  */
+  void SetMemoryCapacity (unsigned capacity);
+
+  unsigned GetMemoryCapacity () const;
+
+  /**
+   * \brief Check if the node's quantum memory has no free slot left.
+   * \return True if no qubit can be added.
+  */
+  bool IsMemoryFull () const;
+
   /**
    * \brief Check if a qubit is in the node's quantum memory.
    * \param name Name of the qubit to be checked.
@@ -111,6 +154,14 @@ public:
   */
   void SetTimeModel (double rate);
 
+  /**
+   * \brief Discard the qubits staying in the node's quantum memory for longer than a cutoff.
+   * \param cutoff Longest time a qubit may stay, or zero to keep the qubits forever.
+   * \param callback Callback notified with the name of each discarded qubit, or a null callback.
+  */
+  void SetCutoff (const Time &cutoff,
+                  Callback<void, std::string> callback = MakeNullCallback<void, std::string> ());
+
   const std::string &GetOwner () const;
 
   bool operator<(const QuantumNode &another) const;
@@ -11,6 +11,24 @@ QuantumOperation::QuantumOperation (const std::vector<std::string> &name_,
       m_opr.push_back (sqrt (prob_[i]) * opr_[i]);
     }
 }
+
+QuantumOperation::QuantumOperation (const std::vector<std::vector<std::complex<double>>> &kraus_)
+    : m_name ({}), m_opr (kraus_), m_prob ({}), m_size (kraus_.size ())
+{
+  assert (m_size > 0);
+  unsigned dim = std::sqrt (kraus_[0].size ());
+  for (unsigned i = 0; i < m_size; ++i)
+    {
+      assert (kraus_[i].size () == dim * dim);
+      double weight = 0.;
+      for (const std::complex<double> &val : kraus_[i])
+        {
+          weight += std::norm (val);
+        }
+      m_name.push_back ("K" + std::to_string (i));
+      m_prob.push_back (weight / dim);
+    }
+}
 const std::string &
 QuantumOperation::getName (unsigned idx) const
 {
@@ -39,4 +57,300 @@ QuantumOperation::getSize () const
 {
   return m_size;
 }
+
+unsigned
+QuantumOperation::getDim () const
+{
+  return std::sqrt (m_opr[0].size ());
+}
+
+/** Pauli string of n qubits named by a Pauli channel, or empty if the name is no Pauli string. */
+static std::string
+PauliOfName (const std::string &name, const unsigned &num_qubits)
+{
+  if (name == "I")
+    {
+      return std::string (num_qubits, 'I');
+    }
+  if (name.size () != num_qubits + 1 || name[0] != 'P' ||
+      name.find_first_not_of ("IXYZ", 1) != std::string::npos)
+    {
+      return "";
+    }
+  return name.substr (1);
+}
+
+/** Name of a Pauli string in a Pauli channel, "I" alone keeping the name of the identity. */
+static std::string
+NameOfPauli (const std::string &pauli)
+{
+  return pauli == "I" ? "I" : "P" + pauli;
+}
+
+/** Product of two row-major matrices of dimension dim. */
+static std::vector<std::complex<double>>
+MatMul (const std::vector<std::complex<double>> &a, const std::vector<std::complex<double>> &b,
+        const unsigned &dim)
+{
+  std::vector<std::complex<double>> c (dim * dim, 0.0);
+  for (unsigned r = 0; r < dim; ++r)
+    {
+      for (unsigned k = 0; k < dim; ++k)
+        {
+          if (a[r * dim + k] == 0.0)
+            {
+              continue;
+            }
+          for (unsigned col = 0; col < dim; ++col)
+            {
+              c[r * dim + col] += a[r * dim + k] * b[k * dim + col];
+            }
+        }
+    }
+  return c;
+}
+
+/** Kraus operators of the positive eigenvalues of a Choi matrix. */
+static std::vector<std::vector<std::complex<double>>>
+KrausOfChoi (const std::vector<std::complex<double>> &choi)
+{
+  std::vector<double> evals = {};
+  std::vector<std::complex<double>> evecs = {};
+  EigenHermitian (choi, evals, evecs);
+
+  unsigned dim2 = evals.size ();
+  unsigned dim = std::sqrt (dim2);
+  assert (dim * dim == dim2);
+  std::vector<std::vector<std::complex<double>>> kraus = {};
+  for (unsigned k = 0; k < dim2; ++k)
+    {
+      if (evals[k] <= EPS * EPS * dim)
+        {
+          continue; // a rounding error of a zero eigenvalue
+        }
+      // |K>> = sum_i |i> (x) K |i>, so entry i * dim + r of the eigenvector is K[r][i]
+      std::vector<std::complex<double>> op (dim2, 0.0);
+      double amp = std::sqrt (evals[k]);
+      for (unsigned i = 0; i < dim; ++i)
+        {
+          for (unsigned r = 0; r < dim; ++r)
+            {
+              op[r * dim + i] = amp * evecs[(i * dim + r) * dim2 + k];
+            }
+        }
+      kraus.push_back (op);
+    }
+  return kraus;
+}
+
+bool
+QuantumOperation::isPauli () const
+{
+  unsigned num_qubits = Log2 (getDim ());
+  for (unsigned i = 0; i < m_size; ++i)
+    {
+      std::string pauli = PauliOfName (m_name[i], num_qubits);
+      if (pauli.empty () ||
+          !(m_opr[i] == std::sqrt (m_prob[i]) * GetPauliString (pauli)))
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+bool
+QuantumOperation::isIdentity () const
+{
+  return m_size == 1 && m_opr[0] == GetPauliString (std::string (Log2 (getDim ()), 'I'));
+}
+
+std::vector<std::complex<double>>
+QuantumOperation::getChoi () const
+{
+  unsigned dim = getDim ();
+  unsigned dim2 = dim * dim;
+  std::vector<std::complex<double>> choi (dim2 * dim2, 0.0);
+  std::vector<std::complex<double>> vec (dim2, 0.0);
+  for (const std::vector<std::complex<double>> &op : m_opr)
+    {
+      for (unsigned i = 0; i < dim; ++i)
+        {
+          for (unsigned r = 0; r < dim; ++r)
+            {
+              vec[i * dim + r] = op[r * dim + i];
+            }
+        }
+      for (unsigned a = 0; a < dim2; ++a)
+        {
+          for (unsigned b = 0; b < dim2; ++b)
+            {
+              choi[a * dim2 + b] += vec[a] * std::conj (vec[b]);
+            }
+        }
+    }
+  return choi;
+}
+
+QuantumOperation
+AmplitudeDamping (const double &gamma)
+{
+  assert (0. <= gamma && gamma <= 1.);
+  std::vector<std::vector<std::complex<double>>> kraus = {
+      {1.0, 0.0, 0.0, std::sqrt (1. - gamma)}};
+  if (gamma > 0.)
+    {
+      kraus.push_back ({0.0, std::sqrt (gamma), 0.0, 0.0});
+    }
+  return QuantumOperation (kraus);
+}
+
+QuantumOperation
+GeneralizedAmplitudeDamping (const double &gamma, const double &prob)
+{
+  assert (0. <= gamma && gamma <= 1.);
+  assert (0. <= prob && prob <= 1.);
+  double damp = std::sqrt (1. - gamma), jump = std::sqrt (gamma);
+  double down = std::sqrt (prob), up = std::sqrt (1. - prob);
+  std::vector<std::vector<std::complex<double>>> kraus = {};
+  if (prob > 0.)
+    {
+      kraus.push_back ({down, 0.0, 0.0, down * damp});
+      if (gamma > 0.)
+        kraus.push_back ({0.0, down * jump, 0.0, 0.0});
+    }
+  if (prob < 1.)
+    {
+      kraus.push_back ({up * damp, 0.0, 0.0, up});
+      if (gamma > 0.)
+        kraus.push_back ({0.0, 0.0, up * jump, 0.0});
+    }
+  return QuantumOperation (kraus);
+}
+
+QuantumOperation
+PauliChannel (const double &px, const double &py, const double &pz)
+{
+  assert (px >= 0. && py >= 0. && pz >= 0. && px + py + pz <= 1. + EPS);
+  std::vector<std::string> names = {"I"};
+  std::vector<std::vector<std::complex<double>>> oprs = {pauli_I};
+  std::vector<double> probs = {std::max (1. - px - py - pz, 0.)};
+  const std::vector<std::pair<std::string, double>> errors = {{"X", px}, {"Y", py}, {"Z", pz}};
+  for (const auto &[pauli, prob] : errors)
+    {
+      if (prob > 0.)
+        {
+          names.push_back (NameOfPauli (pauli));
+          oprs.push_back (GetPauliString (pauli));
+          probs.push_back (prob);
+        }
+    }
+  return QuantumOperation (names, oprs, probs);
+}
+
+QuantumOperation
+TwoQubitDepolarizing (const double &prob)
+{
+  assert (0. <= prob && prob <= 1.);
+  const std::string paulis = "IXYZ";
+  std::vector<std::string> names = {};
+  std::vector<std::vector<std::complex<double>>> oprs = {};
+  std::vector<double> probs = {};
+  for (const char &first : paulis)
+    {
+      for (const char &second : paulis)
+        {
+          std::string pauli = {first, second};
+          double p = pauli == "II" ? 1. - prob : prob / 15.;
+          if (p > 0.)
+            {
+              names.push_back (NameOfPauli (pauli));
+              oprs.push_back (GetPauliString (pauli));
+              probs.push_back (p);
+            }
+        }
+    }
+  return QuantumOperation (names, oprs, probs);
+}
+
+QuantumOperation
+FromKraus (const std::vector<std::vector<std::complex<double>>> &kraus)
+{
+  return ReduceKraus (QuantumOperation (kraus));
+}
+
+QuantumOperation
+FromChoi (const std::vector<std::complex<double>> &choi)
+{
+  return QuantumOperation (KrausOfChoi (choi));
+}
+
+QuantumOperation
+ReduceKraus (const QuantumOperation &opr)
+{
+  // distinct Pauli strings are orthogonal, so a Pauli channel is of minimal rank already
+  if (opr.getSize () <= 1 || opr.isPauli ())
+    {
+      return opr;
+    }
+  std::vector<std::vector<std::complex<double>>> kraus = KrausOfChoi (opr.getChoi ());
+  if (kraus.size () >= opr.getSize ())
+    {
+      return opr;
+    }
+  return QuantumOperation (kraus);
+}
+
+QuantumOperation
+Compose (const QuantumOperation &first, const QuantumOperation &second)
+{
+  unsigned dim = first.getDim ();
+  assert (dim == second.getDim ());
+
+  if (first.isPauli () && second.isPauli ())
+    {
+      // the product of two Pauli strings is a Pauli string up to a phase the channel drops
+      const std::string paulis = "IXYZ";
+      unsigned num_qubits = Log2 (dim);
+      std::map<std::string, double> pauli2prob = {};
+      for (unsigned i = 0; i < first.getSize (); ++i)
+        {
+          std::string a = PauliOfName (first.getName (i), num_qubits);
+          for (unsigned j = 0; j < second.getSize (); ++j)
+            {
+              std::string b = PauliOfName (second.getName (j), num_qubits);
+              std::string c (num_qubits, 'I');
+              for (unsigned q = 0; q < num_qubits; ++q)
+                {
+                  c[q] = paulis[paulis.find (a[q]) ^ paulis.find (b[q])];
+                }
+              pauli2prob[c] += first.getProb (i) * second.getProb (j);
+            }
+        }
+      std::vector<std::string> names = {};
+      std::vector<std::vector<std::complex<double>>> oprs = {};
+      std::vector<double> probs = {};
+      for (const auto &[pauli, prob] : pauli2prob)
+        {
+          if (prob > 0.)
+            {
+              names.push_back (NameOfPauli (pauli));
+              oprs.push_back (GetPauliString (pauli));
+              probs.push_back (prob);
+            }
+        }
+      return QuantumOperation (names, oprs, probs);
+    }
+
+  std::vector<std::vector<std::complex<double>>> kraus = {};
+  for (const std::vector<std::complex<double>> &b : second.getOprs ())
+    {
+      for (const std::vector<std::complex<double>> &a : first.getOprs ())
+        {
+          kraus.push_back (MatMul (b, a, dim));
+        }
+    }
+  return ReduceKraus (QuantumOperation (kraus));
+}
+
 } // namespace ns3
\ No newline at end of file
@@ -39,6 +39,15 @@ public:
                     const std::vector<std::vector<std::complex<double>>> &opr_,
                     const std::vector<double> &prob_);
 
+  /**
+   * \brief Construct a quantum operation from its Kraus operators.
+   * \param kraus_ Kraus operators, each the data of a row-major matrix,
+   * with sum_k K_k^dagger K_k = I.
+   *
+   * \note The probability of each Kraus operator is its average weight tr (K^dagger K) / d.
+  */
+  QuantumOperation (const std::vector<std::vector<std::complex<double>>> &kraus_);
+
   const std::string &getName (unsigned idx) const;
   
   const std::vector<std::complex<double>> &getOpr (unsigned idx) const;
@@ -48,8 +57,97 @@ public:
   const double &getProb (unsigned idx) const;
   
   const unsigned &getSize () const;
+
+  /**
+   * \brief Get the dimension of the space the operation acts on.
+   * \return 2^n for an operation on n qubits.
+  */
+  unsigned getDim () const;
+
+  /**
+   * \brief Check if every operator of the operation is a Pauli string.
+   * \return True if the operation is a Pauli channel built by PauliChannel or Compose.
+  */
+  bool isPauli () const;
+
+  /**
+   * \brief Check if the operation is the identity channel.
+   * \return True if its only operator is the identity.
+  */
+  bool isIdentity () const;
+
+  /**
+   * \brief Get the Choi matrix J = sum_k |K_k>><<K_k| of the operation,
+   * where |K>> = sum_i |i> (x) K |i>.
+   * \return Data of the row-major d^2 x d^2 matrix.
+  */
+  std::vector<std::complex<double>> getChoi () const;
 };
 
+/**
+ * \brief Amplitude damping channel, the energy relaxation of a qubit.
+ * \param gamma Probability of decaying from |1> to |0>.
+ * \return The operation of Kraus rank 2.
+*/
+QuantumOperation AmplitudeDamping (const double &gamma);
+
+/**
+ * \brief Generalized amplitude damping channel, the relaxation towards a thermal state.
+ * \param gamma Probability of relaxing.
+ * \param prob Population of |0> in the thermal state, where 1 recovers AmplitudeDamping.
+ * \return The operation of Kraus rank at most 4.
+*/
+QuantumOperation GeneralizedAmplitudeDamping (const double &gamma, const double &prob);
+
+/**
+ * \brief Pauli channel of a qubit.
+ * \param px Probability of an X error.
+ * \param py Probability of a Y error.
+ * \param pz Probability of a Z error.
+ * \return The operation, keeping only the Paulis of nonzero probability.
+*/
+QuantumOperation PauliChannel (const double &px, const double &py, const double &pz);
+
+/**
+ * \brief Depolarizing channel of two qubits.
+ * \param prob Probability of one of the 15 nontrivial Pauli strings, each equally likely.
+ * \return The operation of Kraus rank at most 16.
+*/
+QuantumOperation TwoQubitDepolarizing (const double &prob);
+
+/**
+ * \brief Build a quantum operation of minimal Kraus rank from arbitrary Kraus operators.
+ * \param kraus Kraus operators, each the data of a row-major matrix.
+ * \return The reduced operation.
+*/
+QuantumOperation FromKraus (const std::vector<std::vector<std::complex<double>>> &kraus);
+
+/**
+ * \brief Build a quantum operation of minimal Kraus rank from its Choi matrix.
+ * \param choi Data of the row-major Choi matrix, as returned by QuantumOperation::getChoi.
+ * \return The operation whose Kraus operators are the eigenvectors of positive eigenvalues.
+*/
+QuantumOperation FromChoi (const std::vector<std::complex<double>> &choi);
+
+/**
+ * \brief Reduce a quantum operation to its minimal Kraus rank by diagonalizing its Choi matrix.
+ * \param opr The operation.
+ * \return The operation itself if no smaller rank is possible, or the reduced one.
+*/
+QuantumOperation ReduceKraus (const QuantumOperation &opr);
+
+/**
+ * \brief Compose two consecutive quantum operations on the same qubits into one.
+ *
+ * Pauli channels compose in closed form by multiplying their Pauli strings,
+ * and other operations by multiplying their Kraus operators, reduced to the minimal rank.
+ *
+ * \param first The operation applied first.
+ * \param second The operation applied next.
+ * \return The composed operation of minimal Kraus rank.
+*/
+QuantumOperation Compose (const QuantumOperation &first, const QuantumOperation &second);
+
 /** Default depolarizing quantum operation. */
 const QuantumOperation depol = {{"I", "PX", "PY", "PZ"},
                                 {pauli_I, pauli_X, pauli_Y, pauli_Z},
@@ -10,20 +10,31 @@
 #include "ns3/quantum-node.h" // class QuantumNode
 #include "ns3/quantum-error-model.h" // class QuantumErrorModel
 
+#include <fstream>
+#include <tuple>
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("QuantumPhyEntity");
 
 QuantumPhyEntity::QuantumPhyEntity (const std::vector<std::string> &owners)
     : m_qnetsim (QuantumNetworkSimulator (owners)), // TODO: CreateObject, release
+      m_compact_tensors (0),
+      m_compact_interval (Seconds (0)),
+      m_compact_max_qubits (4),
+      m_last_compact (Seconds (0)),
+      m_compact_left (0),
+      m_trace_file (""),
+      m_trace (nullptr),
 
       m_conn2apps ({}),
 
       m_qubit2time (std::map<std::string, Time> ()),
+      m_node2model ({}),
       m_gate2model ({}),
+      m_qubit2pending ({}),
       m_conn2model ({}),
-      m_node2model ({})
-
+      m_conn2link ({})
 {
   /* util */
 
@@ -36,31 +47,152 @@ QuantumPhyEntity::QuantumPhyEntity (const std::vector<std::string> &owners)
     }
 }
 
+QuantumPhyEntity::QuantumPhyEntity (const QuantumPhyEntity &other)
+    : Object (other),
+      m_qnetsim (other.m_qnetsim),
+      m_compact_tensors (other.m_compact_tensors),
+      m_compact_interval (other.m_compact_interval),
+      m_compact_max_qubits (other.m_compact_max_qubits),
+      m_last_compact (other.m_last_compact),
+      m_compact_left (other.m_compact_left),
+      m_trace_file (""), // a fork does not record into the trace of its parent
+      m_trace (nullptr),
+
+      m_handle2owner (other.m_handle2owner),
+      m_owner2handle (other.m_owner2handle),
+      m_conn2apps ({}),
+
+      m_qubit2time (other.m_qubit2time),
+      m_qubit2model (other.m_qubit2model),
+      m_qubit2pending (other.m_qubit2pending),
+      m_conn2model (other.m_conn2model),
+      m_conn2link (other.m_conn2link),
+      m_qubit2cutoff ({})
+{
+  // QuantumNode, with the error models of the original one
+  for (const auto &[owner, other_pnode] : other.m_owner2pnode)
+    {
+      Ptr<QuantumNode> pnode = CreateObject<QuantumNode> (this, owner);
+      pnode->SetAddress (other_pnode->GetAddress ());
+      pnode->SetRank (other_pnode->GetRank ());
+      pnode->SetMemoryCapacity (other_pnode->GetMemoryCapacity ());
+      pnode->SetQubitSlots (other_pnode->GetQubitSlots ());
+      m_owner2pnode[owner] = pnode;
+      m_gate2model[pnode] = other.m_gate2model.count (other_pnode)
+                                ? other.m_gate2model.at (other_pnode)
+                                : std::map<std::string, Ptr<QuantumErrorModel>> ();
+      if (other.m_node2model.count (other_pnode))
+        {
+          m_node2model[pnode] = other.m_node2model.at (other_pnode);
+        }
+      if (other.m_node2cutoff.count (other_pnode))
+        { // the callback notifies the applications of the original, which the fork has none of
+          m_node2cutoff[pnode] = {other.m_node2cutoff.at (other_pnode).first,
+                                  Callback<void, std::string> ()};
+        }
+    }
+
+  // the cutoffs of the inherited qubits, with the time they have left
+  for (const auto &[qubit, event] : other.m_qubit2cutoff)
+    {
+      if (!Simulator::IsExpired (event))
+        {
+          RestoreCutoff (qubit, Simulator::GetDelayLeft (event));
+        }
+    }
+}
+
 QuantumPhyEntity::~QuantumPhyEntity ()
 {
 }
 
 QuantumPhyEntity::QuantumPhyEntity ()
     : m_qnetsim (QuantumNetworkSimulator ()),
+      m_compact_tensors (0),
+      m_compact_interval (Seconds (0)),
+      m_compact_max_qubits (4),
+      m_last_compact (Seconds (0)),
+      m_compact_left (0),
+      m_trace_file (""),
+      m_trace (nullptr),
       m_conn2apps ({}),
 
       m_qubit2time ({}),
+      m_node2model ({}),
       m_gate2model ({}),
+      m_qubit2pending ({}),
       m_conn2model ({}),
-      m_node2model ({})
+      m_conn2link ({}),
+      m_node2cutoff ({}),
+      m_qubit2cutoff ({})
 {
 }
 
 void
 QuantumPhyEntity::DoDispose (void)
 {
+  for (auto &[qubit, event] : m_qubit2cutoff)
+    {
+      event.Cancel ();
+    }
+  m_qubit2cutoff.clear ();
+
+  // the nodes hold this entity, and stay in the NodeList until Simulator::Destroy
+  for (auto &[owner, pnode] : m_owner2pnode)
+    {
+      pnode->Dispose ();
+    }
+  m_owner2pnode.clear ();
   Object::DoDispose ();
 }
 
 TypeId
 QuantumPhyEntity::GetTypeId (void)
 {
-  static TypeId tid = TypeId ("ns3::QuantumPhyEntity").SetParent<Object> ();
+  static TypeId tid =
+      TypeId ("ns3::QuantumPhyEntity")
+          .SetParent<Object> ()
+          .AddAttribute ("CompactTensors",
+                         "Number of tensors above which to compact the tensor network, or 0, "
+                         "and at least twice as many as the last compaction left",
+                         UintegerValue (0),
+                         MakeUintegerAccessor (&QuantumPhyEntity::m_compact_tensors),
+                         MakeUintegerChecker<unsigned> ())
+          .AddAttribute ("CompactInterval",
+                         "Simulated time between two compactions of the tensor network, or 0",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&QuantumPhyEntity::m_compact_interval),
+                         MakeTimeChecker ())
+          .AddAttribute ("CompactMaxQubits",
+                         "Maximum number of valid qubits in a component to contract",
+                         UintegerValue (4),
+                         MakeUintegerAccessor (&QuantumPhyEntity::m_compact_max_qubits),
+                         MakeUintegerChecker<unsigned> ())
+          .AddAttribute ("Optimizer", "Default contraction sequence optimizer",
+                         StringValue ("greed"),
+                         MakeStringAccessor (&QuantumPhyEntity::GetOptimizer,
+                                             &QuantumPhyEntity::SetOptimizer),
+                         MakeStringChecker ())
+          .AddAttribute ("Backend",
+                         "Backend holding the density matrix, \"exatn\" or \"mps\", "
+                         "configured by the attributes of ns3::QuantumMPS",
+                         StringValue ("exatn"),
+                         MakeStringAccessor (&QuantumPhyEntity::GetBackend,
+                                             &QuantumPhyEntity::SetBackend),
+                         MakeStringChecker ())
+          .AddAttribute ("Precision",
+                         "Precision of the ExaTN tensors, \"double\" (COMPLEX64) "
+                         "or \"single\" (COMPLEX32)",
+                         StringValue ("double"),
+                         MakeStringAccessor (&QuantumPhyEntity::GetPrecision,
+                                             &QuantumPhyEntity::SetPrecision),
+                         MakeStringChecker ())
+          .AddAttribute ("TraceFile",
+                         "Path of a binary trace recording every phy-level call, or \"\" to disable",
+                         StringValue (""),
+                         MakeStringAccessor (&QuantumPhyEntity::GetTraceFile,
+                                             &QuantumPhyEntity::SetTraceFile),
+                         MakeStringChecker ());
   return tid;
 }
 
@@ -79,7 +211,9 @@ QuantumPhyEntity::GenerateQubitsPure (
       return false;
     }
 
+  MaybeCompact ();
   bool succeed = m_qnetsim.GenerateQubitsPure (owner, data, qubits);
+  Record ({QuantumTraceRecord::GENERATE_PURE, owner, "", qubits, {}, {data}});
 
   Ptr<QuantumNode> pnode = m_owner2pnode[owner];
 
@@ -116,7 +250,9 @@ QuantumPhyEntity::GenerateQubitsMixed (
       return false;
     }
 
+  MaybeCompact ();
   bool succeed = m_qnetsim.GenerateQubitsMixed (owner, data, qubits);
+  Record ({QuantumTraceRecord::GENERATE_MIXED, owner, "", qubits, {}, {data}});
 
   Ptr<QuantumNode> pnode = m_owner2pnode[owner];
 
@@ -147,20 +283,68 @@ QuantumPhyEntity::ApplyGate (
     const std::vector<std::complex<double>> &data,
     const std::vector<std::string> &qubits
 )
+{
+  m_scratch_handles.clear ();
+  for (const std::string &qubit : qubits)
+    {
+      m_scratch_handles.push_back (GetQubitHandle (qubit));
+    }
+  return ApplyRegisteredGate (GetOwnerHandle (owner), RegisterGate (gate, data),
+                              m_scratch_handles);
+}
+
+unsigned
+QuantumPhyEntity::GetOwnerHandle (const std::string &owner)
+{
+  auto it = m_owner2handle.find (owner);
+  if (it != m_owner2handle.end ())
+    {
+      return it->second;
+    }
+  m_handle2owner.push_back (owner);
+  m_owner2handle[owner] = m_handle2owner.size () - 1;
+  return m_handle2owner.size () - 1;
+}
+
+unsigned
+QuantumPhyEntity::RegisterGate (const std::string &gate,
+                                const std::vector<std::complex<double>> &data)
+{
+  return m_qnetsim.RegisterGate (gate, data);
+}
+
+unsigned
+QuantumPhyEntity::GetQubitHandle (const std::string &qubit)
+{
+  return m_qnetsim.GetQubitHandle (qubit);
+}
+
+bool
+QuantumPhyEntity::ApplyRegisteredGate (const unsigned &owner, const unsigned &gate,
+                                       QuantumSpan<unsigned> qubits)
 {
   Time moment = Simulator::Now ();
-  assert (CheckOwned (owner, qubits));
+  const std::string &owner_name = m_handle2owner.at (owner);
 
-  for (const std::string &qubit : qubits)
+  // assigning into the buffer reuses the capacity of its strings
+  m_scratch_qubits.resize (qubits.size ());
+  for (unsigned i = 0; i < qubits.size (); ++i)
     {
-      NS_LOG_LOGIC ("Updating qubit " << qubit);
-      ApplyErrorModel ({qubit}, moment);
+      m_scratch_qubits[i] = m_qnetsim.GetQubitName (qubits[i]);
     }
+  assert (CheckOwned (owner_name, m_scratch_qubits));
 
-  bool succeed = m_qnetsim.ApplyGate (owner, gate, data, qubits);
+  ApplyErrorModel (m_scratch_qubits, moment);
 
-  if (owner != "God")
-    ApplyErrorModel (owner, gate, qubits, moment);
+  bool succeed = m_qnetsim.ApplyRegisteredGate (owner_name, gate, qubits);
+  if (m_trace)
+    {
+      Record ({QuantumTraceRecord::GATE, owner_name, m_qnetsim.GetGateName (gate),
+               m_scratch_qubits, {}, {m_qnetsim.GetGateData (gate)}});
+    }
+
+  if (owner_name != "God")
+    ApplyErrorModel (owner_name, m_qnetsim.GetGateName (gate), m_scratch_qubits, moment);
 
   return succeed;
 }
@@ -172,7 +356,9 @@ QuantumPhyEntity::ApplyOperation (
 )
 {
   Time moment = Simulator::Now ();
+  FlushErrorModel (qubits);
   bool succeed = m_qnetsim.ApplyOperation (quantumOperation, qubits);
+  Record ({QuantumTraceRecord::OPERATION, "", "", qubits, {}, quantumOperation.getOprs ()});
 
   // update qubit2time only if the moment param has an actual meaning
   if (moment != Seconds (-1))
@@ -193,8 +379,12 @@ QuantumPhyEntity::ApplyControlledOperation (
     const std::vector<std::complex<double>> &data, const std::vector<std::string> &control_qubits,
     const std::vector<std::string> &target_qubits)
 {
+  FlushErrorModel (control_qubits);
+  FlushErrorModel (target_qubits);
   bool succeed = m_qnetsim.ApplyControlledOperation (orig_owner, orig_gate, gate, data,
                                                     control_qubits, target_qubits);
+  Record ({QuantumTraceRecord::CONTROLLED_OPERATION, orig_owner, gate, target_qubits,
+           control_qubits, {data}});
 
   ApplyErrorModel (orig_owner, orig_gate, target_qubits);
 
@@ -215,7 +405,130 @@ QuantumPhyEntity::Measure (const std::string &owner, const std::vector<std::stri
       ApplyErrorModel ({q}, moment);
     }
 
-  return m_qnetsim.Measure (owner, qubits);
+  std::pair<unsigned, std::vector<double>> result = m_qnetsim.Measure (owner, qubits);
+  Record ({QuantumTraceRecord::MEASURE, owner, "", qubits, {}, {}, {result.first}});
+  return result;
+}
+
+std::vector<unsigned>
+QuantumPhyEntity::Sample (const std::string &owner, const std::vector<std::string> &qubits,
+                          const unsigned &shots)
+{
+  std::vector<std::vector<std::complex<double>>> states = {};
+  return Sample (owner, qubits, shots, {}, states);
+}
+
+std::vector<unsigned>
+QuantumPhyEntity::Sample (const std::string &owner, const std::vector<std::string> &qubits,
+                          const unsigned &shots, const std::vector<std::string> &keep_qubits,
+                          std::vector<std::vector<std::complex<double>>> &states)
+{
+  Time moment = Simulator::Now ();
+  assert (CheckOwned (owner, qubits));
+  for (const std::string &q : m_qnetsim.m_qubits_all)
+    {
+      if (!CheckValid ({q}))
+        {
+          continue;
+        }
+      ApplyErrorModel ({q}, moment);
+    }
+
+  std::vector<unsigned> histogram = m_qnetsim.Sample (owner, qubits, shots, keep_qubits, states);
+  Record ({QuantumTraceRecord::SAMPLE, owner, "", qubits, keep_qubits, {}, {shots}});
+  return histogram;
+}
+
+std::vector<std::pair<unsigned, std::vector<double>>>
+QuantumPhyEntity::MeasureBatch (
+    const std::vector<std::pair<std::string, std::vector<std::string>>> &requests)
+{
+  Time moment = Simulator::Now ();
+  for (const auto &[owner, qubits] : requests)
+    {
+      assert (CheckOwned (owner, qubits));
+    }
+  for (const std::string &q : m_qnetsim.m_qubits_all)
+    {
+      if (!CheckValid ({q}))
+        {
+          continue;
+        }
+      ApplyErrorModel ({q}, moment);
+    }
+
+  std::vector<std::pair<unsigned, std::vector<double>>> results = m_qnetsim.MeasureBatch (requests);
+  QuantumTraceRecord record = {QuantumTraceRecord::MEASURE_BATCH};
+  for (unsigned i = 0; i < requests.size (); ++i)
+    {
+      record.args.push_back (requests[i].first);
+      record.qubits.insert (record.qubits.end (), requests[i].second.begin (),
+                            requests[i].second.end ());
+      record.values.push_back (requests[i].second.size ());
+      record.values.push_back (results[i].first);
+    }
+  Record (record);
+  return results;
+}
+
+bool
+QuantumPhyEntity::MeasureToRegister (const std::string &owner,
+                                     const std::vector<std::string> &qubits,
+                                     const std::vector<std::string> &cregs)
+{
+  Time moment = Simulator::Now ();
+  assert (CheckOwned (owner, qubits));
+
+  for (const std::string &qubit : qubits)
+    {
+      ApplyErrorModel ({qubit}, moment);
+    }
+
+  bool succeed = m_qnetsim.MeasureToRegister (owner, qubits, cregs);
+  Record ({QuantumTraceRecord::MEASURE_TO_REGISTER, owner, "", qubits, cregs});
+  return succeed;
+}
+
+bool
+QuantumPhyEntity::ApplyClassicallyControlledGate (const std::string &owner,
+                                                  const std::string &gate,
+                                                  const std::vector<std::complex<double>> &data,
+                                                  const std::vector<std::string> &cregs,
+                                                  const std::vector<std::string> &target_qubits)
+{
+  Time moment = Simulator::Now ();
+  assert (CheckOwned (owner, target_qubits));
+
+  for (const std::string &qubit : target_qubits)
+    {
+      ApplyErrorModel ({qubit}, moment);
+    }
+
+  bool succeed =
+      m_qnetsim.ApplyClassicallyControlledGate (owner, gate, data, cregs, target_qubits);
+  Record ({QuantumTraceRecord::CLASSICALLY_CONTROLLED_GATE, owner, gate, target_qubits, cregs,
+           {data}});
+
+  if (owner != "God")
+    ApplyErrorModel (owner, gate, target_qubits, moment);
+
+  return succeed;
+}
+
+void
+QuantumPhyEntity::PeekBranches (const std::string &owner, const std::vector<std::string> &cregs,
+                                const std::vector<std::string> &qubits,
+                                std::vector<double> &probs,
+                                std::vector<std::vector<std::complex<double>>> &states)
+{
+  if (owner != "God")
+    {
+      assert (CheckOwned (owner, qubits));
+    }
+
+  FlushErrorModel ();
+  m_qnetsim.PeekBranches (owner, cregs, qubits, probs, states);
+  Record ({QuantumTraceRecord::PEEK_BRANCHES, owner, "", qubits, cregs});
 }
 
 std::vector<std::complex<double>>
@@ -230,7 +543,10 @@ QuantumPhyEntity::PeekDM (
       assert (CheckOwned (owner, qubits));
     }
 
-  return m_qnetsim.PeekDM (owner, qubits, dm);
+  FlushErrorModel ();
+  m_qnetsim.PeekDM (owner, qubits, dm);
+  Record ({QuantumTraceRecord::PEEK_DM, owner, "", qubits});
+  return dm;
 }
 
 bool
@@ -244,15 +560,122 @@ QuantumPhyEntity::PartialTrace (
       ApplyErrorModel ({qubit}, moment);
     }
 
-  return m_qnetsim.PartialTrace (qubits);
+  bool succeed = m_qnetsim.PartialTrace (qubits);
+  Record ({QuantumTraceRecord::PARTIAL_TRACE, "", "", qubits});
+
+  // free the slots and the handles of the qubits, for new qubits to reuse
+  for (const std::string &qubit : qubits)
+    {
+      for (const auto &[owner, pnode] : m_owner2pnode)
+        {
+          if (pnode->RemoveQubit (qubit))
+            {
+              break;
+            }
+        }
+      m_qubit2time.erase (qubit);
+      m_qubit2model.erase (qubit);
+      m_qubit2pending.erase (qubit);
+    }
+  MaybeCompact ();
+  return succeed;
 }
 
 std::vector<std::complex<double>>
 QuantumPhyEntity::Contract (const std::string &optimizer)
 {
+  FlushErrorModel ();
+  Record ({QuantumTraceRecord::CONTRACT, "", optimizer});
   return m_qnetsim.Contract (optimizer);
 }
 
+void
+QuantumPhyEntity::PeekDMAsync (const std::string &owner, const std::vector<std::string> &qubits,
+                               const Time &delay,
+                               Callback<void, std::vector<std::complex<double>>> callback)
+{
+  if (owner != "God")
+    {
+      assert (CheckOwned (owner, qubits));
+    }
+
+  FlushErrorModel ();
+  unsigned ticket = m_qnetsim.SubmitReducedDM (qubits);
+  Record ({QuantumTraceRecord::PEEK_DM, owner, "", qubits});
+  Simulator::Schedule (delay, &QuantumPhyEntity::DeliverReducedDM, this, ticket, callback);
+}
+
+void
+QuantumPhyEntity::CalculateFidelityAsync (const std::pair<std::string, std::string> &epr,
+                                          const Time &delay, Callback<void, double> callback)
+{
+  FlushErrorModel ();
+  unsigned ticket = m_qnetsim.SubmitReducedDM ({epr.first, epr.second});
+  Record ({QuantumTraceRecord::FIDELITY, "", "", {epr.first, epr.second}});
+  Simulator::Schedule (delay, &QuantumPhyEntity::DeliverFidelity, this, ticket, callback);
+}
+
+void
+QuantumPhyEntity::ContractAsync (const std::string &optimizer, const Time &delay,
+                                 Callback<void, std::vector<std::complex<double>>> callback)
+{
+  Record ({QuantumTraceRecord::CONTRACT, "", optimizer});
+  FlushErrorModel ();
+  unsigned ticket = m_qnetsim.SubmitContract (optimizer);
+  Simulator::Schedule (delay, &QuantumPhyEntity::DeliverContract, this, ticket, callback);
+}
+
+void
+QuantumPhyEntity::DeliverReducedDM (const unsigned &ticket,
+                                    Callback<void, std::vector<std::complex<double>>> callback)
+{
+  NS_LOG_LOGIC ("Collecting evaluation " << ticket << " which is "
+                                         << (m_qnetsim.IsReady (ticket) ? "ready" : "running"));
+  callback (m_qnetsim.CollectReducedDM (ticket));
+}
+
+void
+QuantumPhyEntity::DeliverFidelity (const unsigned &ticket, Callback<void, double> callback)
+{
+  NS_LOG_LOGIC ("Collecting evaluation " << ticket << " which is "
+                                         << (m_qnetsim.IsReady (ticket) ? "ready" : "running"));
+  callback (GetFidelity (m_qnetsim.CollectReducedDM (ticket), q_bell));
+}
+
+void
+QuantumPhyEntity::DeliverContract (const unsigned &ticket,
+                                   Callback<void, std::vector<std::complex<double>>> callback)
+{
+  NS_LOG_LOGIC ("Collecting evaluation " << ticket << " which is "
+                                         << (m_qnetsim.IsReady (ticket) ? "ready" : "running"));
+  callback (m_qnetsim.CollectContract (ticket));
+}
+
+bool
+QuantumPhyEntity::MaybeCompact ()
+{
+  Time moment = Simulator::Now ();
+  unsigned num_tensors = m_qnetsim.m_dm.getNumTensors ();
+  // the components kept by the last compaction must double before another one pays off
+  m_compact_left = std::min (m_compact_left, num_tensors);
+  bool by_tensors =
+      m_compact_tensors && num_tensors > std::max (m_compact_tensors, m_compact_left << 1);
+  bool by_time = m_compact_interval.IsStrictlyPositive () &&
+                 moment - m_last_compact >= m_compact_interval;
+  if (!by_tensors && !by_time)
+    {
+      return false;
+    }
+
+  NS_LOG_LOGIC ("At time " << moment.As (Time::S) << " compacting the tensor network of "
+                           << num_tensors << " tensors");
+  m_qnetsim.Compact (m_compact_max_qubits);
+  Record ({QuantumTraceRecord::COMPACT, "", "", {}, {}, {}, {m_compact_max_qubits}});
+  m_last_compact = moment;
+  m_compact_left = m_qnetsim.m_dm.getNumTensors ();
+  return true;
+}
+
 Ptr<QuantumNode>
 QuantumPhyEntity::GetNode (const std::string &owner)
 {
@@ -281,27 +704,120 @@ QuantumPhyEntity::SetDephaseModel (const std::string &owner,
 }
 
 void
-QuantumPhyEntity::ApplyErrorModel ( // using DephaseModel
+QuantumPhyEntity::SetKrausModel (const std::string &owner, const std::string &gate,
+                                 const QuantumOperation &opr)
+{
+  Ptr<QuantumErrorModel> pmodel = CreateObject<KrausModel> (opr);
+  NS_LOG_LOGIC ("Setting Kraus model " << pmodel->GetTypeDesc () << " to gate " << gate
+                                       << " of node " << owner);
+  m_gate2model[m_owner2pnode[owner]][gate] = pmodel;
+}
+
+void
+QuantumPhyEntity::ApplyErrorModel ( // using DephaseModel or KrausModel
     const std::string &owner, const std::string &gate, const std::vector<std::string> &qubits,
     const Time &moment)
 {
   Ptr<QuantumNode> pnode = m_owner2pnode[owner];
+  Time after = Seconds (GATE_DURATION + moment.GetSeconds ());
+
+  auto it = m_gate2model[pnode].find (gate);
+  if (it == m_gate2model[pnode].end ())
+    {
+      NS_LOG_LOGIC ("Using default DephaseModel");
+    }
+  const QuantumErrorModel &model =
+      it == m_gate2model[pnode].end () ? static_cast<const QuantumErrorModel &> (default_dephase_model)
+                                       : *it->second;
 
   for (const std::string &qubit : qubits)
-    { // default
-      if (m_gate2model[pnode].find (gate) == m_gate2model[pnode].end ())
+    {
+      if (FuseDephasing (model, qubit, after, false))
         {
-          NS_LOG_LOGIC ("Using default DephaseModel");
-          default_dephase_model.ApplyErrorModel (this, {qubit},
-                                                 Seconds (GATE_DURATION + moment.GetSeconds ()));
+          continue;
+        }
+      QuantumOperation error = model.GetOperation (this, qubit, after);
+      if (error.getDim () > 2)
+        { // a multi-qubit channel cannot wait in a single qubit
+          assert (error.getDim () == (1u << qubits.size ()));
+          ApplyOperation (error, qubits);
+          return;
+        }
+      if (error.isIdentity ())
+        {
+          continue;
+        }
+      auto pending = m_qubit2pending.find (qubit);
+      if (pending == m_qubit2pending.end ())
+        {
+          m_qubit2pending.emplace (qubit, error);
         }
       else
-        { // specified
-          m_gate2model[pnode][gate]->ApplyErrorModel (this, {qubit},
-                                                      Seconds (GATE_DURATION + moment.GetSeconds ()));
+        {
+          pending->second = Compose (pending->second, error);
         }
     }
 }
+
+void
+QuantumPhyEntity::FlushErrorModel (const std::vector<std::string> &qubits)
+{
+  for (const std::string &qubit : qubits)
+    {
+      auto pending = m_qubit2pending.find (qubit);
+      if (pending == m_qubit2pending.end ())
+        {
+          continue;
+        }
+      QuantumOperation error = pending->second;
+      m_qubit2pending.erase (pending);
+
+      // the qubit keeps the time of its gate, so that its next channel still idles from there
+      m_qnetsim.ApplyOperation (error, {qubit});
+      Record ({QuantumTraceRecord::OPERATION, "", "", {qubit}, {}, error.getOprs ()});
+    }
+}
+
+void
+QuantumPhyEntity::FlushErrorModel ()
+{
+  while (!m_qubit2pending.empty ())
+    {
+      FlushErrorModel ({m_qubit2pending.begin ()->first});
+    }
+}
+
+bool
+QuantumPhyEntity::FuseDephasing (const QuantumErrorModel &model, const std::string &qubit,
+                                 const Time &moment, const bool &idle)
+{
+  double prob = 0.;
+  if (m_qubit2pending.find (qubit) != m_qubit2pending.end () ||
+      !model.GetDephasing (this, qubit, moment, prob))
+    {
+      return false;
+    }
+  if (prob <= 0.)
+    {
+      return true;
+    }
+
+  // a Z error with probability p scales the coherences by 1 - 2p
+  m_scratch_diag.assign (4, 1.0);
+  m_scratch_diag[1] = m_scratch_diag[2] = 1. - 2. * prob;
+  m_qnetsim.AccumulateDiagonal (qubit, m_scratch_diag);
+  if (m_trace)
+    {
+      Record ({QuantumTraceRecord::OPERATION, "", "", {qubit}, {},
+               PauliChannel (0., 0., prob).getOprs ()});
+    }
+  if (idle)
+    {
+      m_qubit2time[qubit] = Simulator::Now ();
+    }
+  return true;
+}
+
 void
 QuantumPhyEntity::SetDepolarModel (std::pair<std::string, std::string> conn, double fidel)
 {
@@ -319,17 +835,8 @@ QuantumPhyEntity::ApplyErrorModel ( // using DepolarModel
                 << conn.first << " and " << conn.second
                 << " at time " << Simulator::Now ());
 
-  for (auto [conn, pmodel] : m_conn2model)
-    {
-      if (conn.first == "" && conn.second == "")
-        {
-          NS_LOG_LOGIC ("Skipping default DepolarModel");
-          continue;
-        }
-      // NS_LOG_LOGIC ("Connection " << conn.first << " <--> " << conn.second << " has "
-      //                             << pmodel->GetTypeDesc ());
-    }
-  if (m_conn2model.find (conn) == m_conn2model.end ())
+  auto it = m_conn2model.find (conn);
+  if (it == m_conn2model.end ())
     { // default
       NS_LOG_LOGIC ("Using default DepolarModel");
       default_depolar_model.ApplyErrorModel (this, {epr.second}, Seconds (-1));
@@ -337,10 +844,25 @@ QuantumPhyEntity::ApplyErrorModel ( // using DepolarModel
   else
     { // specified
       NS_LOG_LOGIC ("Using specified DepolarModel");
-      m_conn2model[conn]->ApplyErrorModel (this, {epr.second}, Seconds (-1));
+      it->second->ApplyErrorModel (this, {epr.second}, Seconds (-1));
     }
 }
 
+void
+QuantumPhyEntity::SetLinkTable (const std::pair<std::string, std::string> &conn,
+                                const QuantumLinkTable &table)
+{
+  m_conn2link[conn] = table;
+  SetDepolarModel (conn, table.fidelity);
+}
+
+const QuantumLinkTable *
+QuantumPhyEntity::GetLinkTable (const std::pair<std::string, std::string> &conn) const
+{
+  auto it = m_conn2link.find (conn);
+  return it == m_conn2link.end () ? nullptr : &it->second;
+}
+
 void
 QuantumPhyEntity::SetTimeModel (const std::string &owner, double rate)
 {
@@ -350,18 +872,122 @@ QuantumPhyEntity::SetTimeModel (const std::string &owner, double rate)
 
   m_node2model[pnode] = pmodel;
 }
+void
+QuantumPhyEntity::SetAmplitudeDampModel (const std::string &owner, double t1, double rate)
+{
+  Ptr<QuantumErrorModel> pmodel = CreateObject<AmplitudeDampModel> (t1, rate);
+  NS_LOG_LOGIC ("Setting amplitude damping model " << pmodel->GetTypeDesc () << " to node "
+                                                   << owner);
+  m_node2model[m_owner2pnode[owner]] = pmodel;
+}
+
 void
 QuantumPhyEntity::ApplyErrorModel ( // using TimeModel
     const std::vector<std::string> &qubits, const Time &moment)
 {
   for (const std::string &qubit : qubits)
     {
-      assert (m_qubit2model.find (qubit) != m_qubit2model.end ());
-      m_qubit2model[qubit]->ApplyErrorModel (this, qubits, moment);
+      auto model = m_qubit2model.find (qubit);
+      assert (model != m_qubit2model.end ());
+      if (FuseDephasing (*model->second, qubit, moment, true))
+        {
+          continue;
+        }
+      QuantumOperation idle = model->second->GetOperation (this, qubit, moment);
+
+      // the gate error since the last operation and the idling after it, as one channel
+      auto pending = m_qubit2pending.find (qubit);
+      if (pending != m_qubit2pending.end ())
+        {
+          idle = Compose (pending->second, idle);
+          m_qubit2pending.erase (pending);
+        }
+      if (!idle.isIdentity ())
+        {
+          ApplyOperation (idle, {qubit});
+        }
+    }
+}
+
+
+
+/* cutoff */
+
+void
+QuantumPhyEntity::SetCutoff (const std::string &owner, const Time &cutoff,
+                             Callback<void, std::string> callback)
+{
+  NS_LOG_LOGIC ("Setting cutoff " << cutoff.As (Time::S) << " to node " << owner);
+  m_node2cutoff[m_owner2pnode.at (owner)] = {cutoff, callback};
+}
+
+void
+QuantumPhyEntity::ArmCutoff (const std::string &owner, const std::string &qubit)
+{
+  DisarmCutoff (qubit);
+  auto it = m_node2cutoff.find (m_owner2pnode.at (owner));
+  if (it == m_node2cutoff.end () || it->second.first.IsZero ())
+    {
+      return;
     }
+  m_qubit2cutoff[qubit] =
+      Simulator::Schedule (it->second.first, &QuantumPhyEntity::ExpireQubit, this, owner, qubit);
 }
 
+void
+QuantumPhyEntity::DisarmCutoff (const std::string &qubit)
+{
+  auto it = m_qubit2cutoff.find (qubit);
+  if (it != m_qubit2cutoff.end ())
+    {
+      it->second.Cancel ();
+      m_qubit2cutoff.erase (it);
+    }
+}
+
+void
+QuantumPhyEntity::ExpireQubit (const std::string &owner, const std::string &qubit)
+{
+  m_qubit2cutoff.erase (qubit);
+  Ptr<QuantumNode> pnode = m_owner2pnode.at (owner);
+  if (!pnode->OwnQubit (qubit))
+    {
+      return;
+    }
+
+  NS_LOG_INFO (RED_CODE << "At time " << Simulator::Now ().As (Time::S) << " " << owner
+                        << " discards qubit " << qubit << " past its cutoff" << END_CODE);
+  if (CheckValid ({qubit}))
+    {
+      PartialTrace ({qubit}); // frees the slot as well
+    }
+  else
+    {
+      pnode->RemoveQubit (qubit);
+    }
+
+  // a restored cutoff may find its policy not configured again
+  auto policy = m_node2cutoff.find (pnode);
+  if (policy != m_node2cutoff.end () && !policy->second.second.IsNull ())
+    {
+      policy->second.second (qubit);
+    }
+}
 
+void
+QuantumPhyEntity::RestoreCutoff (const std::string &qubit, const Time &delay)
+{
+  for (const auto &[owner, pnode] : m_owner2pnode)
+    {
+      if (pnode->OwnQubit (qubit))
+        {
+          DisarmCutoff (qubit);
+          m_qubit2cutoff[qubit] =
+              Simulator::Schedule (delay, &QuantumPhyEntity::ExpireQubit, this, owner, qubit);
+          return;
+        }
+    }
+}
 
 
 /* network */
@@ -377,9 +1003,345 @@ QuantumPhyEntity::GenerateEPR (Ptr<QuantumChannel> qconn,
 double 
 QuantumPhyEntity::CalculateFidelity (const std::pair<std::string, std::string> &epr, double &fidel)
 {
+  FlushErrorModel ();
+  Record ({QuantumTraceRecord::FIDELITY, "", "", {epr.first, epr.second}});
   return m_qnetsim.CalculateFidelity (epr, fidel);
 }
 
+std::vector<double>
+QuantumPhyEntity::EvaluateMetrics (const std::vector<QuantumMetric> &requests)
+{
+  FlushErrorModel ();
+  QuantumTraceRecord record = {QuantumTraceRecord::METRICS};
+  for (const QuantumMetric &request : requests)
+    {
+      record.qubits.insert (record.qubits.end (), request.qubits.begin (), request.qubits.end ());
+      record.args.push_back (request.pauli);
+      record.data.push_back (request.data);
+      record.values.push_back (request.kind);
+      record.values.push_back (request.qubits.size ());
+    }
+  Record (record);
+  return m_qnetsim.EvaluateMetrics (requests);
+}
+
+std::vector<double>
+QuantumPhyEntity::CalculateFidelities (const std::vector<std::pair<std::string, std::string>> &eprs)
+{
+  std::vector<QuantumMetric> requests = {};
+  for (const auto &epr : eprs)
+    {
+      requests.push_back ({QuantumMetric::FIDELITY, {epr.first, epr.second}, q_bell, ""});
+    }
+  return EvaluateMetrics (requests);
+}
+
+
+/* checkpoint */
+
+Ptr<QuantumPhyEntity>
+QuantumPhyEntity::Fork () const
+{
+  Ptr<QuantumPhyEntity> fork = CopyObject<QuantumPhyEntity> (Ptr<const QuantumPhyEntity> (this));
+  NS_LOG_INFO ("Forked a simulation of " << m_qubit2time.size () << " qubits");
+  return fork;
+}
+
+bool
+QuantumPhyEntity::SaveCheckpoint (const std::string &path)
+{
+  std::ofstream out (path, std::ios::binary);
+  if (! out)
+    {
+      NS_LOG_WARN ("Cannot open " << path << " to save a checkpoint");
+      return false;
+    }
+  FlushErrorModel ();
+  out.write (QNS_CHECKPOINT_MAGIC.data (), QNS_CHECKPOINT_MAGIC.size ());
+
+  // owners, with the slots of their memory, ahead of the network to be checked before loading it
+  Time now = Simulator::Now ();
+  WriteBinary<uint64_t> (out, m_owner2pnode.size ());
+  for (const auto &[owner, pnode] : m_owner2pnode)
+    {
+      WriteBinary (out, owner);
+      WriteBinary<uint32_t> (out, pnode->GetMemoryCapacity ());
+      std::vector<std::string> slots = pnode->GetQubitSlots ();
+      WriteBinary<uint64_t> (out, slots.size ());
+      for (const std::string &qubit : slots)
+        {
+          WriteBinary (out, qubit);
+        }
+    }
+  m_qnetsim.Save (out);
+
+  // age and time relevant error model of each qubit, the latter by the owner configuring it
+  WriteBinary<uint64_t> (out, m_qubit2time.size ());
+  for (const auto &[qubit, moment] : m_qubit2time)
+    {
+      WriteBinary (out, qubit);
+      WriteBinary<int64_t> (out, (now - moment).GetTimeStep ());
+      std::string model_owner = "";
+      auto it = m_qubit2model.find (qubit);
+      for (const auto &[pnode, pmodel] : m_node2model)
+        {
+          if (it != m_qubit2model.end () && it->second == pmodel)
+            {
+              model_owner = pnode->GetOwner ();
+            }
+        }
+      WriteBinary (out, model_owner);
+    }
+  WriteBinary<int64_t> (out, (now - m_last_compact).GetTimeStep ());
+
+  // time left before each armed cutoff
+  std::vector<std::pair<std::string, Time>> cutoffs = {};
+  for (const auto &[qubit, event] : m_qubit2cutoff)
+    {
+      if (!Simulator::IsExpired (event))
+        {
+          cutoffs.push_back ({qubit, Simulator::GetDelayLeft (event)});
+        }
+    }
+  WriteBinary<uint64_t> (out, cutoffs.size ());
+  for (const auto &[qubit, delay] : cutoffs)
+    {
+      WriteBinary (out, qubit);
+      WriteBinary<int64_t> (out, delay.GetTimeStep ());
+    }
+
+  NS_LOG_INFO ("Saved a checkpoint of " << m_qubit2time.size () << " qubits to " << path);
+  return bool (out);
+}
+
+bool
+QuantumPhyEntity::LoadCheckpoint (const std::string &path)
+{
+  std::ifstream in (path, std::ios::binary);
+  std::string magic (QNS_CHECKPOINT_MAGIC.size (), '\0');
+  if (! in.read (&magic[0], magic.size ()) || magic != QNS_CHECKPOINT_MAGIC)
+    {
+      NS_LOG_WARN (path << " is not a checkpoint");
+      return false;
+    }
+
+  // the owners are checked before anything is restored
+  std::vector<std::tuple<std::string, unsigned, std::vector<std::string>>> memories (
+      ReadBinarySize (in));
+  for (auto &[owner, capacity, slots] : memories)
+    {
+      owner = ReadBinaryString (in);
+      if (! in || m_owner2pnode.find (owner) == m_owner2pnode.end ())
+        {
+          NS_LOG_WARN (path << " has an unknown owner " << owner);
+          return false;
+        }
+      capacity = ReadBinary<uint32_t> (in);
+      slots.resize (ReadBinarySize (in));
+      for (std::string &qubit : slots)
+        {
+          qubit = ReadBinaryString (in);
+        }
+    }
+  if (! in)
+    {
+      NS_LOG_WARN (path << " is truncated");
+      return false;
+    }
+
+  // only before any qubit is generated, so nothing per qubit is left but what a trace-out left
+  assert (m_qubit2time.empty ());
+  for (auto &[qubit, event] : m_qubit2cutoff)
+    {
+      event.Cancel ();
+    }
+  m_qubit2cutoff.clear ();
+  m_qubit2pending.clear ();
+  m_qubit2model.clear ();
+
+  if (! m_qnetsim.Load (in))
+    {
+      NS_LOG_WARN (path << " is truncated or corrupt");
+      return false;
+    }
+  for (const auto &[owner, capacity, slots] : memories)
+    {
+      m_owner2pnode[owner]->SetQubitSlots (slots);
+      m_owner2pnode[owner]->SetMemoryCapacity (capacity);
+    }
+
+  Time now = Simulator::Now ();
+
+  for (uint64_t i = ReadBinarySize (in); i > 0; --i)
+    {
+      std::string qubit = ReadBinaryString (in);
+      m_qubit2time[qubit] = now - TimeStep (ReadBinary<int64_t> (in));
+      std::string model_owner = ReadBinaryString (in);
+      Ptr<QuantumErrorModel> pmodel;
+      if (model_owner != "" && m_node2model.find (m_owner2pnode[model_owner]) != m_node2model.end ())
+        pmodel = m_node2model[m_owner2pnode[model_owner]];
+      else
+        pmodel = default_time_model.GetObject<QuantumErrorModel> ();
+      SetErrorModel (pmodel, qubit);
+    }
+  m_last_compact = now - TimeStep (ReadBinary<int64_t> (in));
+
+  for (uint64_t i = ReadBinarySize (in); i > 0 && in; --i)
+    {
+      std::string qubit = ReadBinaryString (in);
+      Time delay = TimeStep (ReadBinary<int64_t> (in));
+      if (in)
+        {
+          RestoreCutoff (qubit, delay);
+        }
+    }
+
+  if (! in)
+    {
+      NS_LOG_WARN (path << " is truncated");
+      return false;
+    }
+  NS_LOG_INFO ("Loaded a checkpoint of " << m_qubit2time.size () << " qubits from " << path);
+  return true;
+}
+
+
+/* trace */
+
+void
+QuantumPhyEntity::SetTraceFile (std::string path)
+{
+  m_trace_file = path;
+  m_trace = nullptr; // closes the previous trace
+  if (path != "")
+    {
+      std::vector<std::string> owners = {};
+      for (const auto &[owner, pnode] : m_owner2pnode)
+        {
+          owners.push_back (owner);
+        }
+      m_trace = CreateObject<QuantumTraceWriter> (path, owners);
+    }
+}
+
+std::string
+QuantumPhyEntity::GetTraceFile () const
+{
+  return m_trace_file;
+}
+
+void
+QuantumPhyEntity::Record (const QuantumTraceRecord &record)
+{
+  if (m_trace)
+    {
+      m_trace->Write (record);
+    }
+}
+
+void
+QuantumPhyEntity::Replay (const QuantumTraceRecord &record)
+{
+  const std::vector<std::complex<double>> &data =
+      record.data.size () ? record.data[0] : std::vector<std::complex<double>> ();
+  switch (record.kind)
+    {
+    case QuantumTraceRecord::GENERATE_PURE:
+      m_qnetsim.GenerateQubitsPure (record.owner, data, record.qubits);
+      break;
+    case QuantumTraceRecord::GENERATE_MIXED:
+      m_qnetsim.GenerateQubitsMixed (record.owner, data, record.qubits);
+      break;
+    case QuantumTraceRecord::GATE:
+      m_qnetsim.ApplyGate (record.owner, record.name, data, record.qubits);
+      break;
+    case QuantumTraceRecord::OPERATION: {
+      // the Kraus operators are recorded already scaled by their probabilities
+      std::vector<std::string> names (record.data.size (), "");
+      std::vector<double> probs (record.data.size (), 1.0);
+      m_qnetsim.ApplyOperation (QuantumOperation (names, record.data, probs), record.qubits);
+      break;
+    }
+    case QuantumTraceRecord::CONTROLLED_OPERATION:
+      m_qnetsim.ApplyControlledOperation (record.owner, "", record.name, data, record.args,
+                                          record.qubits);
+      break;
+    case QuantumTraceRecord::MEASURE:
+      m_qnetsim.ForceOutcome (record.values[0]);
+      m_qnetsim.Measure (record.owner, record.qubits);
+      break;
+    case QuantumTraceRecord::MEASURE_BATCH: {
+      std::vector<std::pair<std::string, std::vector<std::string>>> requests = {};
+      unsigned outcome = 0, offset = 0;
+      for (unsigned i = 0; i < record.args.size (); ++i)
+        {
+          unsigned size = record.values[i << 1];
+          requests.push_back ({record.args[i],
+                               std::vector<std::string> (record.qubits.begin () + offset,
+                                                         record.qubits.begin () + offset + size)});
+          outcome |= record.values[(i << 1) | 1] << offset;
+          offset += size;
+        }
+      m_qnetsim.ForceOutcome (outcome);
+      m_qnetsim.MeasureBatch (requests);
+      break;
+    }
+    case QuantumTraceRecord::MEASURE_TO_REGISTER:
+      m_qnetsim.MeasureToRegister (record.owner, record.qubits, record.args);
+      break;
+    case QuantumTraceRecord::CLASSICALLY_CONTROLLED_GATE:
+      m_qnetsim.ApplyClassicallyControlledGate (record.owner, record.name, data, record.args,
+                                                record.qubits);
+      break;
+    case QuantumTraceRecord::SAMPLE: {
+      std::vector<std::vector<std::complex<double>>> states = {};
+      m_qnetsim.Sample (record.owner, record.qubits, record.values[0], record.args, states);
+      break;
+    }
+    case QuantumTraceRecord::PEEK_BRANCHES: {
+      std::vector<double> probs = {};
+      std::vector<std::vector<std::complex<double>>> states = {};
+      m_qnetsim.PeekBranches (record.owner, record.args, record.qubits, probs, states);
+      break;
+    }
+    case QuantumTraceRecord::PEEK_DM:
+      m_qnetsim.ReducedDM (record.qubits);
+      break;
+    case QuantumTraceRecord::PARTIAL_TRACE:
+      m_qnetsim.PartialTrace (record.qubits);
+      break;
+    case QuantumTraceRecord::CONTRACT:
+      m_qnetsim.Contract (record.name);
+      break;
+    case QuantumTraceRecord::CHECKPOINT:
+      m_qnetsim.Checkpoint ();
+      break;
+    case QuantumTraceRecord::COMPACT:
+      m_qnetsim.Compact (record.values[0]);
+      break;
+    case QuantumTraceRecord::FIDELITY: {
+      double fidel = 0;
+      m_qnetsim.CalculateFidelity ({record.qubits[0], record.qubits[1]}, fidel);
+      break;
+    }
+    case QuantumTraceRecord::METRICS: {
+      std::vector<QuantumMetric> requests = {};
+      unsigned offset = 0;
+      for (unsigned i = 0; i < record.args.size (); ++i)
+        {
+          unsigned size = record.values[(i << 1) | 1];
+          requests.push_back ({QuantumMetric::Kind (record.values[i << 1]),
+                               std::vector<std::string> (record.qubits.begin () + offset,
+                                                         record.qubits.begin () + offset + size),
+                               record.data[i], record.args[i]});
+          offset += size;
+        }
+      m_qnetsim.EvaluateMetrics (requests);
+      break;
+    }
+    }
+}
+
 
 /* util */
 
@@ -450,7 +1412,57 @@ QuantumPhyEntity::SetOwnerRank (const std::string &owner, const unsigned &rank)
 void
 QuantumPhyEntity::Checkpoint ()
 {
+  FlushErrorModel ();
   m_qnetsim.Checkpoint ();
+  Record ({QuantumTraceRecord::CHECKPOINT});
+}
+
+void
+QuantumPhyEntity::SetOptimizer (std::string optimizer)
+{
+  m_qnetsim.m_optimizer = optimizer;
+}
+
+std::string
+QuantumPhyEntity::GetOptimizer () const
+{
+  return m_qnetsim.m_optimizer;
+}
+
+void
+QuantumPhyEntity::SetBackend (std::string backend)
+{
+  m_qnetsim.SetBackend (backend);
+}
+
+std::string
+QuantumPhyEntity::GetBackend () const
+{
+  return m_qnetsim.m_mps ? "mps" : "exatn";
+}
+
+void
+QuantumPhyEntity::SetPrecision (std::string precision)
+{
+  m_qnetsim.SetPrecision (precision);
+}
+
+std::string
+QuantumPhyEntity::GetPrecision () const
+{
+  return m_qnetsim.GetPrecision ();
+}
+
+double
+QuantumPhyEntity::GetTruncationError () const
+{
+  return m_qnetsim.GetTruncationError ();
+}
+
+QuantumEvalStats
+QuantumPhyEntity::GetEvalStats () const
+{
+  return m_qnetsim.GetEvalStats ();
 }
 
 
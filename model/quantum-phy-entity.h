@@ -4,6 +4,8 @@
 #include "ns3/quantum-basis.h"
 #include "ns3/quantum-network-simulator.h" // class QuantumNetworkSimulator
 #include "ns3/quantum-channel.h" // class QuantumChannel
+#include "ns3/quantum-trace.h" // struct QuantumTraceRecord, class QuantumTraceWriter
+#include "ns3/quantum-operation.h" // class QuantumOperation
 
 #include <exatn.hpp> // exatn::numerics::TensorNetwork
 
@@ -36,10 +38,21 @@ class QuantumPhyEntity : public Object
   friend class DephaseModel;
   friend class TimeModel;
   friend class DepolarModel;
+  friend class AmplitudeDampModel;
 
 public:
   QuantumPhyEntity (const std::vector<std::string> &owners); // names of the owners
 
+  /**
+   * \brief Copy the state of a simulation, to be used through Fork.
+   * 
+   * The copy gets its own quantum nodes, with the same qubits, addresses and ranks,
+   * bound to the same error models and cutoffs. The cutoffs of its qubits are armed
+   * again with the time they have left, without the callbacks, which notify the
+   * applications of the original. Applications are not copied.
+  */
+  QuantumPhyEntity (const QuantumPhyEntity &other);
+
   ~QuantumPhyEntity ();
 
   QuantumPhyEntity ();
@@ -104,6 +117,42 @@ public:
                   const std::vector<std::string> &qubits
   );
 
+  /**
+   * \brief Get the handle of an owner, for ApplyRegisteredGate.
+   * \param owner Name of the owner, or "God".
+   * \return Handle of the owner.
+  */
+  unsigned GetOwnerHandle (const std::string &owner);
+
+  /**
+   * \brief Register a gate, for ApplyRegisteredGate.
+   * \param gate Name of the gate.
+   * \param data Data of the gate, ignored if the gate is a reserved one or already registered.
+   * \return Handle of the gate.
+  */
+  unsigned RegisterGate (const std::string &gate, const std::vector<std::complex<double>> &data);
+
+  /**
+   * \brief Get the handle of a qubit, for ApplyRegisteredGate.
+   * \param qubit Name of the qubit, whose handle is freed for another qubit when it is traced out.
+   * \return Handle of the qubit.
+  */
+  unsigned GetQubitHandle (const std::string &qubit);
+
+  /**
+   * \brief Apply a registered gate to the qubits, all given by their handles.
+   *
+   * Same as ApplyGate, which goes through here, but without any string or vector to pass.
+   * Only the error models allocate, for the channels they return.
+   *
+   * \param owner Handle of the owner applying the gate.
+   * \param gate Handle of the gate.
+   * \param qubits Handles of the qubits.
+   * \return True if the gate is applied successfully.
+  */
+  bool ApplyRegisteredGate (const unsigned &owner, const unsigned &gate,
+                            QuantumSpan<unsigned> qubits);
+
   /**
    * \brief Apply a gate to the qubits.
    * 
@@ -154,11 +203,100 @@ public:
    * 
    * \param owner Owner measuring the qubits. 
    * \param qubits Names of the qubits to be measured.
-   * \return Measurement outcome and the probability distribution.
+   * \return Measurement outcome and the probability distribution,
+   * where bit i of an outcome is on the i-th qubit.
   */ 
   std::pair<unsigned, std::vector<double>>
   Measure (const std::string &owner, const std::vector<std::string> &qubits);
 
+  /**
+   * \brief Sample measurement outcomes of n qubits from one contraction, without collapsing them.
+   * 
+   * \internal Access control. Update errors. Call QuantumNetworkSimulator.
+   * 
+   * \param owner Owner sampling the qubits.
+   * \param qubits Names of the qubits to be measured.
+   * \param shots Number of samples to draw.
+   * \return Histogram of the outcomes, where bit i of an outcome is on the i-th qubit.
+  */
+  std::vector<unsigned> Sample (const std::string &owner, const std::vector<std::string> &qubits,
+                                const unsigned &shots);
+
+  /**
+   * \brief Sample measurement outcomes of n qubits from one contraction, without collapsing them,
+   * along with the post-measurement states of some other qubits.
+   * 
+   * \internal Access control. Update errors. Call QuantumNetworkSimulator.
+   * 
+   * \param owner Owner sampling the qubits.
+   * \param qubits Names of the qubits to be measured.
+   * \param shots Number of samples to draw.
+   * \param keep_qubits Names of the unmeasured qubits whose post-measurement states are wanted.
+   * \param states Vector to store the post-measurement state of the kept qubits for each outcome.
+   * \return Histogram of the outcomes, where bit i of an outcome is on the i-th qubit.
+  */
+  std::vector<unsigned> Sample (const std::string &owner, const std::vector<std::string> &qubits,
+                                const unsigned &shots, const std::vector<std::string> &keep_qubits,
+                                std::vector<std::vector<std::complex<double>>> &states);
+
+  /**
+   * \brief Measure a batch of independent requests issued at the same time.
+   * 
+   * \internal Access control. Update errors. Call QuantumNetworkSimulator.
+   * 
+   * \param requests Owner and names of the qubits of each request.
+   * \return Measurement outcome and the probability distribution of each request.
+  */
+  std::vector<std::pair<unsigned, std::vector<double>>>
+  MeasureBatch (const std::vector<std::pair<std::string, std::vector<std::string>>> &requests);
+
+
+  /**
+   * \brief Measure n qubits into classical registers without sampling.
+   * 
+   * \internal Access control. Update errors. Call QuantumNetworkSimulator.
+   * 
+   * \param owner Owner measuring the qubits.
+   * \param qubits Names of the qubits to be measured.
+   * \param cregs Names of the classical registers, one for each qubit.
+   * \return True if the qubits are measured successfully.
+  */
+  bool MeasureToRegister (const std::string &owner, const std::vector<std::string> &qubits,
+                          const std::vector<std::string> &cregs);
+
+  /**
+   * \brief Apply a gate to n qubits if all the classical registers hold 1.
+   * 
+   * \internal Access control. Update errors. Call QuantumNetworkSimulator.
+   * 
+   * \param owner Owner applying the gate.
+   * \param gate Name of the gate.
+   * \param data Data of the gate.
+   * \param cregs Names of the classical registers.
+   * \param target_qubits Names of the target qubits.
+   * \return True if the gate is applied successfully.
+   * 
+   * \note The gate error of the owner is attributed to the target qubits in every branch.
+  */
+  bool ApplyClassicallyControlledGate (const std::string &owner, const std::string &gate,
+                                       const std::vector<std::complex<double>> &data,
+                                       const std::vector<std::string> &cregs,
+                                       const std::vector<std::string> &target_qubits);
+
+  /**
+   * \brief Peek the branches of n classical registers on some qubits.
+   * 
+   * \internal Access control. Call QuantumNetworkSimulator.
+   * 
+   * \param owner Owner peeking the branches.
+   * \param cregs Names of the classical registers.
+   * \param qubits Names of the qubits to be peeked.
+   * \param probs Vector to store the probability of each branch.
+   * \param states Vector to store the density matrix of the qubits in each branch.
+  */
+  void PeekBranches (const std::string &owner, const std::vector<std::string> &cregs,
+                     const std::vector<std::string> &qubits, std::vector<double> &probs,
+                     std::vector<std::vector<std::complex<double>>> &states);
 
   /**
    * \brief Peek n qubits.
@@ -192,7 +330,56 @@ public:
    * \brief Contract the tensor network to a single tensor.
    * \return The density matrix of the tensor.
   */
-  std::vector<std::complex<double>> Contract (const std::string &optimizer = "greed");
+  std::vector<std::complex<double>> Contract (const std::string &optimizer = "");
+
+  /**
+   * \brief Peek n qubits asynchronously.
+   * 
+   * The contraction runs on the ExaTN workers while later events are processed,
+   * and the callback is invoked after the delay, waiting only if it is still running.
+   * 
+   * \param owner Owner peeking the qubits.
+   * \param qubits Names of the qubits to be peeked.
+   * \param delay Delay after which the density matrix is needed.
+   * \param callback Callback taking the density matrix of the qubits.
+  */
+  void PeekDMAsync (const std::string &owner, const std::vector<std::string> &qubits,
+                    const Time &delay,
+                    Callback<void, std::vector<std::complex<double>>> callback);
+
+  /**
+   * \brief Calculate the fidelity of an EPR pair to the bell state asynchronously.
+   * \param epr Names of the two qubits.
+   * \param delay Delay after which the fidelity is needed.
+   * \param callback Callback taking the fidelity.
+  */
+  void CalculateFidelityAsync (const std::pair<std::string, std::string> &epr, const Time &delay,
+                               Callback<void, double> callback);
+
+  /**
+   * \brief Contract the tensor network asynchronously.
+   * 
+   * \note The tensor network is replaced by the contracted tensor only if
+   * no operation has been applied in the meantime.
+   * 
+   * \param optimizer Contraction sequence optimizer.
+   * \param delay Delay after which the density matrix is needed.
+   * \param callback Callback taking the density matrix at the submission.
+  */
+  void ContractAsync (const std::string &optimizer, const Time &delay,
+                      Callback<void, std::vector<std::complex<double>>> callback);
+
+  /**
+   * \brief Compact the tensor network if the compaction policy asks for it.
+   * 
+   * \internal Called as qubits are generated and traced out, so that the size of
+   * the tensor network stays bounded in a long-running simulation.
+   * Past CompactTensors, it also waits for the tensors left by the last compaction to double,
+   * so that components too large to contract do not trigger a compaction at every call.
+   * 
+   * \return True if the tensor network is compacted.
+  */
+  bool MaybeCompact ();
   
   /**
    * \brief Get a pointer to a quantum node by its owner name.
@@ -219,7 +406,20 @@ public:
   );
 
   /**
-   * \brief Apply a dephasing model for a n-qubit gate.
+   * \brief Set an arbitrary channel as the error model of a gate of some owner.
+   * \param owner Owner to apply the gate.
+   * \param gate Name of the gate.
+   * \param opr Channel following the gate, on one qubit or on as many qubits as the gate.
+  */
+  void SetKrausModel (const std::string &owner, const std::string &gate,
+                      const QuantumOperation &opr);
+
+  /**
+   * \brief Apply the error model of a n-qubit gate.
+   *
+   * A single-qubit channel is not applied at once but composed with the next channel
+   * of the qubit, so that each qubit gets one channel tensor per interval between operations.
+   *
    * \param owner Owner applying the gate.
    * \param gate Name of the gate.
    * \param qubits Names of the qubits to which the gate is applied.
@@ -238,6 +438,21 @@ public:
       std::pair<std::string, std::string> conn,
       double fidel
   );
+
+  /**
+   * \brief Record the link table of a connection, and the depolarizing model of its fidelity.
+   * \param conn The two owners distributing some EPR pair.
+   * \param table Link table precomputed from the physical model of the connection.
+  */
+  void SetLinkTable (const std::pair<std::string, std::string> &conn,
+                     const QuantumLinkTable &table);
+
+  /**
+   * \brief Get the link table of a connection.
+   * \param conn The two owners distributing some EPR pair.
+   * \return The link table, or nullptr if the connection has no physical model.
+  */
+  const QuantumLinkTable *GetLinkTable (const std::pair<std::string, std::string> &conn) const;
   /**
    * \brief Apply a depolarizing model for some EPR distribution.
    * \param conn The two owners distributing the EPR pair.
@@ -255,7 +470,16 @@ public:
                      double rate
   );
   /**
-   * \brief Apply a time model for n qubits.
+   * \brief Set an amplitude damping model to the qubits of an owner, replacing its time model.
+   * \param owner Owner generating the qubits.
+   * \param t1 Relaxation time T1.
+   * \param rate Dephasing rate, or 0 if none.
+  */
+  void SetAmplitudeDampModel (const std::string &owner, double t1, double rate = 0.);
+
+  /**
+   * \brief Apply a time model for n qubits, composed with the pending gate error of each,
+   * as one channel of minimal Kraus rank per qubit.
    * \param qubits Names of the qubits.
    * \param moment Time of the appliance.
   */
@@ -263,6 +487,36 @@ public:
                         const Time &moment = Simulator::Now ());
 
 
+/* cutoff */
+
+  /**
+   * \brief Set the cutoff policy of an owner's quantum memory.
+   *
+   * A qubit staying in the memory for longer than the cutoff is traced out,
+   * which frees its slot, and the callback is notified with its name.
+   * The cutoff applies to the qubits entering the memory from now on.
+   *
+   * \param owner Owner of the quantum memory.
+   * \param cutoff Longest time a qubit may stay, or zero to keep the qubits forever.
+   * \param callback Callback notified of each discarded qubit, or a null callback.
+  */
+  void SetCutoff (const std::string &owner, const Time &cutoff,
+                  Callback<void, std::string> callback = MakeNullCallback<void, std::string> ());
+
+  /**
+   * \brief Start the cutoff timer of a qubit entering an owner's quantum memory.
+   * \param owner Owner of the quantum memory.
+   * \param qubit Name of the qubit.
+  */
+  void ArmCutoff (const std::string &owner, const std::string &qubit);
+
+  /**
+   * \brief Stop the cutoff timer of a qubit leaving its quantum memory.
+   * \param qubit Name of the qubit.
+  */
+  void DisarmCutoff (const std::string &qubit);
+
+
 /* util */
 
   void Evaluate ();
@@ -300,6 +554,86 @@ public:
 
   double CalculateFidelity (const std::pair<std::string, std::string> &epr, double &fidel);
 
+  /**
+   * \brief Evaluate a batch of fidelities and expectation values.
+   * \param requests Metrics to evaluate.
+   * \return Value of each metric.
+  */
+  std::vector<double> EvaluateMetrics (const std::vector<QuantumMetric> &requests);
+
+  /**
+   * \brief Calculate the fidelities of many EPR pairs to the bell state in one batch.
+   * \param eprs Names of the EPR pairs.
+   * \return The fidelity of each pair.
+  */
+  std::vector<double>
+  CalculateFidelities (const std::vector<std::pair<std::string, std::string>> &eprs);
+
+/* checkpoint */
+
+  /**
+   * \brief Fork an independent simulation from the current state, for what-if branches.
+   * 
+   * The fork copies the tensor network built so far, which takes time and memory linear
+   * in its number of tensors, but shares the ExaTN tensors with this entity, as they are
+   * never written once created, so the data of the operations applied before the fork is
+   * not copied. Cached and pending evaluations are not shared.
+   *
+   * The fork discards its qubits past their cutoffs silently, as it has no applications,
+   * and its nodes keep it alive until Simulator::Destroy, so a fork no longer needed
+   * must be disposed, which cancels its cutoffs.
+   * 
+   * \return The forked entity.
+  */
+  Ptr<QuantumPhyEntity> Fork () const;
+
+  /**
+   * \brief Save the state of the simulation to a binary checkpoint file.
+   * 
+   * The file holds the tensor network and the data of its tensors, the qubit maps,
+   * the owner and time relevant error model of each qubit, the age of each qubit
+   * since its last operation, and the time left before each armed cutoff.
+   * The cutoff policies and their callbacks are configured by the setup. The error models themselves are configured by the setup,
+   * and are bound again by their owners.
+   * 
+   * \param path Path of the checkpoint file.
+   * \return True if the checkpoint is written successfully.
+  */
+  bool SaveCheckpoint (const std::string &path);
+
+  /**
+   * \brief Restore the state of a simulation from a binary checkpoint file.
+   * 
+   * The entity must have the same owners as the saving one, and no qubit generated yet.
+   * The qubits keep their ages relative to the current simulated time,
+   * and their cutoffs are armed again with the time they had left.
+   * A checkpoint naming an unknown owner leaves the entity untouched,
+   * while a corrupt tensor network leaves it to be discarded.
+   * 
+   * \param path Path of the checkpoint file.
+   * \return True if the checkpoint is restored successfully.
+  */
+  bool LoadCheckpoint (const std::string &path);
+
+/* trace */
+
+  /**
+   * \brief Record every phy-level call to an operation trace, or stop recording.
+   * \param path Path of the trace file, or "" to stop recording.
+  */
+  void SetTraceFile (std::string path);
+
+  std::string GetTraceFile () const;
+
+  /**
+   * \brief Replay a recorded call on the simulator, without error models or access control.
+   * 
+   * A measurement replays its recorded outcome, so the replayed state follows the recording.
+   * 
+   * \param record The recorded call.
+  */
+  void Replay (const QuantumTraceRecord &record);
+
 /* util */
 
   /**
@@ -339,6 +673,42 @@ public:
   */
   void Checkpoint ();
 
+  /**
+   * \brief Set the default contraction sequence optimizer.
+   * \param optimizer One of "dummy", "heuro", "greed", "metis", "cutnn", "ascend" and "distill".
+  */
+  void SetOptimizer (std::string optimizer);
+
+  std::string GetOptimizer () const;
+
+  /**
+   * \brief Select the backend holding the density matrix, before any qubit is generated.
+   * \param backend Either "exatn" or "mps".
+  */
+  void SetBackend (std::string backend);
+
+  std::string GetBackend () const;
+
+  /**
+   * \brief Select the precision of the tensors, before any qubit is generated.
+   * \param precision Either "double" or "single".
+  */
+  void SetPrecision (std::string precision);
+
+  std::string GetPrecision () const;
+
+  /**
+   * \brief Get the truncation error incurred by the backend so far.
+   * \return The truncation error, which is 0 on the exact "exatn" backend.
+  */
+  double GetTruncationError () const;
+
+  /**
+   * \brief Get the statistics of the tensor network evaluations so far.
+   * \return The statistics, which stay zero on the "mps" backend.
+  */
+  QuantumEvalStats GetEvalStats () const;
+
 
 /* debug */
   
@@ -346,10 +716,89 @@ public:
 
 private:
 
+/* cutoff */
+
+  /**
+   * \brief Discard a qubit whose cutoff has passed, and notify its owner.
+  */
+  void ExpireQubit (const std::string &owner, const std::string &qubit);
+
+  /**
+   * \brief Arm the cutoff of a qubit restored into an owner's quantum memory, as in a fork
+   * or from a checkpoint, with the time it had left.
+   * \param qubit Name of the qubit, ignored if in no quantum memory.
+   * \param delay Time left before the qubit is discarded.
+  */
+  void RestoreCutoff (const std::string &qubit, const Time &delay);
+
+/* error */
+
+  /**
+   * \brief Apply the pending gate errors of some qubits, before their state is used.
+   *
+   * The time of each qubit is left at its last gate, so that reading the state
+   * does not skip the idling since then.
+   * \param qubits Names of the qubits.
+  */
+  void FlushErrorModel (const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Apply the pending gate errors of all the qubits.
+  */
+  void FlushErrorModel ();
+
+  /**
+   * \brief Fuse the channel of an error model into the diagonal of a qubit, if it is a dephasing
+   * and no other gate error of the qubit is pending, without building the channel.
+   * \param model Error model of the qubit.
+   * \param qubit Name of the qubit.
+   * \param moment Time of the appliance.
+   * \param idle Whether the channel is the idling of the qubit, which then restarts from now.
+   * \return True if fused, or else the channel is to be got by GetOperation.
+  */
+  bool FuseDephasing (const QuantumErrorModel &model, const std::string &qubit,
+                      const Time &moment, const bool &idle);
+
+/* trace */
+
+  /**
+   * \brief Append a record to the operation trace, if recording.
+  */
+  void Record (const QuantumTraceRecord &record);
+
+/* async */
+
+  void DeliverReducedDM (const unsigned &ticket,
+                         Callback<void, std::vector<std::complex<double>>> callback);
+  void DeliverFidelity (const unsigned &ticket, Callback<void, double> callback);
+  void DeliverContract (const unsigned &ticket,
+                        Callback<void, std::vector<std::complex<double>>> callback);
+
 /* circuit */
 
   /** Instance of a quantum network simulator. */
   QuantumNetworkSimulator m_qnetsim;
+
+  /** Number of tensors above which to compact, or 0 to disable. */
+  unsigned m_compact_tensors;
+
+  /** Simulated time between two compactions, or 0 to disable. */
+  Time m_compact_interval;
+
+  /** Maximum number of valid qubits in a component to contract during compaction. */
+  unsigned m_compact_max_qubits;
+
+  /** Time of the last compaction. */
+  Time m_last_compact;
+
+  /** Number of tensors left by the last compaction, which the next one waits to double. */
+  unsigned m_compact_left;
+
+  /** Path of the operation trace, or "" if not recording. */
+  std::string m_trace_file;
+
+  /** Writer of the operation trace, or nullptr if not recording. */
+  Ptr<QuantumTraceWriter> m_trace;
   
 
 
@@ -358,6 +807,18 @@ private:
   /** Map from owner name to the pointer to its quantum node. */
   std::map<std::string, Ptr<QuantumNode>> m_owner2pnode;
 
+  /** Owners with a handle, indexed by handle. */
+  std::vector<std::string> m_handle2owner;
+
+  /** Map from owner name to its handle. */
+  std::unordered_map<std::string, unsigned> m_owner2handle;
+
+  /** Buffers reused by every gate, holding the handles and the names of its qubits,
+   * and the diagonal of a fused dephasing. */
+  std::vector<unsigned> m_scratch_handles;
+  std::vector<std::string> m_scratch_qubits;
+  std::vector<std::complex<double>> m_scratch_diag;
+
   /** Map from quantum channel and a quantum application name
    * to the pointers to the applications. */
   std::map<QuantumChannel, std::map<std::string, std::pair<Ptr<Application>, Ptr<Application>>>>
@@ -379,9 +840,23 @@ private:
   std::map<Ptr<QuantumNode>, std::map<std::string, Ptr<QuantumErrorModel>>>
       m_gate2model;
 
+  /** Map from qubit name to the gate error not applied yet, to compose with its next channel. */
+  std::map<std::string, QuantumOperation> m_qubit2pending;
+
   /** Map from a quantum connection to its depolarizing error model. */
   std::map<std::pair<std::string, std::string>, Ptr<QuantumErrorModel>>
       m_conn2model;
+
+  /** Map from a quantum connection to its precomputed link table. */
+  std::map<std::pair<std::string, std::string>, QuantumLinkTable> m_conn2link;
+
+
+  /** Map from pointer to a quantum node (i.e. a owner)
+   * to the cutoff of its quantum memory, and the callback notified of each discarded qubit. */
+  std::map<Ptr<QuantumNode>, std::pair<Time, Callback<void, std::string>>> m_node2cutoff;
+
+  /** Map from qubit name to its pending cutoff event. */
+  std::map<std::string, EventId> m_qubit2cutoff;
 };
 
 } // namespace ns3
@@ -0,0 +1,225 @@
+#include "ns3/quantum-protocol.h"
+
+#include "ns3/quantum-basis.h"
+#include "ns3/quantum-phy-entity.h" // class QuantumPhyEntity
+#include "ns3/quantum-channel.h" // class QuantumChannel
+#include "ns3/distribute-epr-protocol.h" // class DistributeEPRSrcProtocol
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("QuantumProtocol");
+
+NS_OBJECT_ENSURE_REGISTERED (QuantumProtocol);
+
+QuantumProtocol::QuantumProtocol (Ptr<QuantumPhyEntity> qphyent_, const bool &adapt_)
+    : m_qphyent (qphyent_), m_adapt (adapt_), m_steps ({}), m_bits ({})
+{
+}
+
+QuantumProtocol::~QuantumProtocol ()
+{
+}
+
+QuantumProtocol::QuantumProtocol () : m_qphyent (nullptr), m_adapt (false), m_steps ({}), m_bits ({})
+{
+}
+
+TypeId
+QuantumProtocol::GetTypeId ()
+{
+  static TypeId tid =
+      TypeId ("ns3::QuantumProtocol")
+          .AddConstructor<QuantumProtocol> ()
+          .SetParent<Application> ()
+          .AddAttribute ("QPhyEntity", "The pointer to the quantum physical entity", PointerValue (),
+                         MakePointerAccessor (&QuantumProtocol::m_qphyent),
+                         MakePointerChecker<QuantumPhyEntity> ())
+          .AddAttribute ("Adapt", "Whether to compile into the control-flow adapted form",
+                         BooleanValue (false), MakeBooleanAccessor (&QuantumProtocol::m_adapt),
+                         MakeBooleanChecker ());
+  return tid;
+}
+
+void
+QuantumProtocol::AddGenerate (const Time &delay, const std::string &owner,
+                              const std::vector<std::complex<double>> &data,
+                              const std::vector<std::string> &qubits)
+{
+  m_steps.push_back ({GENERATE, delay, owner, "", data, qubits, {}, nullptr});
+}
+
+void
+QuantumProtocol::AddGate (const Time &delay, const std::string &owner, const std::string &gate,
+                          const std::vector<std::complex<double>> &data,
+                          const std::vector<std::string> &qubits)
+{
+  m_steps.push_back ({GATE, delay, owner, gate, data, qubits, {}, nullptr});
+}
+
+void
+QuantumProtocol::AddEPR (const Time &delay, Ptr<QuantumChannel> conn,
+                         const std::pair<std::string, std::string> &epr)
+{
+  m_steps.push_back ({EPR, delay, conn->GetSrcOwner (), "", {}, {epr.first, epr.second}, {}, conn});
+}
+
+void
+QuantumProtocol::AddMeasure (const Time &delay, const std::string &owner,
+                             const std::vector<std::string> &qubits,
+                             const std::vector<std::string> &bits)
+{
+  assert (qubits.size () == bits.size ());
+  m_steps.push_back ({MEASURE, delay, owner, "", {}, qubits, bits, nullptr});
+}
+
+void
+QuantumProtocol::AddConditionalGate (const Time &delay, const std::string &owner,
+                                     const std::string &gate,
+                                     const std::vector<std::complex<double>> &data,
+                                     const std::vector<std::string> &bits,
+                                     const std::vector<std::string> &qubits)
+{
+  m_steps.push_back ({COND_GATE, delay, owner, gate, data, qubits, bits, nullptr});
+}
+
+void
+QuantumProtocol::AddTrace (const Time &delay, const std::vector<std::string> &qubits)
+{
+  m_steps.push_back ({TRACE, delay, "", "", {}, qubits, {}, nullptr});
+}
+
+unsigned
+QuantumProtocol::GetBit (const std::string &bit) const
+{
+  assert (m_bits.find (bit) != m_bits.end ());
+  return m_bits.at (bit);
+}
+
+void
+QuantumProtocol::Compile ()
+{
+  NS_LOG_LOGIC ("Compiling " << m_steps.size () << " steps into the "
+                             << (m_adapt ? "adapted" : "faithful") << " form");
+
+  // in the adapted form, a measured qubit carries its register until the last conditional gate
+  std::map<std::string, std::string> qubit2bit = {};
+  std::map<std::string, Time> bit2last = {};
+  for (const Step &step : m_steps)
+    {
+      for (unsigned i = 0; step.kind == MEASURE && i < step.bits.size (); ++i)
+        {
+          qubit2bit[step.qubits[i]] = step.bits[i];
+        }
+      for (unsigned i = 0; step.kind == COND_GATE && i < step.bits.size (); ++i)
+        {
+          if (bit2last.find (step.bits[i]) == bit2last.end () || bit2last[step.bits[i]] < step.delay)
+            {
+              bit2last[step.bits[i]] = step.delay;
+            }
+        }
+    }
+  std::vector<std::pair<Time, std::string>> postponed = {};
+
+  for (unsigned idx = 0; idx < m_steps.size (); ++idx)
+    {
+      const Step &step = m_steps[idx];
+      switch (step.kind)
+        {
+        case GENERATE:
+          Simulator::Schedule (step.delay, &QuantumPhyEntity::GenerateQubitsPure, m_qphyent,
+                               step.owner, step.data, step.qubits);
+          break;
+        case GATE:
+          Simulator::Schedule (step.delay, &QuantumPhyEntity::ApplyGate, m_qphyent, step.owner,
+                               step.gate, step.data, step.qubits);
+          break;
+        case EPR: {
+          Ptr<DistributeEPRSrcProtocol> dist_epr_src_app =
+              m_qphyent->GetConn2Apps (step.conn, APP_DIST_EPR)
+                  .first->GetObject<DistributeEPRSrcProtocol> ();
+          Simulator::Schedule (step.delay, &DistributeEPRSrcProtocol::GenerateAndDistributeEPR,
+                               dist_epr_src_app,
+                               std::pair<std::string, std::string>{step.qubits[0], step.qubits[1]});
+          break;
+        }
+        case MEASURE:
+          if (m_adapt)
+            Simulator::Schedule (step.delay, &QuantumPhyEntity::MeasureToRegister, m_qphyent,
+                                 step.owner, step.qubits, step.bits);
+          else
+            Simulator::Schedule (step.delay, &QuantumProtocol::DoMeasure, this, idx);
+          break;
+        case COND_GATE:
+          if (m_adapt)
+            Simulator::Schedule (step.delay, &QuantumPhyEntity::ApplyClassicallyControlledGate,
+                                 m_qphyent, step.owner, step.gate, step.data, step.bits,
+                                 step.qubits);
+          else
+            Simulator::Schedule (step.delay, &QuantumProtocol::DoConditionalGate, this, idx);
+          break;
+        case TRACE: {
+          std::vector<std::string> traced = {};
+          for (const std::string &qubit : step.qubits)
+            {
+              auto it = qubit2bit.find (qubit);
+              if (m_adapt && it != qubit2bit.end () && bit2last.find (it->second) != bit2last.end () &&
+                  step.delay < bit2last[it->second])
+                {
+                  postponed.push_back ({bit2last[it->second], qubit});
+                  continue;
+                }
+              traced.push_back (qubit);
+            }
+          if (traced.size ())
+            Simulator::Schedule (step.delay, &QuantumPhyEntity::PartialTrace, m_qphyent, traced);
+          break;
+        }
+        }
+    }
+
+  // scheduled last, so that they follow the conditional gates at the same time
+  for (const auto &[delay, qubit] : postponed)
+    {
+      Simulator::Schedule (delay, &QuantumPhyEntity::PartialTrace, m_qphyent,
+                           std::vector<std::string>{qubit});
+    }
+}
+
+void
+QuantumProtocol::DoMeasure (const unsigned &idx)
+{
+  const Step &step = m_steps[idx];
+  std::pair<unsigned, std::vector<double>> outcome = m_qphyent->Measure (step.owner, step.qubits);
+  for (unsigned i = 0; i < step.bits.size (); ++i)
+    {
+      m_bits[step.bits[i]] = (outcome.first >> i) & 1;
+      NS_LOG_LOGIC ("     => bit " << step.bits[i] << " = " << m_bits[step.bits[i]]);
+    }
+}
+
+void
+QuantumProtocol::DoConditionalGate (const unsigned &idx)
+{
+  const Step &step = m_steps[idx];
+  for (const std::string &bit : step.bits)
+    {
+      if (GetBit (bit) != 1)
+        {
+          // the identity instead, charging the same gate error as the hand-written apps
+          for (const std::string &qubit : step.qubits)
+            {
+              m_qphyent->ApplyGate (step.owner, QNS_GATE_PREFIX + "I", {}, {qubit});
+            }
+          return;
+        }
+    }
+  m_qphyent->ApplyGate (step.owner, step.gate, step.data, step.qubits);
+}
+
+void
+QuantumProtocol::StartApplication ()
+{
+  Compile ();
+}
+
+} // namespace ns3
@@ -0,0 +1,153 @@
+#ifndef QUANTUM_PROTOCOL_H
+#define QUANTUM_PROTOCOL_H
+
+#include "ns3/application.h"
+
+#include <complex>
+#include <map>
+
+namespace ns3 {
+
+class QuantumPhyEntity;
+class QuantumChannel;
+
+/**
+ * \brief Protocol described once by its timed steps and compiled into one of two forms.
+ *
+ * A step is a generation, a gate, an EPR distribution, a measurement into named classical bits,
+ * a gate conditioned on classical bits, or a partial trace, each at a delay after the start.
+ *
+ * 1. The faithful form samples every measurement and applies a conditional gate
+ *    if all of its bits are 1, and the identity on its qubits otherwise,
+ *    as the hand-written baseline apps do.
+ * 2. The adapted (CFA) form measures into classical registers and applies every conditional gate
+ *    as a classically controlled one, integrating all the branches in a single round.
+ *
+ * Both forms schedule the steps at the same times and attribute the gate errors to the same owners.
+*/
+class QuantumProtocol : public Application
+{
+public:
+  QuantumProtocol (Ptr<QuantumPhyEntity> qphyent_, const bool &adapt_);
+  virtual ~QuantumProtocol ();
+
+  QuantumProtocol ();
+  static TypeId GetTypeId ();
+
+  /**
+   * \brief Add a generation of qubits.
+   * \param delay Delay since the start of the protocol.
+   * \param owner Owner generating the qubits.
+   * \param data State vector of the qubits.
+   * \param qubits Names of the qubits to generate.
+  */
+  void AddGenerate (const Time &delay, const std::string &owner,
+                    const std::vector<std::complex<double>> &data,
+                    const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Add a gate.
+   * \param delay Delay since the start of the protocol.
+   * \param owner Owner applying the gate.
+   * \param gate Name of the gate.
+   * \param data Data of the gate.
+   * \param qubits Names of the qubits to be applied on.
+  */
+  void AddGate (const Time &delay, const std::string &owner, const std::string &gate,
+                const std::vector<std::complex<double>> &data,
+                const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Add an EPR distribution over a quantum channel.
+   * \param delay Delay since the start of the protocol.
+   * \param conn Quantum channel with DistributeEPRApps installed.
+   * \param epr Names of the two qubits.
+  */
+  void AddEPR (const Time &delay, Ptr<QuantumChannel> conn,
+               const std::pair<std::string, std::string> &epr);
+
+  /**
+   * \brief Add a measurement.
+   * \param delay Delay since the start of the protocol.
+   * \param owner Owner measuring the qubits.
+   * \param qubits Names of the qubits to be measured.
+   * \param bits Names of the classical bits, one for each qubit.
+  */
+  void AddMeasure (const Time &delay, const std::string &owner,
+                   const std::vector<std::string> &qubits, const std::vector<std::string> &bits);
+
+  /**
+   * \brief Add a gate conditioned on classical bits.
+   * \param delay Delay since the start of the protocol, usually after the bits arrive.
+   * \param owner Owner applying the gate.
+   * \param gate Name of the gate.
+   * \param data Data of the gate.
+   * \param bits Names of the classical bits, all of which must be 1 for the gate to apply.
+   * \param qubits Names of the qubits to be applied on.
+  */
+  void AddConditionalGate (const Time &delay, const std::string &owner, const std::string &gate,
+                           const std::vector<std::complex<double>> &data,
+                           const std::vector<std::string> &bits,
+                           const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Add a partial trace.
+   * \param delay Delay since the start of the protocol.
+   * \param qubits Names of the qubits to be traced out.
+   *
+   * \note In the adapted form, tracing out a measured qubit is postponed
+   * after the last conditional gate on its bit.
+  */
+  void AddTrace (const Time &delay, const std::vector<std::string> &qubits);
+
+  /**
+   * \brief Get the value of a classical bit in the faithful form.
+   * \param bit Name of the bit.
+   * \return Value of the bit.
+  */
+  unsigned GetBit (const std::string &bit) const;
+
+private:
+  virtual void StartApplication ();
+
+  /** Kinds of steps in a protocol. */
+  enum StepKind
+  {
+    GENERATE,
+    GATE,
+    EPR,
+    MEASURE,
+    COND_GATE,
+    TRACE
+  };
+
+  /** A timed step in a protocol. */
+  struct Step
+  {
+    StepKind kind;
+    Time delay;
+    std::string owner;
+    std::string gate;
+    std::vector<std::complex<double>> data;
+    std::vector<std::string> qubits;
+    std::vector<std::string> bits;
+    Ptr<QuantumChannel> conn;
+  };
+
+  /**
+   * \brief Schedule all the steps in the faithful form or the adapted form.
+  */
+  void Compile ();
+
+  void DoMeasure (const unsigned &idx);
+  void DoConditionalGate (const unsigned &idx);
+
+  Ptr<QuantumPhyEntity> m_qphyent; /**< The quantum physical entity. */
+  bool m_adapt; /**< Whether to compile into the adapted form. */
+  std::vector<Step> m_steps; /**< Steps of the protocol. */
+  std::map<std::string, unsigned> m_bits; /**< Classical bits in the faithful form. */
+};
+
+} // namespace ns3
+
+#endif /* QUANTUM_PROTOCOL_H */
@@ -0,0 +1,464 @@
+#include "ns3/quantum-routing.h"
+
+#include "ns3/quantum-basis.h"
+#include "ns3/quantum-phy-entity.h" // class QuantumPhyEntity
+#include "ns3/quantum-node.h" // class QuantumNode
+#include "ns3/quantum-channel.h" // class QuantumChannel
+#include "ns3/distribute-epr-protocol.h" // class DistributeEPRSrcProtocol
+#include "ns3/ent-swap-helper.h" // class EntSwapSrcHelper, EntSwapDstHelper
+
+#include <algorithm>
+#include <queue>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("QuantumRouting");
+
+QuantumRouting::QuantumRouting (Ptr<QuantumPhyEntity> qphyent_)
+    : m_qphyent (qphyent_),
+      m_metric ("fidelity"),
+      m_owners ({}),
+      m_owner2idx ({}),
+      m_links ({}),
+      m_trees ({}),
+      m_paths ({}),
+      m_searches (0),
+      m_requests (0)
+{
+}
+
+QuantumRouting::~QuantumRouting ()
+{
+  m_trees.clear ();
+  m_paths.clear ();
+}
+
+QuantumRouting::QuantumRouting ()
+    : m_qphyent (nullptr),
+      m_metric ("fidelity"),
+      m_owners ({}),
+      m_owner2idx ({}),
+      m_links ({}),
+      m_trees ({}),
+      m_paths ({}),
+      m_searches (0),
+      m_requests (0)
+{
+}
+
+TypeId
+QuantumRouting::GetTypeId ()
+{
+  static TypeId tid =
+      TypeId ("ns3::QuantumRouting")
+          .SetParent<Object> ()
+          .AddConstructor<QuantumRouting> ()
+          .AddAttribute ("QPhyEntity", "The quantum physical entity", PointerValue (),
+                         MakePointerAccessor (&QuantumRouting::m_qphyent),
+                         MakePointerChecker<QuantumPhyEntity> ())
+          .AddAttribute ("Metric", "Either fidelity or hops, the quantity a route optimizes",
+                         StringValue ("fidelity"),
+                         MakeStringAccessor (&QuantumRouting::SetMetric,
+                                             &QuantumRouting::GetMetric),
+                         MakeStringChecker ());
+  return tid;
+}
+
+unsigned
+QuantumRouting::GetIndex (const std::string &owner)
+{
+  auto it = m_owner2idx.find (owner);
+  if (it != m_owner2idx.end ())
+    {
+      return it->second;
+    }
+  unsigned idx = m_owners.size ();
+  m_owners.push_back (owner);
+  m_owner2idx[owner] = idx;
+  m_links.push_back ({});
+  return idx;
+}
+
+double
+QuantumRouting::GetCost (const double &fidel) const
+{
+  double werner = (4. * fidel - 1.) / 3.;
+  if (werner <= 0.)
+    {
+      return INFINITY; // a fully depolarized link is of no use to any path
+    }
+  return m_metric == "hops" ? 1. : -std::log (werner);
+}
+
+void
+QuantumRouting::SetLink (const std::string &owner_a, const std::string &owner_b,
+                         const double &fidel, const double &rate)
+{
+  assert (owner_a != owner_b);
+  assert (0. <= fidel && fidel <= 1.);
+  unsigned a = GetIndex (owner_a);
+  unsigned b = GetIndex (owner_b);
+
+  double cost = GetCost (fidel);
+  auto it = m_links[a].find (b);
+  double old_cost = it == m_links[a].end () ? INFINITY : it->second.cost;
+  NS_LOG_LOGIC ("Setting link " << owner_a << " <--> " << owner_b << " of fidelity " << fidel
+                                << " and rate " << rate);
+
+  m_links[a][b] = {fidel, rate, cost};
+  m_links[b][a] = {fidel, rate, cost};
+  if (m_qphyent)
+    {
+      m_qphyent->SetDepolarModel ({owner_a, owner_b}, fidel);
+      m_qphyent->SetDepolarModel ({owner_b, owner_a}, fidel);
+    }
+
+  Invalidate (a, b, old_cost, cost);
+}
+
+void
+QuantumRouting::SetLink (Ptr<QuantumChannel> qconn)
+{
+  assert (m_qphyent);
+  QuantumLinkTable table = qconn->SetPhysicalModel (m_qphyent);
+  m_qphyent->SetLinkTable ({qconn->GetDstOwner (), qconn->GetSrcOwner ()}, table);
+  SetLink (qconn->GetSrcOwner (), qconn->GetDstOwner (), table.fidelity, table.rate);
+}
+
+void
+QuantumRouting::RemoveLink (const std::string &owner_a, const std::string &owner_b)
+{
+  auto it_a = m_owner2idx.find (owner_a);
+  auto it_b = m_owner2idx.find (owner_b);
+  if (it_a == m_owner2idx.end () || it_b == m_owner2idx.end ())
+    {
+      return;
+    }
+  unsigned a = it_a->second;
+  unsigned b = it_b->second;
+  auto it = m_links[a].find (b);
+  if (it == m_links[a].end ())
+    {
+      return;
+    }
+  NS_LOG_LOGIC ("Removing link " << owner_a << " <--> " << owner_b);
+
+  double old_cost = it->second.cost;
+  m_links[a].erase (b);
+  m_links[b].erase (a);
+
+  Invalidate (a, b, old_cost, INFINITY);
+}
+
+void
+QuantumRouting::Invalidate (const unsigned &a, const unsigned &b, const double &old_cost,
+                            const double &new_cost)
+{
+  if (new_cost == old_cost)
+    {
+      return;
+    }
+
+  if (new_cost > old_cost)
+    {
+      // only the trees and paths going through the link become longer
+      for (auto it = m_trees.begin (); it != m_trees.end ();)
+        {
+          const std::vector<int> &prev = it->second.prev;
+          bool used = (b < prev.size () && prev[b] == (int) a) ||
+                      (a < prev.size () && prev[a] == (int) b);
+          it = used ? m_trees.erase (it) : std::next (it);
+        }
+      for (auto it = m_paths.begin (); it != m_paths.end ();)
+        {
+          bool used = false;
+          for (const std::vector<unsigned> &path : it->second)
+            {
+              for (unsigned i = 0; i + 1 < path.size () && !used; ++i)
+                {
+                  used = (path[i] == a && path[i + 1] == b) || (path[i] == b && path[i + 1] == a);
+                }
+            }
+          it = used ? m_paths.erase (it) : std::next (it);
+        }
+    }
+  else
+    {
+      // only the trees the link can shorten change, while any k shortest paths may
+      for (auto it = m_trees.begin (); it != m_trees.end ();)
+        {
+          const std::vector<double> &dist = it->second.dist;
+          bool shorter = a >= dist.size () || b >= dist.size () ||
+                         dist[a] + new_cost < dist[b] || dist[b] + new_cost < dist[a];
+          it = shorter ? m_trees.erase (it) : std::next (it);
+        }
+      m_paths.clear ();
+    }
+}
+
+QuantumRouting::Tree
+QuantumRouting::Search (const unsigned &src, const int &dst,
+                        const std::vector<bool> &banned_nodes,
+                        const std::set<std::pair<unsigned, unsigned>> &banned_links)
+{
+  ++m_searches;
+  unsigned size = m_owners.size ();
+  Tree tree = {std::vector<double> (size, INFINITY), std::vector<int> (size, -1)};
+  tree.dist[src] = 0.;
+
+  using Entry = std::pair<double, unsigned>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+  heap.push ({0., src});
+  while (!heap.empty ())
+    {
+      auto [dist, u] = heap.top ();
+      heap.pop ();
+      if (dist > tree.dist[u])
+        {
+          continue; // a stale entry
+        }
+      if ((int) u == dst)
+        {
+          break;
+        }
+      for (const auto &[v, link] : m_links[u])
+        {
+          if ((!banned_nodes.empty () && banned_nodes[v]) ||
+              (!banned_links.empty () && banned_links.count ({u, v})))
+            {
+              continue;
+            }
+          double alt = dist + link.cost;
+          if (alt < tree.dist[v])
+            {
+              tree.dist[v] = alt;
+              tree.prev[v] = u;
+              heap.push ({alt, v});
+            }
+        }
+    }
+  return tree;
+}
+
+QuantumRoute
+QuantumRouting::MakeRoute (const std::vector<unsigned> &path) const
+{
+  QuantumRoute route = {{}, 1., INFINITY};
+  double werner = 1.;
+  for (unsigned i = 0; i < path.size (); ++i)
+    {
+      route.owners.push_back (m_owners[path[i]]);
+      if (i + 1 < path.size ())
+        {
+          const Link &link = m_links[path[i]].at (path[i + 1]);
+          werner *= (4. * link.fidel - 1.) / 3.;
+          route.rate = std::min (route.rate, link.rate);
+        }
+    }
+  route.fidelity = (3. * werner + 1.) / 4.;
+  return route;
+}
+
+QuantumRoute
+QuantumRouting::GetRoute (const std::string &src, const std::string &dst)
+{
+  auto it_s = m_owner2idx.find (src);
+  auto it_d = m_owner2idx.find (dst);
+  if (it_s == m_owner2idx.end () || it_d == m_owner2idx.end ())
+    {
+      return {{}, 0., 0.};
+    }
+  unsigned s = it_s->second;
+  unsigned d = it_d->second;
+
+  auto it = m_trees.find (s);
+  if (it == m_trees.end ())
+    {
+      NS_LOG_LOGIC ("Searching the shortest path tree of " << src);
+      it = m_trees.emplace (s, Search (s, -1, {}, {})).first;
+    }
+  const Tree &tree = it->second;
+  if (d >= tree.dist.size () || tree.dist[d] == INFINITY)
+    {
+      return {{}, 0., 0.};
+    }
+
+  std::vector<unsigned> path = {d};
+  while (path.back () != s)
+    {
+      path.push_back (tree.prev[path.back ()]);
+    }
+  std::reverse (path.begin (), path.end ());
+  return MakeRoute (path);
+}
+
+std::vector<QuantumRoute>
+QuantumRouting::GetRoutes (const std::string &src, const std::string &dst, const unsigned &k)
+{
+  std::vector<QuantumRoute> routes = {};
+  QuantumRoute best = GetRoute (src, dst);
+  if (best.owners.empty () || k == 0)
+    {
+      return routes;
+    }
+  unsigned s = m_owner2idx.at (src);
+  unsigned d = m_owner2idx.at (dst);
+
+  auto key = std::make_tuple (s, d, k);
+  auto it = m_paths.find (key);
+  if (it == m_paths.end ())
+    {
+      NS_LOG_LOGIC ("Searching the " << k << " shortest paths from " << src << " to " << dst);
+
+      auto cost_of = [this] (const std::vector<unsigned> &path) {
+        double cost = 0.;
+        for (unsigned i = 0; i + 1 < path.size (); ++i)
+          {
+            cost += m_links[path[i]].at (path[i + 1]).cost;
+          }
+        return cost;
+      };
+
+      // Yen's algorithm, deviating from each prefix of the last found path
+      std::vector<std::vector<unsigned>> found = {{}};
+      for (const std::string &owner : best.owners)
+        {
+          found[0].push_back (m_owner2idx.at (owner));
+        }
+      std::set<std::pair<double, std::vector<unsigned>>> candidates = {};
+      while (found.size () < k)
+        {
+          const std::vector<unsigned> last = found.back ();
+          for (unsigned j = 0; j + 1 < last.size (); ++j)
+            {
+              std::vector<unsigned> root (last.begin (), last.begin () + j + 1);
+              std::set<std::pair<unsigned, unsigned>> banned_links = {};
+              for (const std::vector<unsigned> &path : found)
+                {
+                  if (path.size () > j + 1 && std::equal (root.begin (), root.end (), path.begin ()))
+                    {
+                      banned_links.insert ({path[j], path[j + 1]});
+                    }
+                }
+              std::vector<bool> banned_nodes (m_owners.size (), false);
+              for (unsigned i = 0; i < j; ++i)
+                {
+                  banned_nodes[root[i]] = true;
+                }
+
+              Tree spur = Search (last[j], d, banned_nodes, banned_links);
+              if (spur.dist[d] == INFINITY)
+                {
+                  continue;
+                }
+              std::vector<unsigned> tail = {d};
+              while (tail.back () != last[j])
+                {
+                  tail.push_back (spur.prev[tail.back ()]);
+                }
+              root.insert (root.end (), tail.rbegin () + 1, tail.rend ());
+              candidates.insert ({cost_of (root), root});
+            }
+          if (candidates.empty ())
+            {
+              break;
+            }
+          found.push_back (candidates.begin ()->second);
+          candidates.erase (candidates.begin ());
+        }
+      it = m_paths.emplace (key, found).first;
+    }
+
+  for (const std::vector<unsigned> &path : it->second)
+    {
+      routes.push_back (MakeRoute (path));
+    }
+  return routes;
+}
+
+std::pair<std::string, std::string>
+QuantumRouting::InstallEntSwap (const QuantumRoute &route, const Time &start)
+{
+  const std::vector<std::string> &owners = route.owners;
+  assert (owners.size () >= 2);
+  assert (m_qphyent);
+  std::string request = "_R" + std::to_string (m_requests++);
+  unsigned hops = owners.size () - 1;
+
+  auto qubit_to = [&] (unsigned i) { return owners[i] + request + "_To" + owners[i + 1]; };
+  auto qubit_from = [&] (unsigned i) { return owners[i] + request + "_From" + owners[i - 1]; };
+
+  //
+  // Every owner but the last one generates and shares a EPR pair with the next
+  //
+  for (unsigned i = 0; i < hops; ++i)
+    {
+      Ptr<QuantumChannel> qconn = CreateObject<QuantumChannel> (owners[i], owners[i + 1]);
+      Ptr<DistributeEPRSrcProtocol> dist_epr_src_app =
+          m_qphyent->GetConn2Apps (qconn, APP_DIST_EPR)
+              .first->GetObject<DistributeEPRSrcProtocol> ();
+      Simulator::Schedule (start - Simulator::Now (),
+                           &DistributeEPRSrcProtocol::GenerateAndDistributeEPR, dist_epr_src_app,
+                           std::pair<std::string, std::string>{qubit_to (i), qubit_from (i + 1)});
+    }
+  if (hops == 1)
+    {
+      return {qubit_to (0), qubit_from (1)};
+    }
+
+  //
+  // The middle owners swap once their EPR pairs arrive, all before the last owner allocates its port
+  //
+  const std::string &dst = owners[hops];
+  for (unsigned i = 1; i < hops; ++i)
+    {
+      Ptr<QuantumChannel> qconn = CreateObject<QuantumChannel> (owners[i], dst);
+      EntSwapSrcHelper srcHelper (m_qphyent, qconn);
+      srcHelper.SetAttribute ("Qubits",
+                              PairValue<StringValue, StringValue> ({qubit_from (i), qubit_to (i)}));
+      ApplicationContainer srcApps = srcHelper.Install (m_qphyent->GetNode (owners[i]));
+      srcApps.Get (0)->SetStartTime (start + Seconds (TELEP_DELAY));
+      srcApps.Get (0)->SetStopTime (start + Seconds (2 * TELEP_DELAY));
+    }
+
+  EntSwapDstHelper dstHelper (m_qphyent, m_qphyent->GetNode (dst));
+  dstHelper.SetAttribute ("Qubit", StringValue (qubit_from (hops)));
+  dstHelper.SetAttribute ("Count", UintegerValue (hops - 1));
+  ApplicationContainer dstApps = dstHelper.Install (m_qphyent->GetNode (dst));
+  dstApps.Get (0)->SetStartTime (start);
+  dstApps.Get (0)->SetStopTime (start + Seconds (2 * TELEP_DELAY));
+
+  NS_LOG_INFO ("Installed entanglement swapping" << request << " from " << owners[0] << " to "
+                                                 << dst << " over " << hops << " hops");
+  return {qubit_to (0), qubit_from (hops)};
+}
+
+void
+QuantumRouting::SetMetric (std::string metric)
+{
+  assert (metric == "fidelity" || metric == "hops");
+  m_metric = metric;
+  for (std::map<unsigned, Link> &links : m_links)
+    {
+      for (auto &[v, link] : links)
+        {
+          link.cost = GetCost (link.fidel);
+        }
+    }
+  m_trees.clear ();
+  m_paths.clear ();
+}
+
+std::string
+QuantumRouting::GetMetric () const
+{
+  return m_metric;
+}
+
+uint64_t
+QuantumRouting::GetNumSearches () const
+{
+  return m_searches;
+}
+
+} // namespace ns3
@@ -0,0 +1,177 @@
+#ifndef QUANTUM_ROUTING_H
+#define QUANTUM_ROUTING_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+class QuantumPhyEntity;
+class QuantumChannel;
+
+/**
+ * \brief A swapping path between two owners.
+*/
+struct QuantumRoute
+{
+  std::vector<std::string> owners; /**< Owners along the path, or empty if unreachable. */
+  double fidelity; /**< Fidelity of the EPR pair after swapping along the path. */
+  double rate; /**< Rate of the path, bounded by its slowest link. */
+};
+
+/**
+ * \brief Entanglement routing over a graph of links between owners.
+ *
+ * Each link has the fidelity of the EPR pairs it distributes and their rate.
+ * Swapping two Werner pairs multiplies their Werner parameters w = (4F - 1) / 3,
+ * so the path of maximum fidelity is the shortest path under the link cost -log w.
+ *
+ * The shortest path tree of each source is computed once and serves every request from it,
+ * and the k shortest paths between two owners are cached as well.
+ * A changed link only invalidates the trees and paths it may change:
+ * a worse link those going through it, and a better link those it can shorten.
+*/
+class QuantumRouting : public Object
+{
+public:
+  QuantumRouting (Ptr<QuantumPhyEntity> qphyent_);
+  ~QuantumRouting ();
+
+  QuantumRouting ();
+  static TypeId GetTypeId ();
+
+  /**
+   * \brief Add or update a link, and its depolarizing model in both directions.
+   * \param owner_a One end of the link.
+   * \param owner_b The other end of the link.
+   * \param fidel Fidelity of the EPR pairs distributed over the link.
+   * \param rate Rate of the EPR pairs distributed over the link.
+  */
+  void SetLink (const std::string &owner_a, const std::string &owner_b, const double &fidel,
+                const double &rate);
+
+  /**
+   * \brief Add or update a link from the physical model of a channel, in both directions.
+   * \param qconn Channel whose link table gives the fidelity and the rate of the link.
+  */
+  void SetLink (Ptr<QuantumChannel> qconn);
+
+  /**
+   * \brief Remove a link.
+   * \param owner_a One end of the link.
+   * \param owner_b The other end of the link.
+  */
+  void RemoveLink (const std::string &owner_a, const std::string &owner_b);
+
+  /**
+   * \brief Get the best path between two owners.
+   * \param src Source owner.
+   * \param dst Destination owner.
+   * \return The path of maximum fidelity, or of the fewest hops under the "hops" metric.
+  */
+  QuantumRoute GetRoute (const std::string &src, const std::string &dst);
+
+  /**
+   * \brief Get the k best loopless paths between two owners, by Yen's algorithm.
+   * \param src Source owner.
+   * \param dst Destination owner.
+   * \param k Number of paths.
+   * \return At most k paths, the best first.
+  */
+  std::vector<QuantumRoute> GetRoutes (const std::string &src, const std::string &dst,
+                                       const unsigned &k);
+
+  /**
+   * \brief Distribute an EPR pair over each link of a path and swap them at the middle owners.
+   *
+   * The EPR pairs are distributed at start, the middle owners run an EntSwapSrcApp
+   * after DIST_EPR_DELAY, and the destination runs an EntSwapDstApp correcting its qubit.
+   *
+   * \param route Path of at least two owners.
+   * \param start Time to start.
+   * \return Names of the qubits of the source and the destination sharing the EPR pair.
+  */
+  std::pair<std::string, std::string> InstallEntSwap (const QuantumRoute &route,
+                                                      const Time &start);
+
+  void SetMetric (std::string metric);
+  std::string GetMetric () const;
+
+  /**
+   * \brief Get the number of shortest path searches so far, which the caches keep low.
+   * \return Number of searches.
+  */
+  uint64_t GetNumSearches () const;
+
+private:
+  /** A link of the graph. */
+  struct Link
+  {
+    double fidel;
+    double rate;
+    double cost; /**< -log w, or 1 under the "hops" metric. */
+  };
+
+  /** Shortest path tree of a source. */
+  struct Tree
+  {
+    std::vector<double> dist;
+    std::vector<int> prev;
+  };
+
+  /**
+   * \brief Get the index of an owner, adding it to the graph if absent.
+  */
+  unsigned GetIndex (const std::string &owner);
+
+  /**
+   * \brief Calculate the cost of a link under the current metric.
+  */
+  double GetCost (const double &fidel) const;
+
+  /**
+   * \brief Search the shortest paths from a source by Dijkstra's algorithm.
+   * \param src Index of the source.
+   * \param dst Index of the destination to stop at, or -1 to search all.
+   * \param banned_nodes Owners to avoid.
+   * \param banned_links Links to avoid, directed.
+   * \return The shortest path tree.
+  */
+  Tree Search (const unsigned &src, const int &dst, const std::vector<bool> &banned_nodes,
+               const std::set<std::pair<unsigned, unsigned>> &banned_links);
+
+  /**
+   * \brief Build the route of a path of owner indices.
+  */
+  QuantumRoute MakeRoute (const std::vector<unsigned> &path) const;
+
+  /**
+   * \brief Drop the cached trees and paths that a link changing from old_cost to new_cost
+   * may change, where a missing link costs INFINITY.
+  */
+  void Invalidate (const unsigned &a, const unsigned &b, const double &old_cost,
+                   const double &new_cost);
+
+  Ptr<QuantumPhyEntity> m_qphyent;
+  std::string m_metric; /**< Either "fidelity" or "hops". */
+
+  std::vector<std::string> m_owners; /**< Owner of each index. */
+  std::unordered_map<std::string, unsigned> m_owner2idx;
+  std::vector<std::map<unsigned, Link>> m_links; /**< Adjacency of each owner. */
+
+  std::unordered_map<unsigned, Tree> m_trees; /**< Cached shortest path tree of each source. */
+  std::map<std::tuple<unsigned, unsigned, unsigned>, std::vector<std::vector<unsigned>>>
+      m_paths; /**< Cached k shortest paths of each source, destination and k. */
+  uint64_t m_searches;
+  unsigned m_requests; /**< Number of installed swapping paths, naming their qubits. */
+};
+
+} // namespace ns3
+
+#endif /* QUANTUM_ROUTING_H */
@@ -0,0 +1,192 @@
+#include "ns3/quantum-trace.h" // class QuantumTraceWriter, QuantumTraceReader
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("QuantumTrace");
+
+NS_OBJECT_ENSURE_REGISTERED (QuantumTraceWriter);
+NS_OBJECT_ENSURE_REGISTERED (QuantumTraceReader);
+
+static void
+WriteNames (std::ostream &out, const std::vector<std::string> &names)
+{
+  WriteBinary<uint32_t> (out, names.size ());
+  for (const std::string &name : names)
+    {
+      WriteBinary (out, name);
+    }
+}
+
+static std::vector<std::string>
+ReadNames (std::istream &in)
+{
+  std::vector<std::string> names (ReadBinary<uint32_t> (in));
+  for (std::string &name : names)
+    {
+      name = ReadBinaryString (in);
+    }
+  return names;
+}
+
+QuantumTraceWriter::QuantumTraceWriter (const std::string &path,
+                                        const std::vector<std::string> &owners)
+    : m_out (path, std::ios::binary), m_num_records (0)
+{
+  if (! m_out)
+    {
+      NS_LOG_WARN ("Cannot open " << path << " to record a trace");
+      return;
+    }
+  m_out.write (QNS_TRACE_MAGIC.data (), QNS_TRACE_MAGIC.size ());
+  WriteNames (m_out, owners);
+  NS_LOG_INFO ("Recording a trace to " << path);
+}
+
+QuantumTraceWriter::~QuantumTraceWriter ()
+{
+  NS_LOG_INFO ("Recorded " << m_num_records << " records");
+}
+
+QuantumTraceWriter::QuantumTraceWriter () : m_num_records (0)
+{
+}
+
+TypeId
+QuantumTraceWriter::GetTypeId ()
+{
+  static TypeId tid =
+      TypeId ("ns3::QuantumTraceWriter").SetParent<Object> ().AddConstructor<QuantumTraceWriter> ();
+  return tid;
+}
+
+void
+QuantumTraceWriter::Write (QuantumTraceRecord record)
+{
+  if (! m_out)
+    {
+      return;
+    }
+  record.time = Simulator::Now ().GetTimeStep ();
+
+  WriteBinary<uint8_t> (m_out, record.kind);
+  WriteBinary<int64_t> (m_out, record.time);
+  WriteBinary (m_out, record.owner);
+  WriteBinary (m_out, record.name);
+  WriteNames (m_out, record.qubits);
+  WriteNames (m_out, record.args);
+  WriteBinary<uint32_t> (m_out, record.data.size ());
+  for (const std::vector<std::complex<double>> &data : record.data)
+    {
+      WriteBinary (m_out, data);
+    }
+  WriteBinary<uint32_t> (m_out, record.values.size ());
+  for (const unsigned &value : record.values)
+    {
+      WriteBinary<uint32_t> (m_out, value);
+    }
+  ++m_num_records;
+}
+
+uint64_t
+QuantumTraceWriter::GetNumRecords () const
+{
+  return m_num_records;
+}
+
+QuantumTraceReader::QuantumTraceReader (const std::string &path)
+    : m_in (path, std::ios::binary), m_valid (false), m_owners ({})
+{
+  std::string magic (QNS_TRACE_MAGIC.size (), '\0');
+  if (! m_in.read (&magic[0], magic.size ()) || magic != QNS_TRACE_MAGIC)
+    {
+      NS_LOG_WARN (path << " is not an operation trace");
+      return;
+    }
+  m_owners = ReadNames (m_in);
+  m_valid = bool (m_in);
+}
+
+QuantumTraceReader::~QuantumTraceReader ()
+{
+}
+
+QuantumTraceReader::QuantumTraceReader () : m_valid (false), m_owners ({})
+{
+}
+
+TypeId
+QuantumTraceReader::GetTypeId ()
+{
+  static TypeId tid =
+      TypeId ("ns3::QuantumTraceReader").SetParent<Object> ().AddConstructor<QuantumTraceReader> ();
+  return tid;
+}
+
+bool
+QuantumTraceReader::IsValid () const
+{
+  return m_valid;
+}
+
+const std::vector<std::string> &
+QuantumTraceReader::GetOwners () const
+{
+  return m_owners;
+}
+
+bool
+QuantumTraceReader::Read (QuantumTraceRecord &record)
+{
+  if (! m_valid || m_in.peek () == std::char_traits<char>::eof ())
+    {
+      return false;
+    }
+  record.kind = QuantumTraceRecord::Kind (ReadBinary<uint8_t> (m_in));
+  record.time = ReadBinary<int64_t> (m_in);
+  record.owner = ReadBinaryString (m_in);
+  record.name = ReadBinaryString (m_in);
+  record.qubits = ReadNames (m_in);
+  record.args = ReadNames (m_in);
+  record.data.resize (ReadBinary<uint32_t> (m_in));
+  for (std::vector<std::complex<double>> &data : record.data)
+    {
+      data = ReadBinaryComplex (m_in);
+    }
+  record.values.resize (ReadBinary<uint32_t> (m_in));
+  for (unsigned &value : record.values)
+    {
+      value = ReadBinary<uint32_t> (m_in);
+    }
+  if (! m_in)
+    {
+      NS_LOG_WARN ("The trace is truncated");
+      m_valid = false;
+    }
+  return m_valid;
+}
+
+std::string
+GetTraceKindName (const QuantumTraceRecord::Kind &kind)
+{
+  static const std::vector<std::string> names = {"GeneratePure",
+                                                  "GenerateMixed",
+                                                  "Gate",
+                                                  "Operation",
+                                                  "ControlledOperation",
+                                                  "Measure",
+                                                  "MeasureBatch",
+                                                  "MeasureToRegister",
+                                                  "ClassicallyControlledGate",
+                                                  "Sample",
+                                                  "PeekBranches",
+                                                  "PeekDM",
+                                                  "PartialTrace",
+                                                  "Contract",
+                                                  "Checkpoint",
+                                                  "Compact",
+                                                  "Fidelity",
+                                                  "Metrics"};
+  return kind < names.size () ? names[kind] : "Unknown";
+}
+
+} // namespace ns3
@@ -0,0 +1,128 @@
+#ifndef QUANTUM_TRACE_H
+#define QUANTUM_TRACE_H
+
+#include "ns3/object.h"
+
+#include "ns3/quantum-basis.h"
+
+#include <fstream>
+
+namespace ns3 {
+
+/**
+ * \brief A phy-level call recorded in an operation trace.
+ *
+ * The fields used by each kind are listed next to it.
+ * Error models show up as the operations they apply, so a trace replays without them.
+*/
+struct QuantumTraceRecord
+{
+  /** Kinds of records. */
+  enum Kind : uint8_t
+  {
+    GENERATE_PURE, /**< owner, qubits, data = {state vector} */
+    GENERATE_MIXED, /**< owner, qubits, data = {density matrix} */
+    GATE, /**< owner, name = gate, qubits, data = {gate} */
+    OPERATION, /**< qubits, data = Kraus operators */
+    CONTROLLED_OPERATION, /**< owner, name = gate, qubits = targets, args = controls, data = {gate} */
+    MEASURE, /**< owner, qubits, values = {outcome} */
+    MEASURE_BATCH, /**< args = owners, qubits, values = {size, outcome} of each request */
+    MEASURE_TO_REGISTER, /**< owner, qubits, args = registers */
+    CLASSICALLY_CONTROLLED_GATE, /**< owner, name = gate, qubits = targets, args = registers, data = {gate} */
+    SAMPLE, /**< owner, qubits, args = kept qubits, values = {shots} */
+    PEEK_BRANCHES, /**< owner, qubits, args = registers */
+    PEEK_DM, /**< owner, qubits */
+    PARTIAL_TRACE, /**< qubits */
+    CONTRACT, /**< name = optimizer */
+    CHECKPOINT, /**< nothing */
+    COMPACT, /**< values = {max qubits} */
+    FIDELITY, /**< qubits = EPR pair */
+    METRICS /**< qubits, args = Pauli strings, data = targets, values = {kind, size} of each request */
+  };
+
+  Kind kind;
+  std::string owner = ""; /**< Owner making the call. */
+  std::string name = ""; /**< Name of the gate, or the optimizer. */
+  std::vector<std::string> qubits = {}; /**< Names of the qubits. */
+  std::vector<std::string> args = {}; /**< Names of the other qubits, registers or owners. */
+  std::vector<std::vector<std::complex<double>>> data = {}; /**< States, gates or Kraus operators. */
+  std::vector<unsigned> values = {}; /**< Sampled outcomes and other integers. */
+  int64_t time = 0; /**< Simulated time of the call, in time steps. */
+};
+
+/**
+ * \brief Writer of a compact binary operation trace, started by the owners of the entity.
+*/
+class QuantumTraceWriter : public Object
+{
+public:
+  QuantumTraceWriter (const std::string &path, const std::vector<std::string> &owners);
+  ~QuantumTraceWriter ();
+
+  QuantumTraceWriter ();
+  static TypeId GetTypeId ();
+
+  /**
+   * \brief Append a record to the trace.
+   * \param record The record, stamped with the current simulated time.
+  */
+  void Write (QuantumTraceRecord record);
+
+  /**
+   * \brief Get the number of records written so far.
+   * \return Number of records.
+  */
+  uint64_t GetNumRecords () const;
+
+private:
+  std::ofstream m_out; /**< Trace file. */
+  uint64_t m_num_records; /**< Number of records written so far. */
+};
+
+/**
+ * \brief Reader of an operation trace written by QuantumTraceWriter.
+*/
+class QuantumTraceReader : public Object
+{
+public:
+  QuantumTraceReader (const std::string &path);
+  ~QuantumTraceReader ();
+
+  QuantumTraceReader ();
+  static TypeId GetTypeId ();
+
+  /**
+   * \brief Check if the trace was opened successfully.
+   * \return True if the file exists and starts with QNS_TRACE_MAGIC.
+  */
+  bool IsValid () const;
+
+  /**
+   * \brief Get the owners of the recording entity.
+   * \return Names of the owners.
+  */
+  const std::vector<std::string> &GetOwners () const;
+
+  /**
+   * \brief Read the next record.
+   * \param record Record to store the result.
+   * \return False at the end of the trace.
+  */
+  bool Read (QuantumTraceRecord &record);
+
+private:
+  std::ifstream m_in; /**< Trace file. */
+  bool m_valid; /**< Whether the header was read successfully. */
+  std::vector<std::string> m_owners; /**< Owners of the recording entity. */
+};
+
+/**
+ * \brief Get the name of a kind of records, for reports.
+ * \param kind Kind of records.
+ * \return Name of the kind.
+*/
+std::string GetTraceKindName (const QuantumTraceRecord::Kind &kind);
+
+} // namespace ns3
+
+#endif /* QUANTUM_TRACE_H */
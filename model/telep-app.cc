@@ -155,16 +155,17 @@ TelepSrcApp::SendPacket (Ptr<Packet> packet, Ipv6Address destination, uint16_t p
 void
 TelepSrcApp::MeasureAndSend ()
 {
-  std::pair<unsigned, std::vector<double>> outcome_Q0 =
-      m_qphyent->Measure (m_conn->GetSrcOwner (), {m_qubits.first});
+  // bell measurement in one go, bit 0 on the former qubit and bit 1 on the latter
+  std::pair<unsigned, std::vector<double>> outcome =
+      m_qphyent->Measure (m_conn->GetSrcOwner (), {m_qubits.first, m_qubits.second});
+  unsigned outcome_Q0 = outcome.first & 1;
+  unsigned outcome_Q1 = (outcome.first >> 1) & 1;
   NS_LOG_LOGIC ("     => " << m_conn->GetSrcOwner ()
-                           << "'s former qubit is measured to outcome-0 = " << outcome_Q0.first);
-  std::pair<unsigned, std::vector<double>> outcome_Q1 =
-      m_qphyent->Measure (m_conn->GetSrcOwner (), {m_qubits.second});
+                           << "'s former qubit is measured to outcome-0 = " << outcome_Q0);
   NS_LOG_LOGIC ("     => " << m_conn->GetSrcOwner ()
-                           << "'s latter qubit is measured to outcome-1 = " << outcome_Q1.first);
+                           << "'s latter qubit is measured to outcome-1 = " << outcome_Q1);
 
-  std::string outcomes_send = std::to_string (outcome_Q0.first) + std::to_string (outcome_Q1.first);
+  std::string outcomes_send = std::to_string (outcome_Q0) + std::to_string (outcome_Q1);
   SetFill ((uint8_t *) &outcomes_send[0], 3, 1024);
 
   Ptr<Packet> p;
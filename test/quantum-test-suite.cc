@@ -2,10 +2,15 @@
 
 // Include a header file from your module to test.
 #include "ns3/quantum-basis.h"
+#include "ns3/quantum-memory.h"
+#include "ns3/quantum-operation.h"
+#include "ns3/quantum-routing.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
 
+#include <algorithm>
+
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
@@ -46,6 +51,551 @@ QuantumBasisTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+/** Largest difference between the entries of two matrices of the same size. */
+static double
+MaxDiff (const std::vector<std::complex<double>> &a, const std::vector<std::complex<double>> &b)
+{
+  double diff = a.size () == b.size () ? 0. : 1.;
+  for (unsigned i = 0; i < std::min (a.size (), b.size ()); ++i)
+    {
+      diff = std::max (diff, std::abs (a[i] - b[i]));
+    }
+  return diff;
+}
+
+// Pauli channels compose in closed form, as their Kraus operators do
+class QuantumPauliChannelTestCase : public TestCase
+{
+public:
+  QuantumPauliChannelTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QuantumPauliChannelTestCase::QuantumPauliChannelTestCase ()
+  : TestCase ("PauliChannel and its composition in closed form")
+{
+}
+
+void
+QuantumPauliChannelTestCase::DoRun (void)
+{
+  QuantumOperation first = PauliChannel (0.1, 0.02, 0.05);
+  QuantumOperation second = PauliChannel (0.03, 0., 0.2);
+  NS_TEST_ASSERT_MSG_EQ (first.getSize (), 4u, "PauliChannel keeps I, X, Y and Z");
+  NS_TEST_ASSERT_MSG_EQ (second.getSize (), 3u, "PauliChannel drops the Y of zero probability");
+  NS_TEST_ASSERT_MSG_EQ (first.isPauli (), true, "PauliChannel is a Pauli channel");
+  NS_TEST_ASSERT_MSG_EQ (IsTracePreserving (first.getOprs ()), true,
+                         "PauliChannel preserves the trace");
+
+  // I, X, Y, Z multiply as the XOR of their indices
+  const double p[4] = {0.83, 0.1, 0.02, 0.05};
+  const double q[4] = {0.77, 0.03, 0., 0.2};
+  double expected[4] = {0., 0., 0., 0.};
+  for (unsigned i = 0; i < 4; ++i)
+    {
+      for (unsigned j = 0; j < 4; ++j)
+        {
+          expected[i ^ j] += p[i] * q[j];
+        }
+    }
+  QuantumOperation composed = Compose (first, second);
+  NS_TEST_ASSERT_MSG_EQ (composed.isPauli (), true, "Composed Pauli channels stay Pauli");
+  const std::vector<std::string> names = {"I", "PX", "PY", "PZ"};
+  double total = 0.;
+  for (unsigned k = 0; k < composed.getSize (); ++k)
+    {
+      unsigned idx = std::find (names.begin (), names.end (), composed.getName (k)) - names.begin ();
+      NS_TEST_ASSERT_MSG_LT (idx, 4u, "Composed Pauli channel names an unknown Pauli");
+      NS_TEST_ASSERT_MSG_EQ_TOL (composed.getProb (k), expected[idx], 1e-12,
+                                 "Wrong probability of " << names[idx]);
+      total += composed.getProb (k);
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (total, 1., 1e-12, "Composed probabilities do not sum to 1");
+
+  // the same operators, unnamed, go through the general product of Kraus operators
+  QuantumOperation general = Compose (QuantumOperation (first.getOprs ()),
+                                      QuantumOperation (second.getOprs ()));
+  NS_TEST_ASSERT_MSG_EQ_TOL (MaxDiff (general.getChoi (), composed.getChoi ()), 0., 1e-9,
+                             "Closed form differs from the product of Kraus operators");
+}
+
+// ReduceKraus keeps the channel and drops the redundant Kraus operators
+class QuantumReduceKrausTestCase : public TestCase
+{
+public:
+  QuantumReduceKrausTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QuantumReduceKrausTestCase::QuantumReduceKrausTestCase ()
+  : TestCase ("ReduceKraus to the minimal Kraus rank")
+{
+}
+
+void
+QuantumReduceKrausTestCase::DoRun (void)
+{
+  // each operator of an amplitude damping split in two halves of equal weight
+  QuantumOperation damping = AmplitudeDamping (0.3);
+  std::vector<std::vector<std::complex<double>>> kraus = {};
+  for (const std::vector<std::complex<double>> &op : damping.getOprs ())
+    {
+      kraus.push_back (std::sqrt (0.5) * op);
+      kraus.push_back (std::sqrt (0.5) * op);
+    }
+  QuantumOperation redundant (kraus);
+  QuantumOperation reduced = ReduceKraus (redundant);
+  NS_TEST_ASSERT_MSG_EQ (reduced.getSize (), 2u, "Amplitude damping is of Kraus rank 2");
+  NS_TEST_ASSERT_MSG_EQ (IsTracePreserving (reduced.getOprs ()), true,
+                         "Reduced operation does not preserve the trace");
+  NS_TEST_ASSERT_MSG_EQ_TOL (MaxDiff (reduced.getChoi (), redundant.getChoi ()), 0., 1e-9,
+                             "Reduced operation is another channel");
+
+  // a minimal operation comes back as it is
+  QuantumOperation minimal = ReduceKraus (damping);
+  NS_TEST_ASSERT_MSG_EQ (minimal.getSize (), damping.getSize (), "Minimal rank is reduced");
+}
+
+// EigenHermitian diagonalizes by a unitary
+class QuantumEigenHermitianTestCase : public TestCase
+{
+public:
+  QuantumEigenHermitianTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QuantumEigenHermitianTestCase::QuantumEigenHermitianTestCase ()
+  : TestCase ("EigenHermitian of a complex Hermitian matrix")
+{
+}
+
+void
+QuantumEigenHermitianTestCase::DoRun (void)
+{
+  std::vector<double> evals = {};
+  std::vector<std::complex<double>> evecs = {};
+  EigenHermitian (pauli_Y, evals, evecs);
+  NS_TEST_ASSERT_MSG_EQ (evals.size (), 2u, "Pauli Y has two eigenvalues");
+  NS_TEST_ASSERT_MSG_EQ_TOL (std::min (evals[0], evals[1]), -1., 1e-12, "Wrong eigenvalue");
+  NS_TEST_ASSERT_MSG_EQ_TOL (std::max (evals[0], evals[1]), 1., 1e-12, "Wrong eigenvalue");
+
+  const unsigned dim = 4;
+  const std::vector<std::complex<double>> data = {
+      {2., 0.},  {0.5, 1.},   {0., -0.3}, {1., 0.},
+      {0.5, -1.}, {-1., 0.},  {0.2, 0.2}, {0., 0.7},
+      {0., 0.3},  {0.2, -0.2}, {0.5, 0.}, {-0.4, 0.},
+      {1., 0.},   {0., -0.7}, {-0.4, 0.}, {3., 0.}};
+  EigenHermitian (data, evals, evecs);
+  NS_TEST_ASSERT_MSG_EQ (evals.size (), dim, "Wrong number of eigenvalues");
+  for (unsigned r = 0; r < dim; ++r)
+    {
+      for (unsigned c = 0; c < dim; ++c)
+        {
+          std::complex<double> gram = 0.0;
+          std::complex<double> rebuilt = 0.0;
+          for (unsigned k = 0; k < dim; ++k)
+            {
+              gram += std::conj (evecs[k * dim + r]) * evecs[k * dim + c];
+              rebuilt += evecs[r * dim + k] * evals[k] * std::conj (evecs[c * dim + k]);
+            }
+          NS_TEST_ASSERT_MSG_EQ_TOL (std::abs (gram - (r == c ? 1. : 0.)), 0., 1e-9,
+                                     "Eigenvectors are not orthonormal");
+          NS_TEST_ASSERT_MSG_EQ_TOL (std::abs (rebuilt - data[r * dim + c]), 0., 1e-9,
+                                     "V diag (evals) V^dagger is not the matrix");
+        }
+    }
+}
+
+// Amplitude damping preserves the trace, and two of them compose into one
+class QuantumAmplitudeDampingTestCase : public TestCase
+{
+public:
+  QuantumAmplitudeDampingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QuantumAmplitudeDampingTestCase::QuantumAmplitudeDampingTestCase ()
+  : TestCase ("AmplitudeDamping preserves the trace and composes")
+{
+}
+
+void
+QuantumAmplitudeDampingTestCase::DoRun (void)
+{
+  for (const double &gamma : {0., 0.1, 0.5, 1.})
+    {
+      NS_TEST_ASSERT_MSG_EQ (IsTracePreserving (AmplitudeDamping (gamma).getOprs ()), true,
+                             "AmplitudeDamping (" << gamma << ") does not preserve the trace");
+      NS_TEST_ASSERT_MSG_EQ (
+          IsTracePreserving (GeneralizedAmplitudeDamping (gamma, 0.7).getOprs ()), true,
+          "GeneralizedAmplitudeDamping (" << gamma << ", 0.7) does not preserve the trace");
+    }
+  NS_TEST_ASSERT_MSG_EQ (AmplitudeDamping (0.).isIdentity (), true,
+                         "AmplitudeDamping (0) is not the identity");
+
+  // the survival probabilities multiply
+  QuantumOperation composed = Compose (AmplitudeDamping (0.2), AmplitudeDamping (0.4));
+  QuantumOperation expected = AmplitudeDamping (1. - 0.8 * 0.6);
+  NS_TEST_ASSERT_MSG_EQ (composed.getSize (), 2u, "Composed damping is of Kraus rank 2");
+  NS_TEST_ASSERT_MSG_EQ_TOL (MaxDiff (composed.getChoi (), expected.getChoi ()), 0., 1e-9,
+                             "Composed damping differs from a single one");
+}
+
+/** Links between owners, with their fidelity and rate. */
+typedef std::map<std::pair<std::string, std::string>, std::pair<double, double>> LinkMap;
+
+/** A routing of the links without any cached search, to compare the cached routes with. */
+static Ptr<QuantumRouting>
+MakeRouting (const LinkMap &links)
+{
+  Ptr<QuantumRouting> routing = CreateObject<QuantumRouting> ();
+  for (const auto &[owners, link] : links)
+    {
+      routing->SetLink (owners.first, owners.second, link.first, link.second);
+    }
+  return routing;
+}
+
+/** Whether two lists of routes are the same paths of the same fidelities. */
+static bool
+SameRoutes (const std::vector<QuantumRoute> &a, const std::vector<QuantumRoute> &b)
+{
+  if (a.size () != b.size ())
+    {
+      return false;
+    }
+  for (unsigned i = 0; i < a.size (); ++i)
+    {
+      if (a[i].owners != b[i].owners || std::abs (a[i].fidelity - b[i].fidelity) > 1e-12)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+// GetRoute swaps over the path of maximum fidelity, or of the fewest hops
+class QuantumRoutingRouteTestCase : public TestCase
+{
+public:
+  QuantumRoutingRouteTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QuantumRoutingRouteTestCase::QuantumRoutingRouteTestCase ()
+  : TestCase ("GetRoute under the fidelity and the hops metrics")
+{
+}
+
+void
+QuantumRoutingRouteTestCase::DoRun (void)
+{
+  Ptr<QuantumRouting> routing = MakeRouting ({{{"A", "B"}, {0.99, 10.}},
+                                              {{"B", "C"}, {0.98, 5.}},
+                                              {{"A", "C"}, {0.9, 20.}},
+                                              {{"D", "E"}, {0.95, 1.}}});
+
+  // the Werner parameters w = (4F - 1) / 3 multiply along the path
+  double werner = (4. * 0.99 - 1.) / 3. * (4. * 0.98 - 1.) / 3.;
+  QuantumRoute route = routing->GetRoute ("A", "C");
+  NS_TEST_ASSERT_MSG_EQ ((route.owners == std::vector<std::string>{"A", "B", "C"}), true,
+                         "Two good links are better than a bad one");
+  NS_TEST_ASSERT_MSG_EQ_TOL (route.fidelity, (3. * werner + 1.) / 4., 1e-12,
+                             "Wrong fidelity of the swapped pair");
+  NS_TEST_ASSERT_MSG_EQ_TOL (route.rate, 5., 1e-12, "The slowest link bounds the rate");
+
+  NS_TEST_ASSERT_MSG_EQ (routing->GetRoute ("A", "E").owners.empty (), true,
+                         "Owners of different components are reachable");
+  NS_TEST_ASSERT_MSG_EQ (routing->GetRoute ("A", "Z").owners.empty (), true,
+                         "An unknown owner is reachable");
+
+  routing->SetMetric ("hops");
+  route = routing->GetRoute ("A", "C");
+  NS_TEST_ASSERT_MSG_EQ ((route.owners == std::vector<std::string>{"A", "C"}), true,
+                         "The direct link has the fewest hops");
+  NS_TEST_ASSERT_MSG_EQ_TOL (route.fidelity, 0.9, 1e-12, "Wrong fidelity of the direct link");
+
+  // the tree of a source serves all of its destinations
+  routing->SetMetric ("fidelity");
+  uint64_t searches = routing->GetNumSearches ();
+  routing->GetRoute ("A", "B");
+  routing->GetRoute ("A", "C");
+  NS_TEST_ASSERT_MSG_EQ (routing->GetNumSearches (), searches + 1,
+                         "The shortest path tree of a source is searched again");
+}
+
+// GetRoutes finds the k best loopless paths, best first
+class QuantumRoutingYenTestCase : public TestCase
+{
+public:
+  QuantumRoutingYenTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QuantumRoutingYenTestCase::QuantumRoutingYenTestCase ()
+  : TestCase ("GetRoutes by Yen's algorithm against all the loopless paths")
+{
+}
+
+void
+QuantumRoutingYenTestCase::DoRun (void)
+{
+  const LinkMap links = {{{"A", "B"}, {0.99, 1.}},  {{"A", "C"}, {0.97, 1.}},
+                         {{"B", "C"}, {0.985, 1.}}, {{"B", "D"}, {0.96, 1.}},
+                         {{"C", "D"}, {0.975, 1.}}, {{"C", "E"}, {0.955, 1.}},
+                         {{"D", "E"}, {0.995, 1.}}, {{"D", "F"}, {0.93, 1.}},
+                         {{"E", "F"}, {0.965, 1.}}};
+  Ptr<QuantumRouting> routing = MakeRouting (links);
+
+  // every loopless path from A to F, by depth-first search
+  std::map<std::string, std::vector<std::pair<std::string, double>>> adjacency = {};
+  for (const auto &[owners, link] : links)
+    {
+      adjacency[owners.first].push_back ({owners.second, link.first});
+      adjacency[owners.second].push_back ({owners.first, link.first});
+    }
+  std::vector<std::pair<double, std::vector<std::string>>> paths = {};
+  std::function<void (std::vector<std::string> &, double)> visit =
+      [&] (std::vector<std::string> &path, double werner) {
+        if (path.back () == "F")
+          {
+            paths.push_back ({(3. * werner + 1.) / 4., path});
+            return;
+          }
+        for (const auto &[next, fidel] : adjacency[path.back ()])
+          {
+            if (std::find (path.begin (), path.end (), next) == path.end ())
+              {
+                path.push_back (next);
+                visit (path, werner * (4. * fidel - 1.) / 3.);
+                path.pop_back ();
+              }
+          }
+      };
+  std::vector<std::string> start = {"A"};
+  visit (start, 1.);
+  std::sort (paths.rbegin (), paths.rend ());
+
+  for (const unsigned &k : {1u, 3u, 6u, 100u})
+    {
+      std::vector<QuantumRoute> routes = routing->GetRoutes ("A", "F", k);
+      NS_TEST_ASSERT_MSG_EQ (routes.size (), std::min<size_t> (k, paths.size ()),
+                             "Wrong number of paths for k = " << k);
+      for (unsigned i = 0; i < routes.size (); ++i)
+        {
+          NS_TEST_ASSERT_MSG_EQ_TOL (routes[i].fidelity, paths[i].first, 1e-12,
+                                     "Path " << i << " for k = " << k << " is not the "
+                                             << i << "-th best");
+          NS_TEST_ASSERT_MSG_EQ ((routes[i].owners == paths[i].second), true,
+                                 "Path " << i << " for k = " << k << " is another one");
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (routing->GetRoutes ("A", "F", 0).empty (), true, "k = 0 gives paths");
+}
+
+// A changed link drops exactly the cached routes it may change
+class QuantumRoutingInvalidateTestCase : public TestCase
+{
+public:
+  QuantumRoutingInvalidateTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QuantumRoutingInvalidateTestCase::QuantumRoutingInvalidateTestCase ()
+  : TestCase ("Cached routes after changing links on and off the trees")
+{
+}
+
+void
+QuantumRoutingInvalidateTestCase::DoRun (void)
+{
+  LinkMap links = {{{"A", "B"}, {0.99, 1.}},  {{"B", "C"}, {0.98, 1.}},
+                   {{"C", "D"}, {0.985, 1.}}, {{"A", "E"}, {0.95, 1.}},
+                   {{"E", "D"}, {0.94, 1.}},  {{"B", "E"}, {0.9, 1.}}};
+  Ptr<QuantumRouting> routing = MakeRouting (links);
+  const std::vector<std::string> owners = {"A", "B", "C", "D", "E"};
+
+  // each change, applied to the cached routing and to the links of a fresh one
+  const std::vector<std::tuple<std::string, std::string, double>> changes = {
+      {"B", "E", 0.85}, // worse, off the trees
+      {"B", "C", 0.93}, // worse, on the tree of A
+      {"A", "E", 0.999}, // better, shortening paths
+      {"C", "D", 0.986}, // better, on the trees already
+      {"A", "B", 0.}, // removed, on the tree of A
+      {"A", "B", 0.995}, // added again
+      {"B", "D", 0.97}, // a new link
+  };
+  for (const auto &[a, b, fidel] : changes)
+    {
+      // fill the caches before the change
+      for (const std::string &src : owners)
+        {
+          for (const std::string &dst : owners)
+            {
+              routing->GetRoute (src, dst);
+            }
+        }
+      routing->GetRoutes ("A", "D", 3);
+      routing->GetRoutes ("E", "C", 2);
+
+      uint64_t searches = routing->GetNumSearches ();
+      if (fidel == 0.)
+        {
+          routing->RemoveLink (a, b);
+          links.erase ({a, b});
+        }
+      else
+        {
+          routing->SetLink (a, b, fidel, 1.);
+          links[{a, b}] = {fidel, 1.};
+        }
+      NS_TEST_ASSERT_MSG_EQ (routing->GetNumSearches (), searches,
+                             "Changing a link searches eagerly");
+
+      Ptr<QuantumRouting> fresh = MakeRouting (links);
+      for (const std::string &src : owners)
+        {
+          for (const std::string &dst : owners)
+            {
+              NS_TEST_ASSERT_MSG_EQ (SameRoutes ({routing->GetRoute (src, dst)},
+                                                 {fresh->GetRoute (src, dst)}),
+                                     true,
+                                     "Stale route from " << src << " to " << dst << " after "
+                                                         << a << " <--> " << b);
+            }
+        }
+      NS_TEST_ASSERT_MSG_EQ (SameRoutes (routing->GetRoutes ("A", "D", 3),
+                                         fresh->GetRoutes ("A", "D", 3)),
+                             true, "Stale paths from A to D after " << a << " <--> " << b);
+      NS_TEST_ASSERT_MSG_EQ (SameRoutes (routing->GetRoutes ("E", "C", 2),
+                                         fresh->GetRoutes ("E", "C", 2)),
+                             true, "Stale paths from E to C after " << a << " <--> " << b);
+    }
+
+  // a worse link used by no tree keeps all of them
+  for (const std::string &src : owners)
+    {
+      routing->GetRoute (src, "A");
+    }
+  uint64_t searches = routing->GetNumSearches ();
+  routing->SetLink ("B", "E", 0.8, 1.);
+  for (const std::string &src : owners)
+    {
+      routing->GetRoute (src, "A");
+    }
+  NS_TEST_ASSERT_MSG_EQ (routing->GetNumSearches (), searches,
+                         "A worse link off the trees drops some of them");
+}
+
+// A removed qubit frees its slot, read as an empty name, for the next qubit
+class QuantumMemorySlotTestCase : public TestCase
+{
+public:
+  QuantumMemorySlotTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QuantumMemorySlotTestCase::QuantumMemorySlotTestCase ()
+  : TestCase ("QuantumMemory reuses the freed slots")
+{
+}
+
+void
+QuantumMemorySlotTestCase::DoRun (void)
+{
+  QuantumMemory memory;
+  NS_TEST_ASSERT_MSG_EQ (memory.AddQubit ("a"), 0u, "Wrong slot of the first qubit");
+  NS_TEST_ASSERT_MSG_EQ (memory.AddQubit ("b"), 1u, "Wrong slot of the second qubit");
+  NS_TEST_ASSERT_MSG_EQ (memory.AddQubit ("c"), 2u, "Wrong slot of the third qubit");
+  NS_TEST_ASSERT_MSG_EQ (memory.AddQubit ("b"), 1u, "A qubit added twice moves");
+
+  NS_TEST_ASSERT_MSG_EQ (memory.RemoveQubit ("b"), true, "A held qubit is not removed");
+  NS_TEST_ASSERT_MSG_EQ (memory.RemoveQubit ("b"), false, "A qubit is removed twice");
+  NS_TEST_ASSERT_MSG_EQ (memory.ContainQubit ("b"), false, "A removed qubit is still held");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetSize (), 3u, "Removing a qubit drops its slot");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetNumQubits (), 2u, "Wrong number of qubits");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetQubit (1), "", "A free slot reads as a qubit");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetQubit (2), "c", "The other qubits move");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetFreeSlot (), 1u, "The freed slot is not the next one");
+
+  NS_TEST_ASSERT_MSG_EQ (memory.AddQubit ("d"), 1u, "A new qubit does not take the freed slot");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetSlot ("d"), 1u, "Wrong slot of the new qubit");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetFreeSlot (), 3u, "No free slot but a new one");
+
+  // the most recently freed slot is taken first
+  memory.RemoveQubit ("a");
+  memory.RemoveQubit ("c");
+  NS_TEST_ASSERT_MSG_EQ (memory.AddQubit ("e"), 2u, "The last freed slot is not taken first");
+  NS_TEST_ASSERT_MSG_EQ (memory.AddQubit ("f"), 0u, "The other freed slot is not taken");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetSize (), 3u, "Reusing slots grows the memory");
+}
+
+// The capacity bounds the qubits, and placeholders in SetQubits are free slots
+class QuantumMemoryCapacityTestCase : public TestCase
+{
+public:
+  QuantumMemoryCapacityTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QuantumMemoryCapacityTestCase::QuantumMemoryCapacityTestCase ()
+  : TestCase ("QuantumMemory capacity and placeholder slots")
+{
+}
+
+void
+QuantumMemoryCapacityTestCase::DoRun (void)
+{
+  QuantumMemory memory;
+  memory.SetCapacity (2);
+  NS_TEST_ASSERT_MSG_EQ (memory.IsFull (), false, "An empty memory is full");
+  memory.AddQubit ("x");
+  memory.AddQubit ("y");
+  NS_TEST_ASSERT_MSG_EQ (memory.IsFull (), true, "A memory at its capacity is not full");
+  memory.RemoveQubit ("x");
+  NS_TEST_ASSERT_MSG_EQ (memory.IsFull (), false, "A memory with a free slot is full");
+  NS_TEST_ASSERT_MSG_EQ (memory.AddQubit ("z"), 0u, "The freed slot is not reused");
+  NS_TEST_ASSERT_MSG_EQ (memory.IsFull (), true, "A memory at its capacity is not full");
+  memory.SetCapacity (0);
+  NS_TEST_ASSERT_MSG_EQ (memory.IsFull (), false, "An unbounded memory is full");
+
+  // the lowest placeholder is the next slot, and the capacity is kept
+  memory.SetCapacity (3);
+  memory.SetQubits ({"", "a", "", "b"});
+  NS_TEST_ASSERT_MSG_EQ (memory.GetCapacity (), 3u, "SetQubits changes the capacity");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetSize (), 4u, "Placeholders are not slots");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetNumQubits (), 2u, "Placeholders are qubits");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetQubit (0), "", "A placeholder reads as a qubit");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetSlot ("b"), 3u, "Wrong slot of a restored qubit");
+  NS_TEST_ASSERT_MSG_EQ (memory.ContainQubit (""), false, "A placeholder is held");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetFreeSlot (), 0u, "The lowest placeholder is not next");
+  NS_TEST_ASSERT_MSG_EQ (memory.AddQubit ("c"), 0u, "A placeholder is not taken");
+  NS_TEST_ASSERT_MSG_EQ (memory.GetFreeSlot (), 2u, "The other placeholder is not next");
+
+  // the qubits, not the slots, count against a lowered capacity
+  NS_TEST_ASSERT_MSG_EQ (memory.IsFull (), true, "A memory at its capacity is not full");
+  memory.RemoveQubit ("a");
+  NS_TEST_ASSERT_MSG_EQ (memory.IsFull (), false, "A memory below its capacity is full");
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,8 +611,43 @@ QuantumBasisTestSuite::QuantumBasisTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new QuantumBasisTestCase1, TestCase::QUICK);
+  AddTestCase (new QuantumPauliChannelTestCase, TestCase::QUICK);
+  AddTestCase (new QuantumReduceKrausTestCase, TestCase::QUICK);
+  AddTestCase (new QuantumEigenHermitianTestCase, TestCase::QUICK);
+  AddTestCase (new QuantumAmplitudeDampingTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
 static QuantumBasisTestSuite squantumBasisTestSuite;
 
+class QuantumRoutingTestSuite : public TestSuite
+{
+public:
+  QuantumRoutingTestSuite ();
+};
+
+QuantumRoutingTestSuite::QuantumRoutingTestSuite ()
+  : TestSuite ("quantum-routing", UNIT)
+{
+  AddTestCase (new QuantumRoutingRouteTestCase, TestCase::QUICK);
+  AddTestCase (new QuantumRoutingYenTestCase, TestCase::QUICK);
+  AddTestCase (new QuantumRoutingInvalidateTestCase, TestCase::QUICK);
+}
+
+static QuantumRoutingTestSuite squantumRoutingTestSuite;
+
+class QuantumMemoryTestSuite : public TestSuite
+{
+public:
+  QuantumMemoryTestSuite ();
+};
+
+QuantumMemoryTestSuite::QuantumMemoryTestSuite ()
+  : TestSuite ("quantum-memory", UNIT)
+{
+  AddTestCase (new QuantumMemorySlotTestCase, TestCase::QUICK);
+  AddTestCase (new QuantumMemoryCapacityTestCase, TestCase::QUICK);
+}
+
+static QuantumMemoryTestSuite squantumMemoryTestSuite;
+